@@ -0,0 +1,544 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "abstractweatherforecast.h"
+#include "aggregation.h"
+#include "arena.h"
+#include "backendhealthtracker.h"
+#include "blendedweatherapi.h"
+#include "contenthash.h"
+#include "derivedquantities.h"
+#include "forecasthistory.h"
+#include "forecastverification.h"
+#include "hedgebudget.h"
+#include "interpolation.h"
+#include "jsondecoder.h"
+#include "metrics.h"
+#include "nmisunriseapi.h"
+#include "nmiweatherapi2.h"
+#include "owmweatherapi.h"
+#include "timestamp.h"
+#include "weatherchartmodel.h"
+#include "weatherdaymodel.h"
+#include "weatherhourmodel.h"
+#include "weatherlocation.h"
+
+#include <KLocalizedString>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#ifdef __GLIBC__
+#include <atomic>
+#include <cstddef>
+
+// every heap allocation of the process goes through here, Qt's containers call malloc
+// directly, so counting operator new alone would miss most of them
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t count, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static std::atomic<qint64> s_allocations{0};
+
+extern "C" void *malloc(size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t count, size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    s_allocations.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(ptr, size);
+}
+#endif
+
+Q_DECLARE_METATYPE(Aggregation::Window)
+
+// recorded payloads are in data/, timed against the same documents on every run;
+// that the code timed computes the right thing is checked in kweathertests
+class KWeatherBenchmarks : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void nmiParse_data();
+    void nmiParse();
+    void owmParse_data();
+    void owmParse();
+    void nmiParseAllocations_data();
+    void nmiParseAllocations();
+    void owmParseAllocations_data();
+    void owmParseAllocations();
+    void sunriseProcess();
+    void timestampDecode();
+    void timestampQt();
+    void aggregate_data();
+    void aggregate();
+    void derivedQuantities();
+    void interpolate();
+    void blend();
+    void historyAppend();
+    void historySize();
+    void historyQuery();
+    void verificationUpdate();
+    void hedgeDecision();
+    void healthTracking();
+    void bodyHash();
+    void forecastHash();
+    void forecastToJson();
+    void forecastFromJson();
+    void hourModelRefresh();
+    void dayModelRefresh();
+    void chartModelZoom_data();
+    void chartModelZoom();
+    void determineCurrentForecast();
+
+private:
+    static QByteArray readData(const QString &fileName);
+    static void decoderData();
+    template<typename F> static void reportAllocations(F f);
+
+    QByteArray m_nmiData, m_owmData, m_sunriseData;
+    QStringList m_times; // every timeseries time of the nmi payload
+    AbstractWeatherForecast m_forecast; // parsed from the nmi payload
+};
+
+QByteArray KWeatherBenchmarks::readData(const QString &fileName)
+{
+    QFile file(QFINDTESTDATA(QStringLiteral("data/") + fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+// QJsonDocument always, simdjson when built with it
+void KWeatherBenchmarks::decoderData()
+{
+    QTest::addColumn<bool>("simd");
+    QTest::newRow("QJsonDocument") << false;
+    if (JsonDecoder::simdAvailable())
+        QTest::newRow("simdjson") << true;
+}
+
+// allocations of one call, reported as the result of the benchmark
+template<typename F> void KWeatherBenchmarks::reportAllocations(F f)
+{
+#ifdef __GLIBC__
+    f(); // first call builds the static tables
+    const qint64 before = s_allocations.load();
+    f();
+    QTest::setBenchmarkResult(s_allocations.load() - before, QTest::Events);
+#else
+    Q_UNUSED(f)
+    QSKIP("allocations are only counted with glibc");
+#endif
+}
+
+void KWeatherBenchmarks::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    KLocalizedString::setApplicationDomain("kweather");
+
+    m_nmiData = readData(QStringLiteral("nmi_complete.json"));
+    m_owmData = readData(QStringLiteral("owm_forecast.json"));
+    m_sunriseData = readData(QStringLiteral("nmi_sunrise.json"));
+    QVERIFY(!m_nmiData.isEmpty());
+    QVERIFY(!m_owmData.isEmpty());
+    QVERIFY(!m_sunriseData.isEmpty());
+
+    const auto timeseries = QJsonDocument::fromJson(m_nmiData)[QLatin1String("properties")].toObject()[QLatin1String("timeseries")].toArray();
+    for (const auto &entry : timeseries)
+        m_times.append(entry.toObject()[QLatin1String("time")].toString());
+    QVERIFY(!m_times.isEmpty());
+
+    // the reference forecast always comes from QJsonDocument, the tests pick their decoder
+    JsonDecoder::setUseSimd(false);
+    NMIWeatherAPI2 api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    api.parseData(m_nmiData);
+    m_forecast = api.currentData();
+    QVERIFY(!m_forecast.hourlyForecasts().isEmpty());
+    QVERIFY(!m_forecast.dailyForecasts().isEmpty());
+}
+
+void KWeatherBenchmarks::nmiParse_data()
+{
+    decoderData();
+}
+
+void KWeatherBenchmarks::nmiParse()
+{
+    QFETCH(bool, simd);
+    JsonDecoder::setUseSimd(simd);
+    NMIWeatherAPI2 api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    QBENCHMARK {
+        api.parseData(m_nmiData);
+    }
+    QCOMPARE(api.currentData().hourlyForecasts().count(), m_forecast.hourlyForecasts().count()); // see KWeatherTests::decoders()
+}
+
+void KWeatherBenchmarks::owmParse_data()
+{
+    decoderData();
+}
+
+void KWeatherBenchmarks::owmParse()
+{
+    QFETCH(bool, simd);
+    JsonDecoder::setUseSimd(simd);
+    OWMWeatherAPI api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    QBENCHMARK {
+        api.parseData(m_owmData);
+    }
+    QVERIFY(!api.currentData().hourlyForecasts().isEmpty());
+}
+
+void KWeatherBenchmarks::nmiParseAllocations_data()
+{
+    decoderData();
+}
+
+void KWeatherBenchmarks::nmiParseAllocations()
+{
+    QFETCH(bool, simd);
+    JsonDecoder::setUseSimd(simd);
+    NMIWeatherAPI2 api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    reportAllocations([&] { api.parseData(m_nmiData); });
+    // the scratch of a parse fits in the arena's one block from then on
+    QCOMPARE(MonotonicArena::scratch().blockCount(), std::size_t(1));
+}
+
+void KWeatherBenchmarks::owmParseAllocations_data()
+{
+    decoderData();
+}
+
+void KWeatherBenchmarks::owmParseAllocations()
+{
+    QFETCH(bool, simd);
+    JsonDecoder::setUseSimd(simd);
+    OWMWeatherAPI api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    reportAllocations([&] { api.parseData(m_owmData); });
+}
+
+void KWeatherBenchmarks::sunriseProcess()
+{
+    // process() appends to what the api already has, so every round starts empty
+    QBENCHMARK {
+        NMISunriseAPI api(59.9127, 10.7461, 7200);
+        api.processData(m_sunriseData);
+    }
+}
+
+void KWeatherBenchmarks::timestampDecode()
+{
+    qint64 sum = 0;
+    QBENCHMARK {
+        for (const auto &time : qAsConst(m_times)) {
+            qint64 secs = 0;
+            Timestamp::toEpoch(time, secs);
+            sum += secs;
+        }
+    }
+    QVERIFY(sum != 0); // that it agrees with the qt parser is KWeatherTests::timestamps()
+}
+
+void KWeatherBenchmarks::timestampQt()
+{
+    qint64 sum = 0;
+    QBENCHMARK {
+        for (const auto &time : qAsConst(m_times))
+            sum += QDateTime::fromString(time, Qt::ISODate).toSecsSinceEpoch();
+    }
+    QVERIFY(sum != 0);
+}
+
+void KWeatherBenchmarks::aggregate_data()
+{
+    QTest::addColumn<Aggregation::Window>("window");
+    QTest::newRow("day") << Aggregation::Window::Day;
+    QTest::newRow("day part") << Aggregation::Window::DayPart;
+    QTest::newRow("3 hours") << Aggregation::Window::ThreeHours;
+}
+
+void KWeatherBenchmarks::aggregate()
+{
+    QFETCH(Aggregation::Window, window);
+    MonotonicArena arena;
+    Aggregation::Series series(arena);
+    for (const auto &hour : m_forecast.hourlyForecasts()) {
+        series.append(hour.date().toSecsSinceEpoch() + hour.date().offsetFromUtc(),
+                      hour.temperature(),
+                      hour.temperature(),
+                      hour.temperature(),
+                      hour.precipitationAmount(),
+                      hour.uvIndex(),
+                      hour.humidity(),
+                      hour.pressure(),
+                      Aggregation::rank(hour.neutralWeatherIcon()));
+    }
+    Aggregation::Column<Aggregation::Summary> summaries{ArenaAllocator<Aggregation::Summary>(arena)};
+    QBENCHMARK {
+        summaries.clear();
+        Aggregation::aggregate(series, window, summaries);
+    }
+    QVERIFY(!summaries.empty());
+}
+
+void KWeatherBenchmarks::derivedQuantities()
+{
+    QList<AbstractHourlyWeatherForecast> hours = m_forecast.hourlyForecasts();
+    QBENCHMARK {
+        DerivedQuantities::apply(hours);
+    }
+    QCOMPARE(hours.count(), m_forecast.hourlyForecasts().count());
+}
+
+// every third hour back to hourly, as from owm
+void KWeatherBenchmarks::interpolate()
+{
+    QList<AbstractHourlyWeatherForecast> steps;
+    for (int i = 0; i < m_forecast.hourlyForecasts().count(); i += 3)
+        steps.append(m_forecast.hourlyForecasts().at(i));
+    MonotonicArena arena;
+    QList<AbstractHourlyWeatherForecast> hours;
+    QBENCHMARK {
+        arena.reset();
+        hours = steps;
+        Interpolation::resample(hours, 3600, arena);
+    }
+    QCOMPARE(hours.count(), steps.count() * 3);
+}
+
+// what a blended location adds to every refresh once both backends answered
+void KWeatherBenchmarks::blend()
+{
+    OWMWeatherAPI api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    api.parseData(m_owmData);
+    // the owm sample is of another day, moved onto the first hours of the nmi one
+    auto owm = api.currentData().hourlyForecasts();
+    const auto &nmi = m_forecast.hourlyForecasts();
+    for (int i = 0; i < owm.count(); i++)
+        owm[i].setDate(nmi.first().date().addSecs(3600 * i));
+
+    BlendedWeatherAPI::Weights weights;
+    weights.temperature = 0.7f;
+    QList<AbstractHourlyWeatherForecast> hours;
+    QBENCHMARK {
+        BlendedWeatherAPI::blend(nmi, owm, weights, hours);
+    }
+    QCOMPARE(hours.count(), nmi.count());
+}
+
+// one run a refresh
+void KWeatherBenchmarks::historyAppend()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("oslo")));
+    const auto &hours = m_forecast.hourlyForecasts();
+    const qint64 issued = m_forecast.timeCreated().toSecsSinceEpoch();
+    int runs = 0;
+    QBENCHMARK {
+        QVERIFY(history.append(issued + 3600 * runs++, Kweather::Backend::NMI, hours, issued));
+    }
+    QCOMPARE(history.runs().count(), runs);
+}
+
+// what a day of hourly runs costs on disk, in bytes per stored value
+void KWeatherBenchmarks::historySize()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("oslo")));
+    const auto &hours = m_forecast.hourlyForecasts();
+    const qint64 issued = m_forecast.timeCreated().toSecsSinceEpoch();
+    const int runs = 24;
+    for (int i = 0; i < runs; i++)
+        QVERIFY(history.append(issued + 3600 * i, Kweather::Backend::NMI, hours, issued));
+    QTest::setBenchmarkResult(static_cast<double>(history.fileSize()) / (runs * hours.count() * 6), QTest::BytesAllocated);
+}
+
+void KWeatherBenchmarks::historyQuery()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("oslo")));
+    history.setRetention(10 * 86400);
+    const auto &hours = m_forecast.hourlyForecasts();
+    const qint64 issued = m_forecast.timeCreated().toSecsSinceEpoch();
+    // two weeks of hourly runs, the first few days expire once past the slack
+    const int runs = 14 * 24;
+    for (int i = 0; i < runs; i++)
+        QVERIFY(history.append(issued + 3600 * i, i % 2 ? Kweather::Backend::OWM : Kweather::Backend::NMI, hours, issued + 3600 * i));
+
+    // everything the runs of the last day said about one hour
+    const qint64 valid = hours.at(hours.count() / 2).date().toSecsSinceEpoch();
+    const qint64 lastIssued = issued + 3600 * (runs - 1);
+    QVector<ForecastHistory::Point> points;
+    QBENCHMARK {
+        points = history.query(valid, valid + 1, lastIssued - 86400, lastIssued + 1);
+    }
+    QCOMPARE(points.count(), 25);
+}
+
+// scoring four days of runs from scratch: nmi hourly on the hour, owm half an hour
+// later and two degrees warmer, so the nmi run of the hour is always the nowcast
+void KWeatherBenchmarks::verificationUpdate()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("history")));
+    const auto &hours = m_forecast.hourlyForecasts();
+    auto warmer = hours;
+    for (auto &hour : warmer)
+        hour.setTemperature(hour.temperature() + 2);
+    const qint64 first = hours.first().date().toSecsSinceEpoch() - 24 * 3600;
+    const int runs = 4 * 24;
+    for (int i = 0; i < runs; i++) {
+        QVERIFY(history.append(first + 3600 * i, Kweather::Backend::NMI, hours, first + 3600 * i));
+        QVERIFY(history.append(first + 3600 * i + 1800, Kweather::Backend::OWM, warmer, first + 3600 * i + 1800));
+    }
+    const qint64 now = first + 3600 * runs;
+
+    const QString path = dir.filePath(QStringLiteral("verification"));
+    int scored = 0;
+    QBENCHMARK {
+        QFile::remove(path);
+        ForecastVerification verification(path);
+        scored = verification.update(history, now);
+    }
+    QVERIFY(scored > 0);
+}
+
+// what every refresh of a hedging location pays
+void KWeatherBenchmarks::hedgeDecision()
+{
+    for (int i = 0; i < 200; i++)
+        Metrics::instance().record(QStringLiteral("kweather_request_latency_microseconds"), QStringLiteral("nmi"), i % 2 ? QStringLiteral("a") : QStringLiteral("b"), (i + 1) * 5000);
+    int delay = 0;
+    QBENCHMARK {
+        delay = HedgeBudget::delay(QStringLiteral("nmi"));
+    }
+    QVERIFY(delay > 0);
+}
+
+// what every forecast reply costs
+void KWeatherBenchmarks::healthTracking()
+{
+    BackendHealthTracker &tracker = BackendHealthTracker::instance();
+    QBENCHMARK {
+        tracker.record(Kweather::Backend::OWM, true, 300);
+    }
+    QVERIFY(tracker.isHealthy(Kweather::Backend::OWM));
+}
+
+// all an unchanged refresh costs
+void KWeatherBenchmarks::bodyHash()
+{
+    quint64 hash = 0;
+    QBENCHMARK {
+        hash = ContentHash::of(m_nmiData);
+    }
+    QVERIFY(hash != 0);
+}
+
+void KWeatherBenchmarks::forecastHash()
+{
+    quint64 hash = 0;
+    QBENCHMARK {
+        hash = m_forecast.contentHash();
+    }
+    QVERIFY(hash != 0);
+}
+
+void KWeatherBenchmarks::forecastToJson()
+{
+    AbstractWeatherForecast forecast = m_forecast;
+    QJsonObject json;
+    QBENCHMARK {
+        json = forecast.toJson();
+    }
+    QVERIFY(!json.isEmpty());
+}
+
+void KWeatherBenchmarks::forecastFromJson()
+{
+    AbstractWeatherForecast forecast = m_forecast;
+    const QJsonObject json = forecast.toJson();
+    QBENCHMARK {
+        forecast = AbstractWeatherForecast::fromJson(json);
+    }
+    QCOMPARE(forecast.hourlyForecasts().count(), m_forecast.hourlyForecasts().count());
+}
+
+void KWeatherBenchmarks::hourModelRefresh()
+{
+    WeatherLocation location(nullptr, QStringLiteral("oslo"), QStringLiteral("Oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461, Kweather::Backend::NMI, m_forecast);
+    auto model = location.weatherHourListModel();
+    AbstractWeatherForecast forecast = m_forecast;
+    QBENCHMARK {
+        model->refreshHoursFromForecasts(forecast);
+    }
+}
+
+void KWeatherBenchmarks::dayModelRefresh()
+{
+    WeatherLocation location(nullptr, QStringLiteral("oslo"), QStringLiteral("Oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461, Kweather::Backend::NMI, m_forecast);
+    auto model = location.weatherDayListModel();
+    AbstractWeatherForecast forecast = m_forecast;
+    QBENCHMARK {
+        model->refreshDaysFromForecasts(forecast);
+    }
+    QCOMPARE(model->rowCount(QModelIndex()), m_forecast.dailyForecasts().count());
+}
+
+void KWeatherBenchmarks::chartModelZoom_data()
+{
+    QTest::addColumn<int>("hours");
+    QTest::addColumn<int>("points");
+    QTest::newRow("all days, narrow") << 0 << 24;
+    QTest::newRow("all days, wide") << 0 << 96;
+    QTest::newRow("24 hours") << 24 << 24;
+}
+
+// what a zoom or resize costs, the hours are already in the model
+void KWeatherBenchmarks::chartModelZoom()
+{
+    QFETCH(int, hours);
+    QFETCH(int, points);
+    WeatherChartModel model;
+    AbstractWeatherForecast forecast = m_forecast;
+    model.refreshFromForecast(forecast);
+    QBENCHMARK {
+        model.setHours(hours ? 0 : 24);
+        model.setHours(hours);
+        model.setMaximumPoints(points);
+    }
+    QVERIFY(model.rowCount(QModelIndex()) <= points);
+}
+
+void KWeatherBenchmarks::determineCurrentForecast()
+{
+    WeatherLocation location(nullptr, QStringLiteral("oslo"), QStringLiteral("Oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461, Kweather::Backend::NMI, m_forecast);
+    QBENCHMARK {
+        location.determineCurrentForecast();
+    }
+}
+
+QTEST_GUILESS_MAIN(KWeatherBenchmarks)
+
+#include "kweatherbenchmarks.moc"
@@ -0,0 +1,228 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// How a location refreshes when a backend is late or down: hedging with the other
+// backend (WeatherLocation::startHedge(), settle()) and failing over to it and back
+// (followHealth(), switchBackend()), against the stand-in server of kweather_stress.
+
+#include "abstractweatherapi.h"
+#include "backendhealthtracker.h"
+#include "hedgebudget.h"
+#include "kweathersettings.h"
+#include "metrics.h"
+#include "nmiweatherapi2.h"
+#include "owmweatherapi.h"
+#include "standinserver.h"
+#include "weatherlocation.h"
+
+#include <KLocalizedString>
+
+#include <QStandardPaths>
+#include <QtTest>
+
+#include <memory>
+
+class KWeatherRefreshTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void hedgeWins();
+    void primaryWins();
+    void budgetExhausted();
+    void shadowAnswersFirst();
+    void failoverAndRecovery(); // last, it leaves nmi having been down
+
+private:
+    std::unique_ptr<WeatherLocation> newLocation();
+    static void configure(bool hedging, bool shadowFetch, int budgetPercent);
+
+    StandInServer m_server;
+    int m_nmiHours = 0, m_owmHours = 0; // of the recorded payloads, tell the two forecasts apart
+    int m_locations = 0;
+    int m_refreshes = 0; // of the location under test
+};
+
+void KWeatherRefreshTests::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    KLocalizedString::setApplicationDomain("kweather");
+    AbstractWeatherAPI::setServerOverride(QUrl(QStringLiteral("http://127.0.0.1:%1").arg(m_server.start())));
+
+    NMIWeatherAPI2 nmi(QStringLiteral("reference"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    QFile nmiData(QStringLiteral(KWEATHER_TEST_DATA_DIR "/nmi_complete.json"));
+    QVERIFY(nmiData.open(QIODevice::ReadOnly));
+    nmi.parseData(nmiData.readAll());
+    m_nmiHours = nmi.currentData().hourlyForecasts().count();
+    OWMWeatherAPI owm(QStringLiteral("reference"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    QFile owmData(QStringLiteral(KWEATHER_TEST_DATA_DIR "/owm_forecast.json"));
+    QVERIFY(owmData.open(QIODevice::ReadOnly));
+    owm.parseData(owmData.readAll());
+    m_owmHours = owm.currentData().hourlyForecasts().count();
+    QVERIFY(m_nmiHours > 0 && m_owmHours > 0 && m_nmiHours != m_owmHours);
+
+    // nmi usually answers within 50 ms, so a hedge goes out after the minimum of 200 ms
+    for (int i = 0; i < 200; i++)
+        Metrics::instance().record(QStringLiteral("kweather_request_latency_microseconds"), QStringLiteral("nmi"), QStringLiteral("127.0.0.1"), 50000);
+    QCOMPARE(HedgeBudget::delay(QStringLiteral("nmi")), 200);
+}
+
+std::unique_ptr<WeatherLocation> KWeatherRefreshTests::newLocation()
+{
+    const QString id = QStringLiteral("refresh%1").arg(m_locations++);
+    std::unique_ptr<WeatherLocation> location(new WeatherLocation(nullptr, id, id, QStringLiteral("Europe/Oslo"), 59.9127, 10.7461, Kweather::Backend::NMI));
+    m_refreshes = 0;
+    connect(location.get(), &WeatherLocation::weatherRefresh, this, [this] { m_refreshes++; });
+    return location;
+}
+
+void KWeatherRefreshTests::configure(bool hedging, bool shadowFetch, int budgetPercent)
+{
+    KWeatherSettings settings;
+    settings.setOWMToken(QStringLiteral("stand-in"));
+    settings.setShadowFetch(shadowFetch);
+    settings.setHedgedRequests(hedging);
+    settings.setHedgeBudgetPercent(budgetPercent);
+    settings.setAutomaticFailover(true);
+    settings.save();
+    // every refresh starts from an empty budget and deposits its share
+    while (HedgeBudget::instance().withdraw()) { }
+}
+
+// nmi is late, the hedge to owm answers first and nmi's request is dropped
+void KWeatherRefreshTests::hedgeWins()
+{
+    configure(true, false, 100);
+    m_server.setDelay(NMI_FORECAST, 2000);
+    m_server.setDelay(OWM_FORECAST, 0);
+    const int nmiAnswered = m_server.answered(NMI_FORECAST);
+    const int owmRequested = m_server.requested(OWM_FORECAST);
+
+    auto location = newLocation();
+    location->update();
+    QTRY_COMPARE_WITH_TIMEOUT(m_refreshes, 1, 1500);
+    QCOMPARE(m_server.requested(OWM_FORECAST), owmRequested + 1);
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_owmHours);
+    QCOMPARE(location->backend(), Kweather::API_NMI); // a hedge does not move the location
+
+    // cancelled, its answer never goes out and nothing replaces the forecast shown
+    QTest::qWait(2500);
+    QCOMPARE(m_server.answered(NMI_FORECAST), nmiAnswered);
+    QCOMPARE(m_refreshes, 1);
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_owmHours);
+}
+
+// nmi answers after the hedge went out but before it came back, the hedge is dropped
+void KWeatherRefreshTests::primaryWins()
+{
+    configure(true, false, 100);
+    m_server.setDelay(NMI_FORECAST, 600);
+    m_server.setDelay(OWM_FORECAST, 2000);
+    const int owmRequested = m_server.requested(OWM_FORECAST);
+    const int owmAnswered = m_server.answered(OWM_FORECAST);
+
+    auto location = newLocation();
+    location->update();
+    QTRY_COMPARE_WITH_TIMEOUT(m_refreshes, 1, 1500);
+    QCOMPARE(m_server.requested(OWM_FORECAST), owmRequested + 1);
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_nmiHours);
+
+    QTest::qWait(2000);
+    QCOMPARE(m_server.answered(OWM_FORECAST), owmAnswered);
+    QCOMPARE(m_refreshes, 1);
+}
+
+// with nothing left in the budget a late backend is simply waited for
+void KWeatherRefreshTests::budgetExhausted()
+{
+    configure(true, false, 0);
+    m_server.setDelay(NMI_FORECAST, 800);
+    m_server.setDelay(OWM_FORECAST, 0);
+    const int owmRequested = m_server.requested(OWM_FORECAST);
+
+    auto location = newLocation();
+    location->update();
+    QTRY_COMPARE_WITH_TIMEOUT(m_refreshes, 1, 3000);
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_nmiHours);
+    QCOMPARE(m_server.requested(OWM_FORECAST), owmRequested);
+}
+
+// the shadow owm was asked along with nmi and answered first, a hedge uses its answer;
+// asked again it has nothing new and what it sent before is used
+void KWeatherRefreshTests::shadowAnswersFirst()
+{
+    configure(true, true, 0);
+    m_server.setDelay(NMI_FORECAST, 1000);
+    m_server.setDelay(OWM_FORECAST, 0);
+    const int nmiAnswered = m_server.answered(NMI_FORECAST);
+
+    auto location = newLocation();
+    location->update();
+    QTRY_COMPARE_WITH_TIMEOUT(m_refreshes, 1, 800); // shadowUpdated(), no budget needed
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_owmHours);
+
+    location->update();
+    QTRY_COMPARE_WITH_TIMEOUT(m_refreshes, 2, 800); // shadowUnchanged()
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_owmHours);
+
+    QTest::qWait(1500);
+    QCOMPARE(m_server.answered(NMI_FORECAST), nmiAnswered);
+    QCOMPARE(m_refreshes, 2);
+}
+
+// nmi fails until it trips, the location moves to owm on its next refresh, a probe
+// finds nmi back and once it recovered the location returns to it
+void KWeatherRefreshTests::failoverAndRecovery()
+{
+    configure(false, false, 0);
+    m_server.setDelay(NMI_FORECAST, 0);
+    m_server.setStatus(NMI_FORECAST, 503);
+    BackendHealthTracker &tracker = BackendHealthTracker::instance();
+    QVERIFY(tracker.isHealthy(Kweather::Backend::NMI));
+
+    auto location = newLocation();
+    for (int i = 1; i <= 3; i++) {
+        location->update();
+        QTRY_COMPARE(tracker.health(Kweather::Backend::NMI).failuresInRow, i);
+    }
+    QVERIFY(!tracker.isHealthy(Kweather::Backend::NMI));
+    QCOMPARE(m_refreshes, 0);
+    QCOMPARE(location->backend(), Kweather::API_NMI); // not shown, it waits for its refresh
+
+    location->update();
+    QCOMPARE(location->backend(), Kweather::API_OWM);
+    QCOMPARE(location->preferredBackend(), Kweather::Backend::NMI);
+    QTRY_COMPARE(m_refreshes, 1);
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_owmHours);
+
+    // the probe goes to nmi, the location stays on owm meanwhile
+    m_server.setStatus(NMI_FORECAST, 200);
+    const int nmiRequested = m_server.requested(NMI_FORECAST);
+    emit tracker.probeDue(Kweather::Backend::NMI);
+    QTRY_COMPARE(tracker.health(Kweather::Backend::NMI).successesInRow, 1);
+    QCOMPARE(m_server.requested(NMI_FORECAST), nmiRequested + 1);
+    QCOMPARE(location->backend(), Kweather::API_OWM);
+
+    // enough successes are not enough before it has been down for a while
+    tracker.record(Kweather::Backend::NMI, true, 50);
+    tracker.record(Kweather::Backend::NMI, true, 50);
+    QVERIFY(!tracker.isHealthy(Kweather::Backend::NMI));
+    tracker.skipTime(10 * 60);
+    tracker.record(Kweather::Backend::NMI, true, 50);
+    QVERIFY(tracker.isHealthy(Kweather::Backend::NMI));
+
+    location->update();
+    QCOMPARE(location->backend(), Kweather::API_NMI);
+    QTRY_COMPARE(m_refreshes, 2);
+    QCOMPARE(location->forecast().hourlyForecasts().count(), m_nmiHours);
+}
+
+QTEST_GUILESS_MAIN(KWeatherRefreshTests)
+
+#include "kweatherrefreshtests.moc"
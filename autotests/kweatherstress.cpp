@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+// Drives the whole refresh pipeline (model, forecast manager, backends, cache, models)
+// for N synthetic locations against a local stand-in for the weather servers, and
+// prints the numbers that should not grow faster than N.
+
+#include "abstractweatherapi.h"
+#include "historyworker.h"
+#include "standinserver.h"
+#include "weatherforecastmanager.h"
+#include "weatherlocation.h"
+#include "weatherlocationmodel.h"
+
+#include <KConfigGroup>
+#include <KLocalizedString>
+#include <KSharedConfig>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QtMath>
+
+#include <unistd.h>
+
+static qint64 residentBytes()
+{
+    QFile statm(QStringLiteral("/proc/self/statm"));
+    if (!statm.open(QIODevice::ReadOnly))
+        return 0;
+    return statm.readAll().split(' ').value(1).toLongLong() * sysconf(_SC_PAGESIZE);
+}
+
+// open file descriptors, and how many of them are sockets
+static QPair<int, int> fileDescriptors()
+{
+    QPair<int, int> ret(0, 0);
+    const auto entries = QDir(QStringLiteral("/proc/self/fd")).entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot);
+    for (const auto &entry : entries) {
+        char target[64];
+        const ssize_t len = readlink(QByteArray("/proc/self/fd/" + entry.toLatin1()).constData(), target, sizeof(target));
+        ret.first++;
+        if (len > 0 && QByteArray(target, len).startsWith("socket:"))
+            ret.second++;
+    }
+    return ret;
+}
+
+static void writeLocations(int count, int backend)
+{
+    QJsonArray arr;
+    for (int i = 0; i < count; i++) {
+        QJsonObject obj;
+        obj["locationId"] = QStringLiteral("stress%1").arg(i);
+        obj["locationName"] = QStringLiteral("Stress %1").arg(i);
+        obj["latitude"] = -60 + (i * 7.31) - 120 * qFloor(i * 7.31 / 120);
+        obj["longitude"] = -180 + (i * 13.7) - 360 * qFloor(i * 13.7 / 360);
+        obj["timezone"] = QStringLiteral("Europe/Oslo");
+        obj["backend"] = backend;
+        arr.append(obj);
+    }
+    auto config = KSharedConfig::openConfig(QString(), KSharedConfig::FullConfig, QStandardPaths::AppConfigLocation);
+    KConfigGroup group = config->group(QStringLiteral("WeatherLocations"));
+    group.writeEntry(QStringLiteral("locationsList"), QString(QJsonDocument(arr).toJson(QJsonDocument::Compact)));
+    group.sync();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    app.setApplicationName(QStringLiteral("kweather"));
+    KLocalizedString::setApplicationDomain("kweather");
+    QStandardPaths::setTestModeEnabled(true); // never touch the real config and cache
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption(QStringLiteral("locations"), QStringLiteral("number of synthetic locations"), QStringLiteral("n"), QStringLiteral("500")));
+    parser.addOption(QCommandLineOption(QStringLiteral("backend"), QStringLiteral("nmi or owm"), QStringLiteral("backend"), QStringLiteral("nmi")));
+    parser.addOption(QCommandLineOption(QStringLiteral("timeout"), QStringLiteral("give up after this many seconds"), QStringLiteral("secs"), QStringLiteral("300")));
+    parser.process(app);
+    const int count = parser.value(QStringLiteral("locations")).toInt();
+    const int backend = parser.value(QStringLiteral("backend")) == QLatin1String("owm") ? 1 : 0;
+    QTextStream out(stdout);
+
+    // the server runs in its own thread, so that it does not count as gui thread time
+    QThread serverThread;
+    auto server = new StandInServer;
+    server->moveToThread(&serverThread);
+    QObject::connect(&serverThread, &QThread::finished, server, &QObject::deleteLater);
+    serverThread.start();
+    quint16 port = 0;
+    QMetaObject::invokeMethod(server, "start", Qt::BlockingQueuedConnection, Q_RETURN_ARG(quint16, port));
+    AbstractWeatherAPI::setServerOverride(QUrl(QStringLiteral("http://127.0.0.1:%1").arg(port)));
+
+    QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation)).removeRecursively(); // fetch everything
+    writeLocations(count, backend);
+
+    // sample the event loop every 10 ms, whatever is late was spent blocked
+    qint64 blocked = 0, longestStall = 0;
+    QElapsedTimer tick;
+    QTimer probe;
+    probe.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&probe, &QTimer::timeout, [&] {
+        const qint64 late = tick.restart() - 10;
+        if (late > 0) {
+            blocked += late;
+            longestStall = std::max(longestStall, late);
+        }
+    });
+
+    QPair<int, int> peakFds = fileDescriptors();
+    QTimer fdSampler;
+    QObject::connect(&fdSampler, &QTimer::timeout, [&peakFds] {
+        const auto fds = fileDescriptors();
+        peakFds.first = std::max(peakFds.first, fds.first);
+        peakFds.second = std::max(peakFds.second, fds.second);
+    });
+
+    const qint64 baseline = residentBytes();
+    QElapsedTimer wallTime;
+    wallTime.start();
+    tick.start();
+    probe.start(10);
+    fdSampler.start(100);
+
+    WeatherLocationListModel model;
+    QSet<QString> refreshed;
+    for (auto location : model.getList()) {
+        // create the ui models too, they are part of every refresh
+        location->weatherHourListModel();
+        location->weatherDayListModel();
+        const QString id = location->locationId();
+        QObject::connect(location, &WeatherLocation::weatherRefresh, &app, [&, id] {
+            refreshed.insert(id);
+            if (refreshed.count() == count)
+                app.quit();
+        });
+    }
+    const qint64 modelTime = wallTime.elapsed();
+    WeatherForecastManager::instance(model);
+
+    QTimer::singleShot(parser.value(QStringLiteral("timeout")).toInt() * 1000, &app, &QCoreApplication::quit);
+    app.exec();
+    const qint64 refreshTime = wallTime.elapsed();
+    probe.stop();
+    fdSampler.stop();
+
+    // let the sunrise replies and deferred deletes drain before measuring memory
+    QTimer::singleShot(500, &app, &QCoreApplication::quit);
+    app.exec();
+    const qint64 resident = residentBytes();
+    const auto fds = fileDescriptors();
+
+    // history and verification are written off the gui thread, wait for them to be done
+    QElapsedTimer drain;
+    drain.start();
+    while (HistoryWorker::instance().pending() > 0 && drain.elapsed() < 60000)
+        QThread::msleep(10);
+
+    out << "locations:            " << count << (backend ? " (owm)" : " (nmi)") << '\n';
+    out << "refreshed:            " << refreshed.count() << '\n';
+    out << "model load:           " << modelTime << " ms\n";
+    out << "refresh wall time:    " << refreshTime << " ms\n";
+    out << "memory per location:  " << QString::number((resident - baseline) / 1024.0 / std::max(count, 1), 'f', 1) << " KiB"
+        << " (resident " << resident / (1024 * 1024) << " MiB, baseline " << baseline / (1024 * 1024) << " MiB)\n";
+    out << "gui thread blocked:   " << blocked << " ms total, longest stall " << longestStall << " ms\n";
+    // the stand-in server lives in this process, its end of every connection is counted too
+    out << "file descriptors:     peak " << peakFds.first << " (sockets " << peakFds.second << "), after refresh " << fds.first << " (sockets " << fds.second << ")\n";
+    out << "requests served:      " << server->requests.load() << '\n';
+    out << "history thread busy:  " << HistoryWorker::instance().busyMsecs() << " ms (" << HistoryWorker::instance().pending() << " runs left)\n";
+    out.flush();
+
+    serverThread.quit();
+    serverThread.wait();
+    return refreshed.count() == count ? 0 : 1;
+}
@@ -0,0 +1,507 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "abstractweatherforecast.h"
+#include "aggregation.h"
+#include "arena.h"
+#include "backendhealthtracker.h"
+#include "blendedweatherapi.h"
+#include "contenthash.h"
+#include "derivedquantities.h"
+#include "forecasthistory.h"
+#include "forecastverification.h"
+#include "hedgebudget.h"
+#include "interpolation.h"
+#include "jsondecoder.h"
+#include "metrics.h"
+#include "nmiweatherapi2.h"
+#include "owmweatherapi.h"
+#include "timestamp.h"
+#include "weatherchartmodel.h"
+
+#include <KLocalizedString>
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <cmath>
+#include <limits>
+
+Q_DECLARE_METATYPE(Aggregation::Window)
+
+// what the code timed in kweatherbenchmarks computes, against the same recorded payloads
+class KWeatherTests : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+
+    void timestamps();
+    void decoders_data();
+    void decoders();
+    void contentHash();
+    void aggregate_data();
+    void aggregate();
+    void derivedQuantities();
+    void cachedWithoutDerivedQuantities();
+    void interpolate();
+    void chartModel_data();
+    void chartModel();
+    void historyAppend();
+    void historyQuery();
+    void verification();
+    void hedgeBudget();
+    void blend();
+    void healthTracking();
+
+private:
+    static QByteArray readData(const QString &fileName);
+
+    QByteArray m_nmiData, m_owmData;
+    QStringList m_times; // every timeseries time of the nmi payload
+    AbstractWeatherForecast m_forecast; // parsed from the nmi payload
+};
+
+QByteArray KWeatherTests::readData(const QString &fileName)
+{
+    QFile file(QFINDTESTDATA(QStringLiteral("data/") + fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+void KWeatherTests::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    KLocalizedString::setApplicationDomain("kweather");
+
+    m_nmiData = readData(QStringLiteral("nmi_complete.json"));
+    m_owmData = readData(QStringLiteral("owm_forecast.json"));
+    QVERIFY(!m_nmiData.isEmpty());
+    QVERIFY(!m_owmData.isEmpty());
+
+    const auto timeseries = QJsonDocument::fromJson(m_nmiData)[QLatin1String("properties")].toObject()[QLatin1String("timeseries")].toArray();
+    for (const auto &entry : timeseries)
+        m_times.append(entry.toObject()[QLatin1String("time")].toString());
+    QVERIFY(!m_times.isEmpty());
+
+    JsonDecoder::setUseSimd(false);
+    NMIWeatherAPI2 api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    api.parseData(m_nmiData);
+    m_forecast = api.currentData();
+    QVERIFY(!m_forecast.hourlyForecasts().isEmpty());
+    QVERIFY(!m_forecast.dailyForecasts().isEmpty());
+}
+
+void KWeatherTests::timestamps()
+{
+    // the same as the qt parser
+    for (const auto &time : qAsConst(m_times)) {
+        qint64 secs = 0;
+        QVERIFY(Timestamp::toEpoch(time, secs));
+        QCOMPARE(secs, QDateTime::fromString(time, Qt::ISODate).toSecsSinceEpoch());
+        QCOMPARE(Timestamp::toDateTime(time), QDateTime::fromString(time, Qt::ISODate));
+    }
+
+    // days a month does not have are rejected, as the qt parser does
+    qint64 secs = 0;
+    for (const char *time : {"2021-02-29T00:00:00Z", "2021-02-30T00:00:00Z", "2021-04-31T00:00:00Z", "2100-02-29T00:00:00Z"}) {
+        QVERIFY(!Timestamp::toEpoch(QString::fromLatin1(time), secs));
+        QVERIFY(!Timestamp::toDateTime(QString::fromLatin1(time)).isValid());
+    }
+    for (const char *time : {"2020-02-29T00:00:00Z", "2000-02-29T00:00:00Z"}) {
+        QVERIFY(Timestamp::toEpoch(QString::fromLatin1(time), secs));
+        QCOMPARE(secs, QDateTime::fromString(QString::fromLatin1(time), Qt::ISODate).toSecsSinceEpoch());
+    }
+}
+
+void KWeatherTests::decoders_data()
+{
+    QTest::addColumn<bool>("simd");
+    QTest::newRow("QJsonDocument") << false;
+    if (JsonDecoder::simdAvailable())
+        QTest::newRow("simdjson") << true;
+}
+
+void KWeatherTests::decoders()
+{
+    QFETCH(bool, simd);
+    JsonDecoder::setUseSimd(simd);
+
+    // whichever decoder ran, the forecast is the one of the reference parse
+    NMIWeatherAPI2 nmi(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    nmi.parseData(m_nmiData);
+    auto hours = nmi.currentData().hourlyForecasts(), expectedHours = m_forecast.hourlyForecasts();
+    QCOMPARE(hours.count(), expectedHours.count());
+    for (int i = 0; i < hours.count(); i++)
+        QCOMPARE(hours[i].toJson(), expectedHours[i].toJson());
+
+    OWMWeatherAPI owm(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    owm.parseData(m_owmData);
+    QCOMPARE(owm.currentData().hourlyForecasts().count(), 40 * 3); // three hour steps resampled to hourly
+    JsonDecoder::setUseSimd(false);
+}
+
+void KWeatherTests::contentHash()
+{
+    QCOMPARE(ContentHash::of(m_nmiData), ContentHash::of(QByteArray(m_nmiData.constData(), m_nmiData.size())));
+
+    // timeCreated does not count
+    AbstractWeatherForecast later = m_forecast;
+    later.setTimeCreated(later.timeCreated().addSecs(3600));
+    QCOMPARE(later.contentHash(), m_forecast.contentHash());
+}
+
+void KWeatherTests::aggregate_data()
+{
+    QTest::addColumn<Aggregation::Window>("window");
+    QTest::newRow("day") << Aggregation::Window::Day;
+    QTest::newRow("day part") << Aggregation::Window::DayPart;
+    QTest::newRow("3 hours") << Aggregation::Window::ThreeHours;
+}
+
+void KWeatherTests::aggregate()
+{
+    QFETCH(Aggregation::Window, window);
+    MonotonicArena arena;
+    Aggregation::Series series(arena);
+    for (const auto &hour : m_forecast.hourlyForecasts()) {
+        series.append(hour.date().toSecsSinceEpoch() + hour.date().offsetFromUtc(),
+                      hour.temperature(),
+                      hour.temperature(),
+                      hour.temperature(),
+                      hour.precipitationAmount(),
+                      hour.uvIndex(),
+                      hour.humidity(),
+                      hour.pressure(),
+                      Aggregation::rank(hour.neutralWeatherIcon()));
+    }
+    Aggregation::Column<Aggregation::Summary> summaries{ArenaAllocator<Aggregation::Summary>(arena)};
+    Aggregation::aggregate(series, window, summaries);
+
+    int hours = 0;
+    for (const auto &summary : summaries)
+        hours += summary.count;
+    QCOMPARE(hours, series.size());
+    if (window == Aggregation::Window::Day) {
+        // the hours run until the period of the last step ends, which may start another day
+        QSet<QDate> dates;
+        for (const auto &hour : m_forecast.hourlyForecasts())
+            dates.insert(hour.date().date());
+        QCOMPARE(static_cast<int>(summaries.size()), dates.size());
+    }
+}
+
+void KWeatherTests::derivedQuantities()
+{
+    QList<AbstractHourlyWeatherForecast> hours = m_forecast.hourlyForecasts();
+    DerivedQuantities::apply(hours);
+    for (const auto &hour : qAsConst(hours)) {
+        QVERIFY(hour.dewPoint() <= hour.temperature() + 0.01f);
+        QVERIFY(hour.windChill() <= hour.temperature());
+        QVERIFY(hour.heatIndex() >= hour.temperature() - 1);
+        QCOMPARE(hour.windSector(), DerivedQuantities::windSector(hour.windDegrees()));
+        QCOMPARE(hour.beaufort(), DerivedQuantities::beaufort(hour.windSpeed()));
+    }
+    // every sector of eight points, and its edges
+    QCOMPARE(DerivedQuantities::windDirection(0), Kweather::WindDirection::S);
+    QCOMPARE(DerivedQuantities::windDirection(22.4f), Kweather::WindDirection::S);
+    QCOMPARE(DerivedQuantities::windDirection(22.5f), Kweather::WindDirection::SW);
+    QCOMPARE(DerivedQuantities::windDirection(90), Kweather::WindDirection::W);
+    QCOMPARE(DerivedQuantities::windDirection(135), Kweather::WindDirection::NW);
+    QCOMPARE(DerivedQuantities::windDirection(180), Kweather::WindDirection::N);
+    QCOMPARE(DerivedQuantities::windDirection(225), Kweather::WindDirection::NE);
+    QCOMPARE(DerivedQuantities::windDirection(270), Kweather::WindDirection::E);
+    QCOMPARE(DerivedQuantities::windDirection(315), Kweather::WindDirection::SE);
+    QCOMPARE(DerivedQuantities::windDirection(340), Kweather::WindDirection::S);
+    QCOMPARE(DerivedQuantities::windDirection(360), Kweather::WindDirection::S);
+}
+
+// a cache from before the derived quantities were kept computes them on load
+void KWeatherTests::cachedWithoutDerivedQuantities()
+{
+    AbstractHourlyWeatherForecast hour = m_forecast.hourlyForecasts().first();
+    QJsonObject json = hour.toJson();
+    json.remove(QStringLiteral("windChill"));
+    json.remove(QStringLiteral("beaufort"));
+    const AbstractHourlyWeatherForecast loaded = AbstractHourlyWeatherForecast::fromJson(json);
+    QCOMPARE(loaded.windChill(), hour.windChill());
+    QCOMPARE(loaded.beaufort(), hour.beaufort());
+    QCOMPARE(loaded.dewPoint(), hour.dewPoint());
+}
+
+// every third hour back to hourly, as from owm
+void KWeatherTests::interpolate()
+{
+    QList<AbstractHourlyWeatherForecast> steps;
+    float total = 0;
+    for (int i = 0; i < m_forecast.hourlyForecasts().count(); i += 3) {
+        AbstractHourlyWeatherForecast hour = m_forecast.hourlyForecasts().at(i);
+        hour.setPrecipitationAmount(i + 1); // made up, each period its own amount
+        total += hour.precipitationAmount();
+        steps.append(hour);
+    }
+    QVERIFY(steps.count() > 2);
+    MonotonicArena arena;
+    QList<AbstractHourlyWeatherForecast> hours = steps;
+    Interpolation::resample(hours, 3600, arena);
+
+    QCOMPARE(hours.count(), steps.count() * 3);
+    float sum = 0;
+    for (int i = 0; i < hours.count(); i++) {
+        const auto &hour = hours.at(i);
+        sum += hour.precipitationAmount();
+        QCOMPARE(hour.interpolated(), i % 3 != 0);
+        if (i % 3 == 0) {
+            QCOMPARE(hour.date(), steps.at(i / 3).date());
+            QCOMPARE(hour.temperature(), steps.at(i / 3).temperature());
+        } else if (i / 3 + 1 < steps.count()) {
+            // monotone, never beyond the points around it
+            const float a = steps.at(i / 3).temperature(), b = steps.at(i / 3 + 1).temperature();
+            QVERIFY(hour.temperature() >= std::min(a, b) - 0.001f && hour.temperature() <= std::max(a, b) + 0.001f);
+        }
+    }
+    QVERIFY(qAbs(sum - total) < total * 1e-4f);
+}
+
+void KWeatherTests::chartModel_data()
+{
+    QTest::addColumn<int>("hours");
+    QTest::addColumn<int>("points");
+    QTest::newRow("all days, narrow") << 0 << 24;
+    QTest::newRow("all days, wide") << 0 << 96;
+    QTest::newRow("24 hours") << 24 << 24;
+}
+
+void KWeatherTests::chartModel()
+{
+    QFETCH(int, hours);
+    QFETCH(int, points);
+    WeatherChartModel model;
+    AbstractWeatherForecast forecast = m_forecast;
+    model.refreshFromForecast(forecast);
+    model.setHours(hours);
+    model.setMaximumPoints(points);
+
+    const int rows = model.rowCount(QModelIndex());
+    QVERIFY(rows <= points);
+    QVERIFY(rows >= 2);
+    // the ends always stay
+    const auto &first = m_forecast.hourlyForecasts().first();
+    QCOMPARE(model.data(model.index(0), WeatherChartModel::DateRole).toDateTime(), first.date());
+    QCOMPARE(model.data(model.index(0), WeatherChartModel::TemperatureRole).toFloat(), first.temperature());
+    const QDateTime last = model.data(model.index(rows - 1), WeatherChartModel::DateRole).toDateTime();
+    if (hours)
+        QVERIFY(first.date().secsTo(last) < hours * 3600);
+    else
+        QCOMPARE(last, m_forecast.hourlyForecasts().last().date());
+    // no rain gets lost to the downsampling
+    if (!hours) {
+        float shown = 0, total = 0;
+        for (int row = 0; row < rows; row++)
+            shown += model.data(model.index(row), WeatherChartModel::PrecipitationRole).toFloat();
+        for (const auto &hour : m_forecast.hourlyForecasts())
+            total += hour.precipitationAmount();
+        QVERIFY(qAbs(shown - total) < 0.01f);
+    }
+}
+
+void KWeatherTests::historyAppend()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("oslo")));
+    const auto &hours = m_forecast.hourlyForecasts();
+    const qint64 issued = m_forecast.timeCreated().toSecsSinceEpoch();
+    const int runs = 24;
+    for (int i = 0; i < runs; i++)
+        QVERIFY(history.append(issued + 3600 * i, Kweather::Backend::NMI, hours, issued));
+    QCOMPARE(history.runs().count(), runs);
+    const double bytesPerValue = static_cast<double>(history.fileSize()) / (runs * hours.count() * 6);
+    QVERIFY2(bytesPerValue < 4, qPrintable(QStringLiteral("%1 bytes per stored value").arg(bytesPerValue)));
+
+    // a crash in the middle of an append, the runs after it must still be found
+    const qint64 intact = history.fileSize();
+    QFile file(dir.filePath(QStringLiteral("oslo")));
+    QVERIFY(file.open(QIODevice::Append));
+    file.write(QByteArray(20, 'x'));
+    file.close();
+    ForecastHistory reopened(dir.filePath(QStringLiteral("oslo")));
+    QVERIFY(reopened.append(issued + 3600 * runs, Kweather::Backend::OWM, hours, issued));
+    QCOMPARE(reopened.runs().count(), runs + 1);
+    QCOMPARE(ForecastHistory(dir.filePath(QStringLiteral("oslo"))).runs().count(), runs + 1);
+    QCOMPARE(reopened.query(0, std::numeric_limits<qint64>::max(), issued + 3600 * runs).count(), hours.count());
+    QVERIFY(reopened.fileSize() > intact);
+
+    // the same run again, as when it is republished with the sunrise data
+    const qint64 size = reopened.fileSize();
+    QVERIFY(!reopened.append(issued + 3600 * runs, Kweather::Backend::OWM, hours, issued));
+    QCOMPARE(reopened.runs().count(), runs + 1);
+    QCOMPARE(reopened.fileSize(), size);
+}
+
+void KWeatherTests::historyQuery()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("oslo")));
+    history.setRetention(10 * 86400);
+    const auto &hours = m_forecast.hourlyForecasts();
+    const qint64 issued = m_forecast.timeCreated().toSecsSinceEpoch();
+    // two weeks of hourly runs, the first few days expire once past the slack
+    const int runs = 14 * 24;
+    for (int i = 0; i < runs; i++)
+        QVERIFY(history.append(issued + 3600 * i, i % 2 ? Kweather::Backend::OWM : Kweather::Backend::NMI, hours, issued + 3600 * i));
+    QVERIFY(history.runs().first().issued >= issued + 3600 * (runs - 1) - 11 * 86400);
+
+    // everything the runs of the last day said about one hour
+    const qint64 valid = hours.at(hours.count() / 2).date().toSecsSinceEpoch();
+    const qint64 lastIssued = issued + 3600 * (runs - 1);
+    const QVector<ForecastHistory::Point> points = history.query(valid, valid + 1, lastIssued - 86400, lastIssued + 1);
+    QCOMPARE(points.count(), 25);
+    for (const auto &point : points) {
+        QCOMPARE(point.valid, valid);
+        QCOMPARE(point.temperature, hours.at(hours.count() / 2).temperature());
+        QCOMPARE(point.precipitation, hours.at(hours.count() / 2).precipitationAmount());
+        QCOMPARE(point.windDegrees, hours.at(hours.count() / 2).windDegrees());
+        QCOMPARE(point.interpolated, hours.at(hours.count() / 2).interpolated());
+        QCOMPARE(point.backend, (point.issued - issued) / 3600 % 2 ? Kweather::Backend::OWM : Kweather::Backend::NMI);
+    }
+}
+
+// nmi hourly on the hour, owm half an hour later and two degrees warmer, so the
+// nmi run of the hour is always the nowcast
+void KWeatherTests::verification()
+{
+    QTemporaryDir dir;
+    ForecastHistory history(dir.filePath(QStringLiteral("history")));
+    const auto &hours = m_forecast.hourlyForecasts();
+    auto warmer = hours;
+    for (auto &hour : warmer)
+        hour.setTemperature(hour.temperature() + 2);
+    const qint64 first = hours.first().date().toSecsSinceEpoch() - 24 * 3600;
+    const int runs = 4 * 24;
+    for (int i = 0; i < runs; i++) {
+        QVERIFY(history.append(first + 3600 * i, Kweather::Backend::NMI, hours, first + 3600 * i));
+        QVERIFY(history.append(first + 3600 * i + 1800, Kweather::Backend::OWM, warmer, first + 3600 * i + 1800));
+    }
+    const qint64 now = first + 3600 * runs;
+
+    const QString path = dir.filePath(QStringLiteral("verification"));
+    const int scored = ForecastVerification(path).update(history, now);
+    QVERIFY(scored > 0);
+
+    // read back as saved
+    ForecastVerification verification(path);
+    QCOMPARE(verification.verifiedUntil(), now);
+    quint64 count = 0;
+    for (int bucket = 0; bucket < ForecastVerification::LEAD_BUCKETS; bucket++) {
+        const auto &nmi = verification.stats(Kweather::Backend::NMI, bucket, ForecastVerification::Temperature);
+        const auto &owm = verification.stats(Kweather::Backend::OWM, bucket, ForecastVerification::Temperature);
+        count += nmi.count + owm.count;
+        if (nmi.count > 0)
+            QVERIFY(nmi.rmse() < 1e-6);
+        if (owm.count > 0) {
+            QVERIFY(qAbs(owm.mean - 2) < 1e-4);
+            QVERIFY(qAbs(owm.meanAbsolute - 2) < 1e-4);
+            QVERIFY(owm.standardDeviation() < 1e-4);
+        }
+    }
+    QVERIFY(count > 0 && count <= static_cast<quint64>(scored));
+    QVERIFY(verification.toJson().contains(QStringLiteral("owm")));
+}
+
+// every backend being slow still adds no more than the budget
+void KWeatherTests::hedgeBudget()
+{
+    for (int i = 0; i < 200; i++)
+        Metrics::instance().record(QStringLiteral("kweather_request_latency_microseconds"), QStringLiteral("nmi"), i % 2 ? QStringLiteral("a") : QStringLiteral("b"), (i + 1) * 5000);
+    // both hosts together, 5 ms to 1 s
+    const int delay = HedgeBudget::delay(QStringLiteral("nmi"));
+    QVERIFY(delay >= 880 && delay <= 940);
+
+    HedgeBudget &budget = HedgeBudget::instance();
+    budget.setRatio(0.1);
+    while (budget.withdraw()) { }
+    int hedges = 0;
+    for (int i = 0; i < 1000; i++) {
+        budget.deposit();
+        hedges += budget.withdraw();
+    }
+    QVERIFY(hedges >= 99 && hedges <= 100);
+}
+
+void KWeatherTests::blend()
+{
+    OWMWeatherAPI api(QStringLiteral("oslo"), QStringLiteral("Europe/Oslo"), 59.9127, 10.7461);
+    api.parseData(m_owmData);
+    // the owm sample is of another day, moved onto the first hours of the nmi one
+    auto owm = api.currentData().hourlyForecasts();
+    const auto &nmi = m_forecast.hourlyForecasts();
+    for (int i = 0; i < owm.count(); i++)
+        owm[i].setDate(nmi.first().date().addSecs(3600 * i));
+    QVERIFY(nmi.count() > owm.count());
+
+    // nothing scored yet, both count the same
+    const BlendedWeatherAPI::Weights even = BlendedWeatherAPI::weightsFor(ForecastVerification(QStringLiteral("/nonexistent")));
+    QCOMPARE(even.temperature, 0.5f);
+    QCOMPARE(even.precipitation, 0.5f);
+
+    BlendedWeatherAPI::Weights weights;
+    weights.temperature = 0.7f;
+    QList<AbstractHourlyWeatherForecast> hours;
+    const float spread = BlendedWeatherAPI::blend(nmi, owm, weights, hours);
+    QCOMPARE(hours.count(), nmi.count());
+    QVERIFY(spread > 0);
+    for (int i = 0; i < hours.count(); i++) {
+        const float a = nmi.at(i).temperature();
+        if (i < owm.count()) {
+            const float b = owm.at(i).temperature();
+            QVERIFY(qAbs(hours.at(i).temperature() - (0.7f * a + 0.3f * b)) < 1e-4f);
+            QVERIFY(qAbs(hours.at(i).temperatureSpread() - std::sqrt(0.21f) * qAbs(a - b)) < 1e-4f);
+        } else {
+            QCOMPARE(hours.at(i).temperature(), a);
+            QCOMPARE(hours.at(i).temperatureSpread(), 0.0f);
+        }
+    }
+}
+
+// the hysteresis both ways
+void KWeatherTests::healthTracking()
+{
+    BackendHealthTracker &tracker = BackendHealthTracker::instance();
+    tracker.record(Kweather::Backend::OWM, true, 300);
+    QVERIFY(tracker.isHealthy(Kweather::Backend::OWM));
+
+    int changes = 0; // Kweather::Backend is no meta type, so no QSignalSpy
+    QMetaObject::Connection counting = connect(&tracker, &BackendHealthTracker::healthChanged, this, [&changes] { changes++; });
+    tracker.record(Kweather::Backend::NMI, true, 300);
+    tracker.record(Kweather::Backend::NMI, false, 300);
+    tracker.record(Kweather::Backend::NMI, false, 300);
+    tracker.record(Kweather::Backend::NMI, true, 20000); // too late
+    QVERIFY(!tracker.isHealthy(Kweather::Backend::NMI));
+    QCOMPARE(changes, 1);
+
+    // back only after it was down for a while, the successes alone are not enough
+    for (int i = 0; i < 5; i++)
+        tracker.record(Kweather::Backend::NMI, true, 300);
+    QVERIFY(!tracker.isHealthy(Kweather::Backend::NMI));
+    QVERIFY(tracker.isHealthy(Kweather::Backend::Blend)); // owm is still there
+    QVERIFY(tracker.claimProbe(Kweather::Backend::NMI));
+    QVERIFY(!tracker.claimProbe(Kweather::Backend::NMI)); // one location probes
+    QCOMPARE(changes, 1);
+    disconnect(counting);
+}
+
+QTEST_GUILESS_MAIN(KWeatherTests)
+
+#include "kweathertests.moc"
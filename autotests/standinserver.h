@@ -0,0 +1,126 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_STANDINSERVER_H
+#define KWEATHER_STANDINSERVER_H
+
+#include <QFile>
+#include <QHash>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include <atomic>
+
+static const char NMI_FORECAST[] = "/weatherapi/locationforecast/2.0/complete";
+static const char OWM_FORECAST[] = "/data/2.5/forecast";
+static const char NMI_SUNRISE[] = "/weatherapi/sunrise/2.0/.json";
+
+// A local stand-in for the weather servers, see AbstractWeatherAPI::setServerOverride().
+// Answers every GET with the recorded payload for its path, keep-alive, no chunking.
+// Answers for a path may be held back or replaced by an error status, a reply held
+// back is never sent once the client dropped the connection.
+//
+// The counters and settings belong to the thread the server runs in.
+class StandInServer : public QTcpServer
+{
+    Q_OBJECT
+
+public:
+    StandInServer()
+    {
+        m_payloads[NMI_FORECAST] = readData(QStringLiteral("nmi_complete.json"));
+        m_payloads[OWM_FORECAST] = readData(QStringLiteral("owm_forecast.json"));
+        m_payloads[NMI_SUNRISE] = readData(QStringLiteral("nmi_sunrise.json"));
+    }
+
+    std::atomic<int> requests{0};
+
+    void setDelay(const QByteArray &path, int msecs)
+    {
+        m_delays[path] = msecs;
+    }
+    void setStatus(const QByteArray &path, int status) // 200 for the payload
+    {
+        m_statuses[path] = status;
+    }
+    int requested(const QByteArray &path) const
+    {
+        return m_requested.value(path);
+    }
+    int answered(const QByteArray &path) const
+    {
+        return m_answered.value(path);
+    }
+
+public slots:
+    quint16 start()
+    {
+        listen(QHostAddress::LocalHost);
+        return serverPort();
+    }
+
+protected:
+    void incomingConnection(qintptr handle) override
+    {
+        auto socket = new QTcpSocket(this);
+        socket->setSocketDescriptor(handle);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket] { serve(socket); });
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket] {
+            m_buffers.remove(socket);
+            socket->deleteLater();
+        });
+    }
+
+private:
+    static QByteArray readData(const QString &fileName)
+    {
+        QFile file(QStringLiteral(KWEATHER_TEST_DATA_DIR "/") + fileName);
+        file.open(QIODevice::ReadOnly);
+        return file.readAll();
+    }
+
+    void serve(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+        int end;
+        while ((end = buffer.indexOf("\r\n\r\n")) >= 0) {
+            const QByteArray target = buffer.left(end).split(' ').value(1);
+            buffer.remove(0, end + 4);
+            requests++;
+
+            const int query = target.indexOf('?');
+            const QByteArray path = query < 0 ? target : target.left(query);
+            m_requested[path]++;
+            const int delay = m_delays.value(path);
+            if (delay > 0) // the socket is gone, and the answer with it, once the client cancels
+                QTimer::singleShot(delay, socket, [this, socket, path] { answer(socket, path); });
+            else
+                answer(socket, path);
+        }
+    }
+
+    void answer(QTcpSocket *socket, const QByteArray &path)
+    {
+        m_answered[path]++;
+        const int status = m_statuses.value(path, 200);
+        const QByteArray body = status == 200 ? m_payloads.value(path) : QByteArray();
+        if (status != 200)
+            socket->write("HTTP/1.1 " + QByteArray::number(status) + " Error\r\n");
+        else
+            socket->write(body.isEmpty() ? "HTTP/1.1 404 Not Found\r\n" : "HTTP/1.1 200 OK\r\n");
+        socket->write("Content-Type: application/json\r\nContent-Length: " + QByteArray::number(body.size()) + "\r\n\r\n");
+        socket->write(body);
+    }
+
+    QHash<QByteArray, QByteArray> m_payloads;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QHash<QByteArray, int> m_delays, m_statuses, m_requested, m_answered;
+};
+
+#endif // KWEATHER_STANDINSERVER_H
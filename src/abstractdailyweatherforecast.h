@@ -79,11 +79,11 @@ public:
     {
         return pressure_;
     }
-    inline QString &weatherIcon()
+    inline const QString &weatherIcon() const
     {
         return weatherIcon_;
     };
-    inline QString &weatherDescription()
+    inline const QString &weatherDescription() const
     {
         return weatherDescription_;
     }
@@ -6,8 +6,12 @@
  */
 
 #include "abstracthourlyweatherforecast.h"
+#include "derivedquantities.h"
+#include "timestamp.h"
 
 #include <QJsonObject>
+#include <algorithm>
+#include <iterator>
 #include <utility>
 
 AbstractHourlyWeatherForecast::AbstractHourlyWeatherForecast()
@@ -48,7 +52,7 @@ AbstractHourlyWeatherForecast::AbstractHourlyWeatherForecast(QDateTime date,
 AbstractHourlyWeatherForecast AbstractHourlyWeatherForecast::fromJson(QJsonObject obj)
 {
     AbstractHourlyWeatherForecast fc;
-    fc.setDate(QDateTime::fromString(obj["date"].toString(), Qt::ISODate));
+    fc.setDate(Timestamp::toDateTime(obj["date"].toString()));
     fc.setWeatherDescription(obj["weatherDescription"].toString());
     fc.setWeatherIcon(obj["weatherIcon"].toString());
     fc.setNeutralWeatherIcon(obj["neutralWeatherIcon"].toString());
@@ -60,6 +64,23 @@ AbstractHourlyWeatherForecast AbstractHourlyWeatherForecast::fromJson(QJsonObjec
     fc.setFog(obj["fog"].toDouble());
     fc.setUvIndex(obj["uvIndex"].toDouble());
     fc.setPrecipitationAmount(obj["precipitationAmount"].toDouble());
+    // caches written before degrees were kept only know the eight point direction
+    fc.setWindDegrees(obj.contains(QLatin1String("windDegrees")) ? obj["windDegrees"].toDouble() : DerivedQuantities::windDegrees(fc.windDirection()));
+    fc.setApparentTemperature(obj["apparentTemperature"].toDouble());
+    fc.setDewPoint(obj["dewPoint"].toDouble());
+    fc.setWindChill(obj["windChill"].toDouble());
+    fc.setHeatIndex(obj["heatIndex"].toDouble());
+    fc.setWindSector(obj["windSector"].toInt());
+    fc.setBeaufort(obj["beaufort"].toInt());
+    fc.setInterpolated(obj["interpolated"].toBool());
+    fc.setTemperatureSpread(obj["temperatureSpread"].toDouble());
+    // caches written before the derived quantities were kept, computed from the rest
+    static const char *const derived[] = {"apparentTemperature", "dewPoint", "windChill", "heatIndex", "windSector", "beaufort"};
+    if (std::any_of(std::begin(derived), std::end(derived), [&obj](const char *key) { return !obj.contains(QLatin1String(key)); })) {
+        QList<AbstractHourlyWeatherForecast> hour {fc};
+        DerivedQuantities::apply(hour);
+        return hour.first();
+    }
     return fc;
 }
 
@@ -78,5 +99,14 @@ QJsonObject AbstractHourlyWeatherForecast::toJson()
     obj[QLatin1String("fog")] = fog();
     obj[QLatin1String("uvIndex")] = uvIndex();
     obj[QLatin1String("precipitationAmount")] = precipitationAmount();
+    obj[QLatin1String("windDegrees")] = windDegrees();
+    obj[QLatin1String("apparentTemperature")] = apparentTemperature();
+    obj[QLatin1String("dewPoint")] = dewPoint();
+    obj[QLatin1String("windChill")] = windChill();
+    obj[QLatin1String("heatIndex")] = heatIndex();
+    obj[QLatin1String("windSector")] = windSector();
+    obj[QLatin1String("beaufort")] = beaufort();
+    obj[QLatin1String("interpolated")] = interpolated();
+    obj[QLatin1String("temperatureSpread")] = temperatureSpread();
     return obj;
 }
@@ -138,6 +138,82 @@ public:
     {
         precipitationAmount_ = precipitationAmount;
     }
+    float windDegrees() const
+    {
+        return windDegrees_;
+    }
+    void setWindDegrees(float windDegrees)
+    {
+        windDegrees_ = windDegrees;
+    }
+    // between the steps of the backend, see Interpolation::resample()
+    bool interpolated() const
+    {
+        return interpolated_;
+    }
+    void setInterpolated(bool interpolated)
+    {
+        interpolated_ = interpolated;
+    }
+    // how far the backends of a blend disagree, see BlendedWeatherAPI; 0 otherwise
+    float temperatureSpread() const
+    {
+        return temperatureSpread_;
+    }
+    void setTemperatureSpread(float temperatureSpread)
+    {
+        temperatureSpread_ = temperatureSpread;
+    }
+
+    // derived from the fields above by DerivedQuantities::apply()
+    float apparentTemperature() const
+    {
+        return apparentTemperature_;
+    }
+    void setApparentTemperature(float apparentTemperature)
+    {
+        apparentTemperature_ = apparentTemperature;
+    }
+    float dewPoint() const
+    {
+        return dewPoint_;
+    }
+    void setDewPoint(float dewPoint)
+    {
+        dewPoint_ = dewPoint;
+    }
+    float windChill() const
+    {
+        return windChill_;
+    }
+    void setWindChill(float windChill)
+    {
+        windChill_ = windChill;
+    }
+    float heatIndex() const
+    {
+        return heatIndex_;
+    }
+    void setHeatIndex(float heatIndex)
+    {
+        heatIndex_ = heatIndex;
+    }
+    int windSector() const
+    {
+        return windSector_;
+    }
+    void setWindSector(int windSector)
+    {
+        windSector_ = windSector;
+    }
+    int beaufort() const
+    {
+        return beaufort_;
+    }
+    void setBeaufort(int beaufort)
+    {
+        beaufort_ = beaufort;
+    }
 
 private:
     QDateTime date_;
@@ -147,12 +223,21 @@ private:
     QString symbolCode_;
     float temperature_ {}; // celsius
     float pressure_ {};    // hPa
-    Kweather::WindDirection windDirection_;
+    Kweather::WindDirection windDirection_ {};
     float windSpeed_ {};           // m/s
     float humidity_ {};            // %
     float fog_ {};                 // %
     float uvIndex_ {};             // 0-1
     float precipitationAmount_ {}; // mm
+    float windDegrees_ {};         // where the wind comes from
+    float temperatureSpread_ {};   // celsius, standard deviation of the blended backends
+    float apparentTemperature_ {}; // celsius
+    float dewPoint_ {};            // celsius
+    float windChill_ {};           // celsius
+    float heatIndex_ {};           // celsius
+    int windSector_ {};            // 0 = N, clockwise, 16 points
+    int beaufort_ {};
+    bool interpolated_ = false;
 };
 
 #endif // KWEATHER_ABSTRACTHOURLYWEATHERFORECAST_H
@@ -5,6 +5,7 @@
  * SPDX-License-Identifier: GPL-2.0-or-later
  */
 #include "abstractsunrise.h"
+#include "timestamp.h"
 #include <QJsonObject>
 AbstractSunrise::AbstractSunrise()
 {
@@ -53,14 +54,14 @@ QJsonObject AbstractSunrise::toJson()
 AbstractSunrise AbstractSunrise::fromJson(QJsonObject obj)
 {
     AbstractSunrise as;
-    as.setSunSet(QDateTime::fromString(obj["sunset"].toString(), Qt::ISODate));
-    as.setSunRise(QDateTime::fromString(obj["sunrise"].toString(), Qt::ISODate));
-    as.setLowMoon(QPair<QDateTime, double>(QDateTime::fromString(obj["lowmoon"].toString(), Qt::ISODate), obj["lowmoonEle"].toDouble()));
-    as.setHighMoon(QPair<QDateTime, double>(QDateTime::fromString(obj["highmoon"].toString(), Qt::ISODate), obj["highmoonEle"].toDouble()));
-    as.setSolarMidnight(QPair<QDateTime, double>(QDateTime::fromString(obj["solarmidnight"].toString(), Qt::ISODate), obj["solarmidnightEle"].toDouble()));
-    as.setSolarNoon(QPair<QDateTime, double>(QDateTime::fromString(obj["solarnoon"].toString(), Qt::ISODate), obj["solarnoonEle"].toDouble()));
+    as.setSunSet(Timestamp::toDateTime(obj["sunset"].toString()));
+    as.setSunRise(Timestamp::toDateTime(obj["sunrise"].toString()));
+    as.setLowMoon(QPair<QDateTime, double>(Timestamp::toDateTime(obj["lowmoon"].toString()), obj["lowmoonEle"].toDouble()));
+    as.setHighMoon(QPair<QDateTime, double>(Timestamp::toDateTime(obj["highmoon"].toString()), obj["highmoonEle"].toDouble()));
+    as.setSolarMidnight(QPair<QDateTime, double>(Timestamp::toDateTime(obj["solarmidnight"].toString()), obj["solarmidnightEle"].toDouble()));
+    as.setSolarNoon(QPair<QDateTime, double>(Timestamp::toDateTime(obj["solarnoon"].toString()), obj["solarnoonEle"].toDouble()));
     as.setMoonPhase(obj["moonphase"].toDouble());
-    as.setMoonSet(QDateTime::fromString(obj["moonset"].toString(), Qt::ISODate));
-    as.setMoonRise(QDateTime::fromString(obj["moonrise"].toString(), Qt::ISODate));
+    as.setMoonSet(Timestamp::toDateTime(obj["moonset"].toString()));
+    as.setMoonRise(Timestamp::toDateTime(obj["moonrise"].toString()));
     return as;
 }
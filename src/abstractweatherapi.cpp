@@ -7,9 +7,14 @@
 
 #include "abstractweatherapi.h"
 #include "abstractdailyweatherforecast.h"
+#include "contenthash.h"
+#include "derivedquantities.h"
+#include "kweather_debug.h"
+#include "metrics.h"
+#include <QCoreApplication>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
-#include <QTimeZone>
+#include <QUrl>
 
 AbstractWeatherAPI::AbstractWeatherAPI(QString locationId, QString timeZone, int interval, double latitude, double longitude, QObject *parent)
     : QObject(parent)
@@ -19,31 +24,104 @@ AbstractWeatherAPI::AbstractWeatherAPI(QString locationId, QString timeZone, int
     , latitude_(latitude)
     , longitude_(longitude)
 {
-    mManager = new QNetworkAccessManager();
+    mManager = networkAccessManager();
 
-    mManager->setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);
-    mManager->setStrictTransportSecurityEnabled(true);
-    mManager->enableStrictTransportSecurityStore(true);
-
-    sunriseApi_ = new NMISunriseAPI(latitude, longitude, QDateTime::currentDateTime().toTimeZone(QTimeZone(timeZone_.toUtf8())).offsetFromUtc());
+    sunriseApi_ = new NMISunriseAPI(latitude, longitude, zoneOffsets().offsetAt(QDateTime::currentSecsSinceEpoch()));
 
     connect(sunriseApi_, &NMISunriseAPI::finished, this, [this]() {
-        qDebug() << "obtained sunrise data";
+        qCDebug(KWEATHER_LOG) << "obtained sunrise data";
 
         setCurrentSunriseData(sunriseApi_->get());
         applySunriseDataToForecast();
         if (!currentData_.hourlyForecasts().empty())
-            emit updated(currentData_); // update ui
+            publish(); // update ui
     });
     // TODO handle sunriseapi failure signal
 }
 
 AbstractWeatherAPI::~AbstractWeatherAPI()
 {
-    delete mManager;
     delete sunriseApi_;
 }
 
+QNetworkAccessManager *AbstractWeatherAPI::networkAccessManager()
+{
+    static QNetworkAccessManager *manager = [] {
+        auto *m = new QNetworkAccessManager(qApp);
+        m->setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);
+        m->setStrictTransportSecurityEnabled(true);
+        m->enableStrictTransportSecurityStore(true);
+        return m;
+    }();
+    return manager;
+}
+
+const ZoneOffsetTable &AbstractWeatherAPI::zoneOffsets()
+{
+    // met.no forecasts reach about ten days ahead
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    if (!zoneOffsets_.covers(now - 24 * 3600, now + 12 * 24 * 3600) || zoneOffsets_.ianaId() != timeZone_.toUtf8())
+        zoneOffsets_ = ZoneOffsetTable(timeZone_.toUtf8(), now - 2 * 24 * 3600, now + 16 * 24 * 3600);
+    return zoneOffsets_;
+}
+
+void AbstractWeatherAPI::cancel()
+{
+    if (!mReply || mReply->isFinished())
+        return;
+    disconnect(mReply, nullptr, this, nullptr); // parse() never sees it
+    mReply->abort();
+    mReply->deleteLater();
+    mReply = nullptr;
+}
+
+bool AbstractWeatherAPI::bodyUnchanged(const QByteArray &body)
+{
+    const quint64 hash = ContentHash::of(body);
+    // only while currentData_ still is what that body was parsed into
+    if (hash != bodyHash_ || currentData_.hourlyForecasts().isEmpty()) {
+        bodyHash_ = hash;
+        return false;
+    }
+    currentData_.setTimeCreated(QDateTime::currentDateTime()); // confirmed fresh, for the update() throttle
+    Metrics::instance().increment(QStringLiteral("kweather_unchanged_bodies_total"), backendName());
+    emit unchanged();
+    return true;
+}
+
+void AbstractWeatherAPI::publish()
+{
+    const quint64 hash = currentData_.contentHash();
+    if (hash == forecastHash_) {
+        Metrics::instance().increment(QStringLiteral("kweather_unchanged_forecasts_total"), backendName());
+        emit unchanged();
+        return;
+    }
+    forecastHash_ = hash;
+    emit updated(currentData_);
+}
+
+static QUrl &serverOverride()
+{
+    static QUrl server;
+    return server;
+}
+
+void AbstractWeatherAPI::setServerOverride(const QUrl &server)
+{
+    serverOverride() = server;
+}
+
+void AbstractWeatherAPI::applyServerOverride(QUrl &url)
+{
+    const QUrl &server = serverOverride();
+    if (server.isEmpty())
+        return;
+    url.setScheme(server.scheme());
+    url.setHost(server.host());
+    url.setPort(server.port());
+}
+
 void AbstractWeatherAPI::fetchSunriseData()
 {
     sunriseApi_->update();
@@ -77,22 +155,5 @@ void AbstractWeatherAPI::setCurrentSunriseData(QList<AbstractSunrise> sunrise)
 }
 Kweather::WindDirection AbstractWeatherAPI::getWindDirect(double deg)
 {
-    if (deg < 22.5 || deg >= 337.5) {
-        return Kweather::WindDirection::S; // from N
-    } else if (deg > 22.5 || deg <= 67.5) {
-        return Kweather::WindDirection::SW; // from NE
-    } else if (deg > 67.5 || deg <= 112.5) {
-        return Kweather::WindDirection::W; // from E
-    } else if (deg > 112.5 || deg <= 157.5) {
-        return Kweather::WindDirection::NW; // from SE
-    } else if (deg > 157.5 || deg <= 202.5) {
-        return Kweather::WindDirection::N; // from S
-    } else if (deg > 202.5 || deg <= 247.5) {
-        return Kweather::WindDirection::NE; // from SW
-    } else if (deg > 247.5 || deg <= 292.5) {
-        return Kweather::WindDirection::E; // from W
-    } else if (deg > 292.5 || deg <= 337.5) {
-        return Kweather::WindDirection::SE; // from NW
-    }
-    return Kweather::WindDirection::N;
+    return DerivedQuantities::windDirection(deg);
 }
@@ -10,12 +10,15 @@
 
 #include "abstractweatherforecast.h"
 #include "nmisunriseapi.h"
+#include "zoneoffsettable.h"
 #include <QObject>
+#include <QPointer>
 #include <memory>
 #include <utility>
 #include <vector>
 
 class QNetworkAccessManager;
+class QUrl;
 class QNetworkReply;
 class AbstractDailyWeatherForecast;
 class AbstractWeatherAPI : public QObject
@@ -29,6 +32,10 @@ public:
     ~AbstractWeatherAPI() override;
 
     virtual void update() = 0;
+    // drops the request in flight, if any; nothing is emitted for it
+    void cancel();
+    // parse a downloaded forecast document into currentData() and emit updated()
+    virtual void parseData(const QByteArray &data) = 0;
     virtual void applySunriseDataToForecast() = 0;
 
     // MUST BE CALLED if not loading sunrise data from cache
@@ -42,14 +49,37 @@ public:
     QString &timeZone();
     Kweather::WindDirection getWindDirect(double deg);
 
+    // all backends share one network access manager, so that a location does not
+    // carry its own connection cache, cookie jar and HSTS store
+    static QNetworkAccessManager *networkAccessManager();
+
+    // send every request to server instead (scheme, host and port), for the stress harness
+    static void setServerOverride(const QUrl &server);
+    static void applyServerOverride(QUrl &url);
+
+    // for metric labels
+    virtual QString backendName() const = 0;
+
 protected:
+    // offsets of timeZone_ around now, rebuilt when the forecast horizon moves past it
+    const ZoneOffsetTable &zoneOffsets();
+
+    // a response identical to the one currentData_ came from: nothing to parse, emits unchanged()
+    bool bodyUnchanged(const QByteArray &body);
+    // emits updated() with currentData_, or unchanged() when it hashes like the last one sent
+    void publish();
+
     QString locationId_;
     QString timeZone_;
     float latitude_, longitude_;
 
     QNetworkAccessManager *mManager;
-    QNetworkReply *mReply;
+    QPointer<QNetworkReply> mReply; // the last request sent
+    bool lastRequestFailed_ = false; // the next request counts as a retry
+    quint64 bodyHash_ = 0; // ContentHash of the last response parsed
+    quint64 forecastHash_ = 0; // AbstractWeatherForecast::contentHash() of the last updated()
 
+    ZoneOffsetTable zoneOffsets_;
     AbstractWeatherForecast currentData_;
     QList<AbstractSunrise> currentSunriseData_;
 
@@ -57,6 +87,7 @@ protected:
 
 signals:
     void updated(AbstractWeatherForecast& forecast);
+    void unchanged(); // a refresh found the forecast as last sent
     void networkError();
 public slots:
     virtual void parse(QNetworkReply *Reply) = 0;
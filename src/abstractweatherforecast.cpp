@@ -7,6 +7,8 @@
 
 #include "abstractweatherforecast.h"
 #include "abstractsunrise.h"
+#include "contenthash.h"
+#include "timestamp.h"
 #include <QDebug>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -40,7 +42,7 @@ AbstractWeatherForecast::~AbstractWeatherForecast()
 AbstractWeatherForecast AbstractWeatherForecast::fromJson(QJsonObject obj)
 {
     AbstractWeatherForecast fc;
-    fc.setTimeCreated(QDateTime::fromString(obj["timeCreated"].toString(), Qt::ISODate));
+    fc.setTimeCreated(Timestamp::toDateTime(obj["timeCreated"].toString()));
     fc.setLocationId(obj["locationId"].toString());
     fc.setLatitude(obj["latitude"].toString().toDouble());
     fc.setLongitude(obj["longitude"].toString().toDouble());
@@ -94,3 +96,46 @@ QJsonObject AbstractWeatherForecast::toJson()
     obj["sunrise"] = sunriseArray;
     return obj;
 }
+
+quint64 AbstractWeatherForecast::contentHash() const
+{
+    ContentHash hash;
+    hash.add(locationId_);
+    for (const auto &hour : hourlyForecasts_) {
+        hash.addValue(hour.date().toSecsSinceEpoch());
+        hash.addValue(hour.date().offsetFromUtc());
+        hash.add(hour.weatherDescription());
+        hash.add(hour.weatherIcon());
+        hash.add(hour.neutralWeatherIcon());
+        hash.add(hour.symbolCode());
+        hash.addValue(hour.temperature());
+        hash.addValue(hour.pressure());
+        hash.addValue(hour.windDirection());
+        hash.addValue(hour.windSpeed());
+        hash.addValue(hour.humidity());
+        hash.addValue(hour.fog());
+        hash.addValue(hour.uvIndex());
+        hash.addValue(hour.precipitationAmount());
+        hash.addValue(hour.windDegrees());
+        hash.addValue(hour.interpolated());
+        hash.addValue(hour.temperatureSpread());
+    }
+    for (const auto &day : dailyForecasts_) {
+        hash.addValue(day.date().toJulianDay());
+        hash.add(day.weatherDescription());
+        hash.add(day.weatherIcon());
+        hash.addValue(day.maxTemp());
+        hash.addValue(day.minTemp());
+        hash.addValue(day.precipitation());
+        hash.addValue(day.uvIndex());
+        hash.addValue(day.humidity());
+        hash.addValue(day.pressure());
+    }
+    for (const auto &sunrise : sunrise_) {
+        hash.addValue(sunrise.sunRise().toSecsSinceEpoch());
+        hash.addValue(sunrise.sunSet().toSecsSinceEpoch());
+        hash.addValue(sunrise.moonRise().toSecsSinceEpoch());
+        hash.addValue(sunrise.moonSet().toSecsSinceEpoch());
+    }
+    return hash.result();
+}
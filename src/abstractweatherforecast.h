@@ -31,7 +31,9 @@ public:
     static AbstractWeatherForecast fromJson(QJsonObject obj);
 
     QJsonObject toJson();
-    
+
+    // over everything shown, timeCreated excluded: equal hashes mean nothing to redraw
+    quint64 contentHash() const;
 
     // getter/setter
     inline const QString &locationId()
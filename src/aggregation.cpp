@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "aggregation.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+namespace Aggregation
+{
+int rank(const QString &neutralIcon)
+{
+    // one table for every backend, they all map to these neutral icons
+    static const QHash<QString, int> ranks = {
+        {QStringLiteral("weather-none-available"), -1},
+        {QStringLiteral("weather-clear"), 0},
+        {QStringLiteral("weather-few-clouds"), 1},
+        {QStringLiteral("weather-clouds"), 2},
+        {QStringLiteral("weather-many-clouds"), 3},
+        {QStringLiteral("weather-fog"), 3},
+        {QStringLiteral("weather-mist"), 3},
+        {QStringLiteral("weather-showers-scattered"), 4},
+        {QStringLiteral("weather-snow-scattered"), 4},
+        {QStringLiteral("weather-showers"), 5},
+        {QStringLiteral("weather-hail"), 5},
+        {QStringLiteral("weather-snow"), 5},
+        {QStringLiteral("weather-freezing-rain"), 6},
+        {QStringLiteral("weather-freezing-storm"), 6},
+        {QStringLiteral("weather-snow-rain"), 6},
+        {QStringLiteral("weather-storm"), 7},
+    };
+    return ranks.value(neutralIcon, 0);
+}
+
+Series::Series(MonotonicArena &arena)
+    : localSecs(ArenaAllocator<qint64>(arena))
+    , temperature(ArenaAllocator<float>(arena))
+    , minTemperature(ArenaAllocator<float>(arena))
+    , maxTemperature(ArenaAllocator<float>(arena))
+    , precipitation(ArenaAllocator<float>(arena))
+    , uvIndex(ArenaAllocator<float>(arena))
+    , humidity(ArenaAllocator<float>(arena))
+    , pressure(ArenaAllocator<float>(arena))
+    , rank(ArenaAllocator<int>(arena))
+{
+}
+
+void Series::append(qint64 secs, float temp, float minTemp, float maxTemp, float precip, float uv, float hum, float pres, int r)
+{
+    localSecs.push_back(secs);
+    temperature.push_back(temp);
+    minTemperature.push_back(minTemp);
+    maxTemperature.push_back(maxTemp);
+    precipitation.push_back(precip);
+    uvIndex.push_back(uv);
+    humidity.push_back(hum);
+    pressure.push_back(pres);
+    rank.push_back(r);
+}
+
+void Series::reserve(int size)
+{
+    localSecs.reserve(size);
+    temperature.reserve(size);
+    minTemperature.reserve(size);
+    maxTemperature.reserve(size);
+    precipitation.reserve(size);
+    uvIndex.reserve(size);
+    humidity.reserve(size);
+    pressure.reserve(size);
+    rank.reserve(size);
+}
+
+static qint64 floorDiv(qint64 a, qint64 b)
+{
+    return a >= 0 ? a / b : (a - b + 1) / b;
+}
+
+QDate Summary::date() const
+{
+    return QDate::fromJulianDay(floorDiv(start, 86400) + 2440588);
+}
+
+DayPart Summary::dayPart() const
+{
+    return static_cast<DayPart>((start - floorDiv(start, 86400) * 86400) / (6 * 3600));
+}
+
+static qint64 windowLength(Window window)
+{
+    switch (window) {
+    case Window::Day:
+        return 24 * 3600;
+    case Window::DayPart:
+    case Window::SixHours:
+        return 6 * 3600;
+    case Window::ThreeHours:
+        return 3 * 3600;
+    }
+    return 24 * 3600;
+}
+
+// plain loops over one window of a column, simple enough for the compiler to vectorize
+static float minimum(const float *values, int count)
+{
+    float result = values[0];
+    for (int i = 1; i < count; i++)
+        result = values[i] < result ? values[i] : result;
+    return result;
+}
+
+static float maximum(const float *values, int count)
+{
+    float result = values[0];
+    for (int i = 1; i < count; i++)
+        result = values[i] > result ? values[i] : result;
+    return result;
+}
+
+static float sum(const float *values, int count)
+{
+    float result = 0;
+    for (int i = 0; i < count; i++)
+        result += values[i];
+    return result;
+}
+
+void aggregate(const Series &series, Window window, Column<Summary> &summaries)
+{
+    const qint64 length = windowLength(window);
+    const int size = series.size();
+    for (int first = 0; first < size;) {
+        // rows are in time order, a window is a run of rows
+        const qint64 bucket = floorDiv(series.localSecs[first], length);
+        int end = first + 1;
+        while (end < size && floorDiv(series.localSecs[end], length) == bucket)
+            end++;
+        const int count = end - first;
+
+        Summary summary;
+        summary.start = bucket * length;
+        summary.first = first;
+        summary.count = count;
+        summary.minTemperature = minimum(series.minTemperature.data() + first, count);
+        summary.maxTemperature = maximum(series.maxTemperature.data() + first, count);
+        summary.precipitation = sum(series.precipitation.data() + first, count);
+        summary.uvIndex = maximum(series.uvIndex.data() + first, count);
+        summary.humidity = maximum(series.humidity.data() + first, count);
+        summary.pressure = maximum(series.pressure.data() + first, count);
+        summary.dominant = first;
+        for (int i = first + 1; i < end; i++) {
+            if (series.rank[i] >= series.rank[summary.dominant])
+                summary.dominant = i;
+        }
+        summaries.push_back(summary);
+        first = end;
+    }
+}
+}
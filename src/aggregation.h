@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_AGGREGATION_H
+#define KWEATHER_AGGREGATION_H
+
+#include "arena.h"
+
+#include <QDate>
+#include <QString>
+
+#include <vector>
+
+// Summaries of an hourly series over windows of local time: calendar days, day
+// parts, 3 and 6 hour blocks. The series is kept as columns so that every
+// statistic of a window is a tight loop over contiguous floats.
+namespace Aggregation
+{
+template<typename T> using Column = std::vector<T, ArenaAllocator<T>>;
+
+enum class Window {
+    Day,
+    DayPart, // night 0-6, morning 6-12, afternoon 12-18, evening 18-24
+    SixHours, // the same blocks as day parts, under their plain name
+    ThreeHours,
+};
+
+enum DayPart { Night, Morning, Afternoon, Evening };
+
+// how bad the weather of a neutral icon is, the dominant condition of a window is
+// the worst one; icons not listed count as 0
+int rank(const QString &neutralIcon);
+
+// one row per hour forecast, in time order
+struct Series {
+    explicit Series(MonotonicArena &arena);
+
+    // minTemperature and maxTemperature are the extremes the backend gives for the
+    // hour's period, pass the temperature itself for both when it gives none
+    void append(qint64 localSecs, float temperature, float minTemperature, float maxTemperature, float precipitation, float uvIndex, float humidity, float pressure, int rank);
+    int size() const
+    {
+        return static_cast<int>(localSecs.size());
+    }
+    void reserve(int size);
+
+    Column<qint64> localSecs; // wall clock of the location, read as if UTC
+    Column<float> temperature, minTemperature, maxTemperature, precipitation, uvIndex, humidity, pressure;
+    Column<int> rank;
+};
+
+struct Summary {
+    qint64 start; // local secs of the window start
+    int first; // row of the first hour in the window
+    int count;
+    int dominant; // row of the worst condition, the latest one of equal rank
+    float minTemperature, maxTemperature;
+    float precipitation; // sum
+    float uvIndex, humidity, pressure; // maxima
+
+    QDate date() const;
+    DayPart dayPart() const;
+};
+
+// one summary per window that has hours in it, in time order
+void aggregate(const Series &series, Window window, Column<Summary> &summaries);
+}
+
+#endif // KWEATHER_AGGREGATION_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "arena.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+MonotonicArena::MonotonicArena(std::size_t blockSize)
+    : m_blockSize(blockSize)
+{
+}
+
+MonotonicArena::~MonotonicArena()
+{
+    for (const auto &block : m_blocks)
+        std::free(block.data);
+}
+
+void *MonotonicArena::allocate(std::size_t size, std::size_t alignment)
+{
+    if (!m_blocks.empty()) {
+        const Block &block = m_blocks.back();
+        const std::uintptr_t address = reinterpret_cast<std::uintptr_t>(block.data) + m_offset;
+        const std::size_t padding = (alignment - address % alignment) % alignment;
+        if (m_offset + padding + size <= block.size) {
+            m_offset += padding + size;
+            m_used += padding + size;
+            return block.data + m_offset - size;
+        }
+    }
+
+    // malloc aligns for every fundamental type, so a new block needs no padding
+    const std::size_t blockSize = std::max({m_blockSize, size, m_blocks.empty() ? 0 : 2 * m_blocks.back().size});
+    char *data = static_cast<char *>(std::malloc(blockSize));
+    if (!data)
+        std::abort();
+    m_blocks.push_back({data, blockSize});
+    m_offset = size;
+    m_used += size;
+    return data;
+}
+
+void MonotonicArena::reset()
+{
+    if (m_blocks.size() > 1) {
+        // fold everything into one block, the next round of the same size fits in it
+        std::size_t total = 0;
+        for (const auto &block : m_blocks) {
+            total += block.size;
+            std::free(block.data);
+        }
+        m_blocks.clear();
+        char *data = static_cast<char *>(std::malloc(total));
+        if (!data)
+            std::abort();
+        m_blocks.push_back({data, total});
+    }
+    m_offset = 0;
+    m_used = 0;
+}
+
+MonotonicArena &MonotonicArena::scratch()
+{
+    static thread_local MonotonicArena arena;
+    return arena;
+}
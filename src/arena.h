@@ -0,0 +1,112 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_ARENA_H
+#define KWEATHER_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Bump allocator for scratch state that dies all at once, like the records of one
+// parse. deallocate is a no-op, reset() forgets everything. After a reset the arena
+// keeps a single block as large as everything it handed out before, so once it has
+// seen the largest document a parse does not touch the general heap for its scratch.
+class MonotonicArena
+{
+public:
+    explicit MonotonicArena(std::size_t blockSize = 64 * 1024);
+    ~MonotonicArena();
+    MonotonicArena(const MonotonicArena &) = delete;
+    MonotonicArena &operator=(const MonotonicArena &) = delete;
+
+    void *allocate(std::size_t size, std::size_t alignment);
+    void reset();
+
+    std::size_t bytesUsed() const
+    {
+        return m_used;
+    }
+    std::size_t blockCount() const
+    {
+        return m_blocks.size();
+    }
+
+    // one per thread, for the backend parsers
+    static MonotonicArena &scratch();
+
+    // resets the arena when it goes out of scope, declare it before the containers using it
+    class Scope
+    {
+    public:
+        explicit Scope(MonotonicArena &arena)
+            : m_arena(arena)
+        {
+        }
+        ~Scope()
+        {
+            m_arena.reset();
+        }
+
+    private:
+        MonotonicArena &m_arena;
+    };
+
+private:
+    struct Block {
+        char *data;
+        std::size_t size;
+    };
+
+    std::size_t m_blockSize;
+    std::vector<Block> m_blocks;
+    std::size_t m_offset = 0; // in the last block
+    std::size_t m_used = 0; // since the last reset
+};
+
+// std allocator handing out memory of a MonotonicArena
+template<typename T> class ArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit ArenaAllocator(MonotonicArena &arena)
+        : m_arena(&arena)
+    {
+    }
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other)
+        : m_arena(other.arena())
+    {
+    }
+
+    T *allocate(std::size_t n)
+    {
+        return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T *, std::size_t)
+    {
+    }
+
+    MonotonicArena *arena() const
+    {
+        return m_arena;
+    }
+
+private:
+    MonotonicArena *m_arena;
+};
+
+template<typename T, typename U> bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.arena() == b.arena();
+}
+template<typename T, typename U> bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b)
+{
+    return a.arena() != b.arena();
+}
+
+#endif // KWEATHER_ARENA_H
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "backendhealthtracker.h"
+#include "kweather_debug.h"
+#include "metrics.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QNetworkReply>
+#include <QTimer>
+
+#include <algorithm>
+#include <memory>
+
+static const double ALPHA = 0.2; // weight of the latest request in the moving averages
+static const qint64 SLOW_RESPONSE = 15000; // msecs, later than this counts as a failure
+static const int FAILURES_TO_TRIP = 3;
+static const quint64 MIN_REQUESTS = 5; // before the success rate alone may trip
+static const double UNHEALTHY_RATE = 0.5;
+static const double HEALTHY_RATE = 0.8;
+static const int SUCCESSES_TO_RECOVER = 3;
+static const qint64 MIN_DOWN = 10 * 60; // secs
+static const qint64 QUOTA_COOLDOWN = 10 * 60; // secs, OWM does not say when calls are available again
+static const int PROBE_INTERVAL = 5 * 60; // secs, above the 300 s the backends answer from their last fetch
+
+static QString name(Kweather::Backend backend)
+{
+    return backend == Kweather::Backend::OWM ? QStringLiteral("owm") : QStringLiteral("nmi");
+}
+
+BackendHealthTracker::BackendHealthTracker()
+    : m_probeTimer(new QTimer(this))
+{
+    connect(m_probeTimer, &QTimer::timeout, this, [this] {
+        bool down = false;
+        for (auto backend : {Kweather::Backend::NMI, Kweather::Backend::OWM}) {
+            if (m_health[static_cast<int>(backend)].healthy)
+                continue;
+            down = true;
+            evaluate(backend); // a quota may have run out
+            emit probeDue(backend);
+        }
+        if (!down)
+            m_probeTimer->stop();
+    });
+}
+
+BackendHealthTracker &BackendHealthTracker::instance()
+{
+    static BackendHealthTracker tracker;
+    return tracker;
+}
+
+void BackendHealthTracker::trackReply(QNetworkReply *reply, Kweather::Backend backend)
+{
+    auto timer = std::make_shared<QElapsedTimer>();
+    timer->start();
+    connect(reply, &QNetworkReply::finished, this, [this, reply, backend, timer] {
+        if (reply->error() == QNetworkReply::OperationCanceledError)
+            return; // dropped by a hedge, see WeatherLocation::settle()
+        record(backend, reply->error() == QNetworkReply::NoError, timer->elapsed());
+    });
+}
+
+void BackendHealthTracker::record(Kweather::Backend backend, bool success, qint64 msecs)
+{
+    if (backend == Kweather::Backend::Blend)
+        return;
+    Health &health = m_health[static_cast<int>(backend)];
+    success = success && msecs < SLOW_RESPONSE;
+    health.requests++;
+    health.successRate = ALPHA * success + (1 - ALPHA) * health.successRate;
+    health.latency = health.requests == 1 ? msecs : ALPHA * msecs + (1 - ALPHA) * health.latency;
+    if (success) {
+        health.successesInRow++;
+        health.failuresInRow = 0;
+        health.credentialsRejected = false;
+    } else {
+        health.failuresInRow++;
+        health.successesInRow = 0;
+    }
+    evaluate(backend);
+}
+
+void BackendHealthTracker::quotaExhausted(Kweather::Backend backend)
+{
+    m_health[static_cast<int>(backend)].quotaUntil = now() + QUOTA_COOLDOWN;
+    evaluate(backend);
+}
+
+void BackendHealthTracker::credentialsRejected(Kweather::Backend backend)
+{
+    m_health[static_cast<int>(backend)].credentialsRejected = true;
+    evaluate(backend);
+}
+
+qint64 BackendHealthTracker::now() const
+{
+    return QDateTime::currentSecsSinceEpoch() + m_skipped;
+}
+
+bool BackendHealthTracker::isHealthy(Kweather::Backend backend) const
+{
+    if (backend == Kweather::Backend::Blend)
+        return m_health[static_cast<int>(Kweather::Backend::NMI)].healthy || m_health[static_cast<int>(Kweather::Backend::OWM)].healthy;
+    return m_health[static_cast<int>(backend)].healthy;
+}
+
+const BackendHealthTracker::Health &BackendHealthTracker::health(Kweather::Backend backend) const
+{
+    return m_health[static_cast<int>(backend)];
+}
+
+bool BackendHealthTracker::claimProbe(Kweather::Backend backend)
+{
+    if (backend == Kweather::Backend::Blend)
+        return false;
+    Health &health = m_health[static_cast<int>(backend)];
+    const qint64 now = this->now();
+    if (health.healthy || health.quotaUntil > now || now - health.lastProbe < PROBE_INTERVAL / 2)
+        return false;
+    health.lastProbe = now;
+    return true;
+}
+
+void BackendHealthTracker::evaluate(Kweather::Backend backend)
+{
+    Health &health = m_health[static_cast<int>(backend)];
+    const qint64 now = this->now();
+    const bool blocked = health.credentialsRejected || health.quotaUntil > now;
+
+    bool healthy = health.healthy;
+    if (health.healthy) {
+        healthy = !(blocked || health.failuresInRow >= FAILURES_TO_TRIP || (health.requests >= MIN_REQUESTS && health.successRate < UNHEALTHY_RATE));
+    } else if (!blocked && health.successesInRow >= SUCCESSES_TO_RECOVER && now - health.changed >= MIN_DOWN) {
+        healthy = true;
+        // the failures before are over, they should not trip it again right away
+        health.successRate = std::max(health.successRate, HEALTHY_RATE);
+    }
+    if (healthy == health.healthy)
+        return;
+
+    health.healthy = healthy;
+    health.changed = now;
+    if (!healthy)
+        health.successesInRow = 0; // the ones before a quota ran out do not count towards recovery
+    qCInfo(KWEATHER_LOG) << "backend" << name(backend) << (healthy ? "recovered" : "turned unhealthy") << "success rate" << health.successRate << "latency" << health.latency;
+    Metrics::instance().increment(healthy ? QStringLiteral("kweather_backend_recoveries_total") : QStringLiteral("kweather_backend_outages_total"), name(backend));
+    if (!healthy && !m_probeTimer->isActive())
+        m_probeTimer->start(PROBE_INTERVAL * 1000);
+    emit healthChanged(backend, healthy);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_BACKENDHEALTHTRACKER_H
+#define KWEATHER_BACKENDHEALTHTRACKER_H
+
+#include "global.h"
+
+#include <QObject>
+
+class QNetworkReply;
+class QTimer;
+
+// Whether NMI and OWM currently answer, from every forecast request sent to them:
+// a moving success rate, the latency, and whether OWM turned down the token or
+// ran out of calls. Locations move off a backend once it turns unhealthy and
+// back once it recovered, each on its next refresh unless it is shown, see
+// WeatherLocation::followHealth().
+//
+// Both ways have hysteresis so that a flaky backend does not make locations
+// flap: a backend turns unhealthy after a few failures in a row or once most
+// requests fail, and healthy again only after some successes in a row and not
+// before it has been down for a while. While one is down, probeDue() asks every
+// few minutes for a request to it, which one location claims.
+//
+// Only touched from the main thread.
+class BackendHealthTracker : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Health {
+        double successRate = 1; // moving average, responses in time count as success
+        double latency = 0; // msecs, moving average of the responses
+        quint64 requests = 0;
+        int failuresInRow = 0, successesInRow = 0;
+        qint64 quotaUntil = 0; // secs since epoch, no calls left before
+        bool credentialsRejected = false; // until a request succeeds again
+        bool healthy = true;
+        qint64 changed = 0; // secs since epoch healthy last changed
+        qint64 lastProbe = 0;
+    };
+
+    static BackendHealthTracker &instance();
+
+    // success and latency of a forecast request, a cancelled one says nothing
+    void trackReply(QNetworkReply *reply, Kweather::Backend backend);
+    void record(Kweather::Backend backend, bool success, qint64 msecs);
+    void quotaExhausted(Kweather::Backend backend);
+    void credentialsRejected(Kweather::Backend backend);
+
+    // a blend is as healthy as the members it has left
+    bool isHealthy(Kweather::Backend backend) const;
+    const Health &health(Kweather::Backend backend) const;
+
+    // true for the first caller once a probe of an unhealthy backend is due
+    bool claimProbe(Kweather::Backend backend);
+
+    // for tests, as if that many secs had passed
+    void skipTime(qint64 secs)
+    {
+        m_skipped += secs;
+    }
+
+signals:
+    void healthChanged(Kweather::Backend backend, bool healthy);
+    void probeDue(Kweather::Backend backend); // send it a request if you can, see claimProbe()
+
+private:
+    BackendHealthTracker();
+    void evaluate(Kweather::Backend backend);
+    qint64 now() const; // secs since epoch
+
+    Health m_health[2]; // nmi and owm
+    QTimer *m_probeTimer;
+    qint64 m_skipped = 0;
+};
+
+#endif // KWEATHER_BACKENDHEALTHTRACKER_H
@@ -0,0 +1,275 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "blendedweatherapi.h"
+#include "abstractdailyweatherforecast.h"
+#include "aggregation.h"
+#include "arena.h"
+#include "derivedquantities.h"
+#include "forecastverification.h"
+#include "kweather_debug.h"
+#include "kweathersettings.h"
+#include "metrics.h"
+#include "nmiweatherapi2.h"
+#include "owmweatherapi.h"
+#include "tracing.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+static const int WEIGHT_LEAD_HOURS = 48; // the hours looked at most
+static const quint64 MIN_SCORES = 24; // for each backend before the weights move off even
+static const float MIN_SHARE = 0.2f; // neither backend is ever ignored
+static const float DEGREES = 3.14159265f / 180;
+
+// share of NMI, inverse to its mean squared error against that of OWM
+static float share(const ForecastVerification &verification, ForecastVerification::Quantity quantity)
+{
+    quint64 nmiCount = 0, owmCount = 0;
+    const double nmi = verification.meanSquaredError(Kweather::Backend::NMI, quantity, WEIGHT_LEAD_HOURS, &nmiCount);
+    const double owm = verification.meanSquaredError(Kweather::Backend::OWM, quantity, WEIGHT_LEAD_HOURS, &owmCount);
+    if (nmiCount < MIN_SCORES || owmCount < MIN_SCORES || nmi + owm <= 0)
+        return 0.5f;
+    return qBound(MIN_SHARE, static_cast<float>(owm / (nmi + owm)), 1 - MIN_SHARE);
+}
+
+static float mix(float nmi, float owm, float weight)
+{
+    return weight * nmi + (1 - weight) * owm;
+}
+
+// days of the blended hours, the same way the backends make theirs
+static QList<AbstractDailyWeatherForecast> daysOf(const QList<AbstractHourlyWeatherForecast> &hours, MonotonicArena &arena)
+{
+    MonotonicArena::Scope scope(arena);
+    Aggregation::Series series(arena);
+    series.reserve(hours.size());
+    for (const auto &hour : hours) {
+        series.append(hour.date().toSecsSinceEpoch() + hour.date().offsetFromUtc(),
+                      hour.temperature(),
+                      hour.temperature(),
+                      hour.temperature(),
+                      hour.precipitationAmount(),
+                      hour.uvIndex(),
+                      hour.humidity(),
+                      hour.pressure(),
+                      Aggregation::rank(hour.neutralWeatherIcon()));
+    }
+    Aggregation::Column<Aggregation::Summary> summaries{ArenaAllocator<Aggregation::Summary>(arena)};
+    Aggregation::aggregate(series, Aggregation::Window::Day, summaries);
+
+    QList<AbstractDailyWeatherForecast> days;
+    days.reserve(static_cast<int>(summaries.size()));
+    for (const auto &day : summaries) {
+        const AbstractHourlyWeatherForecast &hour = hours.at(day.dominant);
+        days.append(AbstractDailyWeatherForecast(day.maxTemperature,
+                                                 day.minTemperature,
+                                                 day.precipitation,
+                                                 day.uvIndex,
+                                                 day.humidity,
+                                                 day.pressure,
+                                                 hour.neutralWeatherIcon(),
+                                                 hour.weatherDescription(),
+                                                 day.date()));
+    }
+    return days;
+}
+
+BlendedWeatherAPI::BlendedWeatherAPI(QString locationId, QString timeZone, double latitude, double longitude)
+    : AbstractWeatherAPI(std::move(locationId), std::move(timeZone), -1, latitude, longitude)
+{
+}
+
+BlendedWeatherAPI::~BlendedWeatherAPI()
+{
+    delete m_nmi.api;
+    delete m_owm.api;
+}
+
+void BlendedWeatherAPI::update()
+{
+    // don't update if updated recently, and forecast is not empty
+    if (!currentData_.hourlyForecasts().empty() && currentData_.timeCreated().secsTo(QDateTime::currentDateTime()) < 300) {
+        Metrics::instance().increment(QStringLiteral("kweather_cache_hits_total"), backendName());
+        publish();
+        return;
+    }
+    Metrics::instance().increment(QStringLiteral("kweather_cache_misses_total"), backendName());
+
+    if (!m_nmi.api) {
+        m_nmi.api = new NMIWeatherAPI2(locationId_, timeZone_, latitude_, longitude_);
+        connectMember(m_nmi, Kweather::Backend::NMI);
+    }
+    // OWM only takes part with a token
+    const bool owm = !KWeatherSettings().oWMToken().isEmpty();
+    if (owm && !m_owm.api) {
+        m_owm.api = new OWMWeatherAPI(locationId_, timeZone_, latitude_, longitude_);
+        connectMember(m_owm, Kweather::Backend::OWM);
+    } else if (!owm && m_owm.api) {
+        delete m_owm.api;
+        m_owm = Member();
+    }
+
+    // both flagged before asking either, one may answer right away from its last fetch
+    for (Member *member : {&m_nmi, &m_owm}) {
+        member->waiting = member->api != nullptr;
+        member->answered = false;
+    }
+    for (Member *member : {&m_nmi, &m_owm}) {
+        if (member->api)
+            member->api->update();
+    }
+}
+
+void BlendedWeatherAPI::connectMember(Member &member, Kweather::Backend backend)
+{
+    member.api->setCurrentSunriseData(currentSunriseData_); // for day and night icons
+    connect(member.api, &AbstractWeatherAPI::updated, this, [this, &member, backend](AbstractWeatherForecast &forecast) {
+        emit memberUpdated(forecast, backend);
+        answered(member, true);
+    });
+    connect(member.api, &AbstractWeatherAPI::unchanged, this, [this, &member] { answered(member, true); });
+    connect(member.api, &AbstractWeatherAPI::networkError, this, [this, &member] { answered(member, false); });
+}
+
+void BlendedWeatherAPI::answered(Member &member, bool valid)
+{
+    if (!member.waiting)
+        return; // a late publish, e.g. after sunrise data came in
+    member.waiting = false;
+    member.answered = valid && !member.api->currentData().hourlyForecasts().isEmpty();
+    if (m_nmi.waiting || m_owm.waiting)
+        return;
+
+    if (!m_nmi.answered && !m_owm.answered) {
+        lastRequestFailed_ = true;
+        emit networkError();
+        return;
+    }
+    lastRequestFailed_ = false;
+    combine();
+    publish();
+}
+
+void BlendedWeatherAPI::combine()
+{
+    TraceSpan span("blend", locationId_);
+    QElapsedTimer timer;
+    timer.start();
+
+    if (m_nmi.answered && m_owm.answered) {
+        AbstractWeatherForecast &nmi = m_nmi.api->currentData();
+        AbstractWeatherForecast &owm = m_owm.api->currentData();
+        const Weights weights = weightsFor(ForecastVerification(ForecastVerification::pathFor(locationId_)));
+        QList<AbstractHourlyWeatherForecast> hours;
+        const float spread = blend(nmi.hourlyForecasts(), owm.hourlyForecasts(), weights, hours);
+        DerivedQuantities::apply(hours);
+        // the scratch arena may still be in use by the member that answered last
+        static MonotonicArena arena(16 * 1024);
+        const QList<AbstractDailyWeatherForecast> days = daysOf(hours, arena);
+        currentData_ = AbstractWeatherForecast(std::min(nmi.timeCreated(), owm.timeCreated()), locationId_, latitude_, longitude_, hours, days);
+        Metrics::instance().record(QStringLiteral("kweather_blend_spread_millikelvin"), backendName(), QString(), std::lround(spread * 1000));
+    } else {
+        // only one of them this time, shown as it is
+        currentData_ = (m_nmi.answered ? m_nmi : m_owm).api->currentData();
+    }
+    currentData_.setSunrise(currentSunriseData_);
+    Metrics::instance().record(QStringLiteral("kweather_blend_microseconds"), backendName(), QString(), timer.nsecsElapsed() / 1000);
+}
+
+void BlendedWeatherAPI::parseData(const QByteArray &data)
+{
+    Q_UNUSED(data);
+    qCWarning(KWEATHER_LOG) << "a blend has no document of its own to parse";
+}
+
+void BlendedWeatherAPI::parse(QNetworkReply *reply)
+{
+    Q_UNUSED(reply);
+}
+
+void BlendedWeatherAPI::applySunriseDataToForecast()
+{
+    for (Member *member : {&m_nmi, &m_owm}) {
+        if (!member->api)
+            continue;
+        member->api->setCurrentSunriseData(currentSunriseData_);
+        member->api->applySunriseDataToForecast();
+    }
+    if (m_nmi.answered || m_owm.answered)
+        combine(); // again, with the icons of the members updated
+    else
+        currentData_.setSunrise(currentSunriseData_);
+}
+
+BlendedWeatherAPI::Weights BlendedWeatherAPI::weightsFor(const ForecastVerification &verification)
+{
+    Weights weights;
+    weights.temperature = share(verification, ForecastVerification::Temperature);
+    weights.windSpeed = share(verification, ForecastVerification::WindSpeed);
+    weights.precipitation = share(verification, ForecastVerification::Precipitation);
+    weights.pressure = share(verification, ForecastVerification::Pressure);
+    return weights;
+}
+
+float BlendedWeatherAPI::blend(const QList<AbstractHourlyWeatherForecast> &nmi,
+                               const QList<AbstractHourlyWeatherForecast> &owm,
+                               const Weights &weights,
+                               QList<AbstractHourlyWeatherForecast> &hours)
+{
+    hours.clear();
+    hours.reserve(nmi.size() + owm.size());
+    // the weighted standard deviation of two values is this times their difference
+    const float spreadFactor = std::sqrt(weights.temperature * (1 - weights.temperature));
+    double spreadSum = 0;
+    int both = 0;
+
+    // both are on the hourly grid already, see Interpolation::resample()
+    const qint64 end = std::numeric_limits<qint64>::max();
+    int i = 0, j = 0;
+    while (i < nmi.size() || j < owm.size()) {
+        const qint64 a = i < nmi.size() ? nmi.at(i).date().toSecsSinceEpoch() : end;
+        const qint64 b = j < owm.size() ? owm.at(j).date().toSecsSinceEpoch() : end;
+        if (a != b) {
+            hours.append(a < b ? nmi.at(i++) : owm.at(j++));
+            continue;
+        }
+
+        const AbstractHourlyWeatherForecast &x = nmi.at(i++);
+        const AbstractHourlyWeatherForecast &y = owm.at(j++);
+        // icon and description of the one trusted more for temperature
+        AbstractHourlyWeatherForecast hour = weights.temperature >= 0.5f ? x : y;
+        hour.setTemperature(mix(x.temperature(), y.temperature(), weights.temperature));
+        hour.setHumidity(mix(x.humidity(), y.humidity(), weights.temperature));
+        hour.setPressure(mix(x.pressure(), y.pressure(), weights.pressure));
+        hour.setPrecipitationAmount(mix(x.precipitationAmount(), y.precipitationAmount(), weights.precipitation));
+        hour.setUvIndex(x.uvIndex()); // owm has none
+        hour.setFog(x.fog());
+
+        // speeds mixed as they are, the direction as the mean of the wind vectors
+        hour.setWindSpeed(mix(x.windSpeed(), y.windSpeed(), weights.windSpeed));
+        const float east = mix(x.windSpeed() * std::sin(x.windDegrees() * DEGREES), y.windSpeed() * std::sin(y.windDegrees() * DEGREES), weights.windSpeed);
+        const float north = mix(x.windSpeed() * std::cos(x.windDegrees() * DEGREES), y.windSpeed() * std::cos(y.windDegrees() * DEGREES), weights.windSpeed);
+        if (east != 0 || north != 0) {
+            const float degrees = std::atan2(east, north) / DEGREES;
+            hour.setWindDegrees(degrees < 0 ? degrees + 360 : degrees);
+        }
+        hour.setWindDirection(DerivedQuantities::windDirection(hour.windDegrees()));
+        hour.setInterpolated(x.interpolated() && y.interpolated());
+
+        const float spread = spreadFactor * std::abs(x.temperature() - y.temperature());
+        hour.setTemperatureSpread(spread);
+        spreadSum += spread;
+        both++;
+        hours.append(hour);
+    }
+    return both ? static_cast<float>(spreadSum / both) : 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_BLENDEDWEATHERAPI_H
+#define KWEATHER_BLENDEDWEATHERAPI_H
+
+#include "abstractweatherapi.h"
+#include "global.h"
+
+#include <QObject>
+
+class ForecastVerification;
+
+// Both backends at once, made into one forecast: every refresh goes to NMI and,
+// with a token, OWM in parallel; once both answered their hours are merged.
+//
+// Both parsers already put their hours on the hourly grid, so lining them up is
+// a merge join on the time. Temperature, wind, precipitation and pressure are
+// mixed with weights of the location, inverse to the error ForecastVerification
+// measured for each backend over the next two days; until there are enough
+// scores both count the same. Hours only one backend has are taken as they are.
+// How far the two disagree is kept as the temperature spread of every hour and
+// recorded to kweather_blend_spread_millikelvin.
+class BlendedWeatherAPI : public AbstractWeatherAPI
+{
+    Q_OBJECT
+
+public:
+    // share of NMI for each quantity, OWM has the rest
+    struct Weights {
+        float temperature = 0.5f; // humidity too
+        float windSpeed = 0.5f;
+        float precipitation = 0.5f;
+        float pressure = 0.5f;
+    };
+
+    BlendedWeatherAPI(QString locationId, QString timeZone, double latitude, double longitude);
+    ~BlendedWeatherAPI() override;
+
+    void update() override;
+    void parseData(const QByteArray &data) override; // the members parse their own
+    void applySunriseDataToForecast() override;
+    QString backendName() const override
+    {
+        return QStringLiteral("blend");
+    }
+
+    static Weights weightsFor(const ForecastVerification &verification);
+    // hours of both on the same grid merged into hours, returns the mean temperature
+    // spread of the hours both have
+    static float blend(const QList<AbstractHourlyWeatherForecast> &nmi, const QList<AbstractHourlyWeatherForecast> &owm, const Weights &weights, QList<AbstractHourlyWeatherForecast> &hours);
+
+signals:
+    void memberUpdated(AbstractWeatherForecast &forecast, Kweather::Backend backend); // a run of one of the backends
+
+public slots:
+    void parse(QNetworkReply *reply) override;
+
+private:
+    struct Member {
+        AbstractWeatherAPI *api = nullptr;
+        bool waiting = false; // for the answer to the current refresh
+        bool answered = false; // with a forecast
+    };
+
+    void connectMember(Member &member, Kweather::Backend backend);
+    void answered(Member &member, bool valid);
+    void combine();
+
+    Member m_nmi, m_owm;
+};
+
+#endif // KWEATHER_BLENDEDWEATHERAPI_H
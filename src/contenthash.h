@@ -0,0 +1,68 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_CONTENTHASH_H
+#define KWEATHER_CONTENTHASH_H
+
+#include <QByteArray>
+#include <QString>
+
+#include <cstring>
+
+// 64 bit running hash for telling whether a document or a forecast changed since
+// last time. Eight bytes per multiply, fast enough to run over every response;
+// not meant to resist anyone crafting collisions.
+class ContentHash
+{
+public:
+    void add(const void *data, std::size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        for (; size >= 8; bytes += 8, size -= 8) {
+            quint64 word;
+            std::memcpy(&word, bytes, 8);
+            mix(word);
+        }
+        quint64 tail = 0;
+        std::memcpy(&tail, bytes, size);
+        mix(tail ^ (quint64(size) << 56));
+    }
+    void add(const QString &str)
+    {
+        add(str.constData(), str.size() * sizeof(QChar));
+    }
+    template<typename T> void addValue(T value) // plain numbers and enums
+    {
+        quint64 word = 0;
+        static_assert(sizeof(T) <= sizeof(word), "one word at most");
+        std::memcpy(&word, &value, sizeof(T));
+        mix(word);
+    }
+
+    quint64 result() const
+    {
+        return m_state ^ (m_state >> 29);
+    }
+
+    static quint64 of(const QByteArray &data)
+    {
+        ContentHash hash;
+        hash.add(data.constData(), data.size());
+        return hash.result();
+    }
+
+private:
+    void mix(quint64 word)
+    {
+        m_state = (m_state ^ word) * 0x9e3779b97f4a7c15ull;
+        m_state ^= m_state >> 32;
+    }
+
+    quint64 m_state = 0xcbf29ce484222325ull;
+};
+
+#endif // KWEATHER_CONTENTHASH_H
@@ -0,0 +1,332 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "dbusadaptors.h"
+#include "abstractdailyweatherforecast.h"
+#include "abstracthourlyweatherforecast.h"
+#include "metrics.h"
+#include "startupprofiler.h"
+#include "weatherlocation.h"
+#include "weatherlocationmodel.h"
+
+#include <QDBusConnection>
+#include <QDateTime>
+#include <QSet>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+static const int MAX_REMOVED = 64; // removals remembered for changedSince()
+
+static CurrentConditions toCurrentConditions(const AbstractHourlyWeatherForecast &hour)
+{
+    CurrentConditions ret;
+    ret.time = hour.date().toSecsSinceEpoch();
+    ret.temperature = hour.temperature();
+    ret.humidity = hour.humidity();
+    ret.pressure = hour.pressure();
+    ret.windDirection = static_cast<int>(hour.windDirection());
+    ret.windSpeed = hour.windSpeed();
+    ret.weatherIcon = hour.weatherIcon();
+    ret.weatherDescription = hour.weatherDescription();
+    return ret;
+}
+
+static DaySummary toDaySummary(const AbstractDailyWeatherForecast &day)
+{
+    DaySummary ret;
+    ret.julianDay = day.date().toJulianDay();
+    ret.maxTemp = day.maxTemp();
+    ret.minTemp = day.minTemp();
+    ret.precipitation = day.precipitation();
+    ret.weatherIcon = day.weatherIcon();
+    ret.weatherDescription = day.weatherDescription();
+    return ret;
+}
+
+/* ~~~ WeatherLocationAdaptor ~~~ */
+
+WeatherLocationAdaptor::WeatherLocationAdaptor(WeatherLocation *location)
+    : QDBusAbstractAdaptor(location)
+    , m_location(location)
+{
+    registerKWeatherDBusTypes();
+    setAutoRelaySignals(true);
+
+    m_lastConditions = currentConditions();
+    m_lastDays = daySummaries(-1);
+    connect(location, &WeatherLocation::currentForecastChange, this, &WeatherLocationAdaptor::announceChanges);
+}
+
+QString WeatherLocationAdaptor::objectPath(const QString &locationId)
+{
+    // object path elements may only contain [A-Za-z0-9_]
+    QString id = locationId;
+    for (auto &c : id) {
+        if (!(c.isLetterOrNumber() && c.unicode() < 128))
+            c = QLatin1Char('_');
+    }
+    return QStringLiteral("/locations/") + id;
+}
+
+QString WeatherLocationAdaptor::name() const
+{
+    return m_location->locationName();
+}
+
+QString WeatherLocationAdaptor::backend() const
+{
+    return m_location->backend();
+}
+
+QString WeatherLocationAdaptor::lastUpdated() const
+{
+    return m_location->lastUpdated().toString(Qt::ISODate);
+}
+
+QString WeatherLocationAdaptor::getWeatherData()
+{
+    return QString::fromUtf8(QJsonDocument(m_location->forecast().toJson()).toJson(QJsonDocument::Compact));
+}
+
+void WeatherLocationAdaptor::update()
+{
+    m_location->update();
+}
+
+CurrentConditions WeatherLocationAdaptor::currentConditions()
+{
+    return toCurrentConditions(m_location->currentForecast());
+}
+
+QList<DaySummary> WeatherLocationAdaptor::daySummaries(int days)
+{
+    QList<DaySummary> ret;
+    const auto forecast = m_location->forecast();
+    for (const auto &day : forecast.dailyForecasts()) {
+        if (days >= 0 && ret.count() >= days)
+            break;
+        ret.append(toDaySummary(day));
+    }
+    return ret;
+}
+
+QList<HourSummary> WeatherLocationAdaptor::hourRange(qint64 from, qint64 to)
+{
+    QList<HourSummary> ret;
+    auto forecast = m_location->forecast();
+    for (const auto &hour : qAsConst(forecast.hourlyForecasts())) {
+        const qint64 time = hour.date().toSecsSinceEpoch();
+        if (time < from || time > to)
+            continue;
+        HourSummary summary;
+        summary.time = time;
+        summary.temperature = hour.temperature();
+        summary.precipitation = hour.precipitationAmount();
+        summary.windSpeed = hour.windSpeed();
+        summary.weatherIcon = hour.weatherIcon();
+        ret.append(summary);
+    }
+    return ret;
+}
+
+QString WeatherLocationAdaptor::verification()
+{
+    return QString::fromUtf8(QJsonDocument(m_location->verification()).toJson(QJsonDocument::Compact));
+}
+
+void WeatherLocationAdaptor::announceChanges()
+{
+    const auto conditions = currentConditions();
+    if (conditions != m_lastConditions) {
+        m_lastConditions = conditions;
+        emit currentConditionsChanged(conditions);
+    }
+
+    const auto days = daySummaries(-1);
+    for (int i = 0; i < days.count(); i++) {
+        if (i >= m_lastDays.count() || days.at(i) != m_lastDays.at(i))
+            emit daySummaryChanged(i, days.at(i));
+    }
+    if (days.count() < m_lastDays.count())
+        emit daysRemoved(m_lastDays.count() - days.count());
+    m_lastDays = days;
+}
+
+/* ~~~ LocationModelAdaptor ~~~ */
+
+LocationModelAdaptor::LocationModelAdaptor(WeatherLocationListModel *model)
+    : QDBusAbstractAdaptor(model)
+    , m_model(model)
+    // stamps of this instance start at its startup time, see changedSince()
+    , m_changeStamp(QDateTime::currentMSecsSinceEpoch())
+    , m_forgottenStamp(m_changeStamp)
+{
+    registerKWeatherDBusTypes();
+
+    connect(model, &WeatherLocationListModel::locationAdded, this, [this](WeatherLocation *location) {
+        exportLocation(location);
+        emit added(location->locationId());
+    });
+    connect(model, &WeatherLocationListModel::locationRemoved, this, [this](const QString &locationId) {
+        QDBusConnection::sessionBus().unregisterObject(WeatherLocationAdaptor::objectPath(locationId));
+        m_stamps.remove(locationId);
+        m_removedStamps[locationId] = ++m_changeStamp;
+        forgetOldRemovals();
+        emit removed(locationId);
+        emit changed(m_changeStamp);
+    });
+
+    QDBusConnection::sessionBus().registerObject(QStringLiteral("/"), model, QDBusConnection::ExportAdaptors);
+    for (auto location : model->getList())
+        exportLocation(location);
+}
+
+void LocationModelAdaptor::exportLocation(WeatherLocation *location)
+{
+    new WeatherLocationAdaptor(location);
+    QDBusConnection::sessionBus().registerObject(WeatherLocationAdaptor::objectPath(location->locationId()), location, QDBusConnection::ExportAdaptors);
+
+    const QString locationId = location->locationId();
+    connect(location, &WeatherLocation::weatherRefresh, this, [this, locationId] {
+        touch(locationId);
+        emit forecastUpdated(locationId);
+    });
+    // same forecast with a newer lastUpdated, in the summary and in the cache
+    connect(location, &WeatherLocation::forecastConfirmed, this, [this, locationId] {
+        touch(locationId);
+        emit forecastUpdated(locationId);
+    });
+    touch(locationId);
+}
+
+void LocationModelAdaptor::touch(const QString &locationId)
+{
+    m_stamps[locationId] = ++m_changeStamp;
+    m_removedStamps.remove(locationId);
+    emit changed(m_changeStamp);
+}
+
+void LocationModelAdaptor::forgetOldRemovals()
+{
+    while (m_removedStamps.size() > MAX_REMOVED) {
+        auto oldest = std::min_element(m_removedStamps.begin(), m_removedStamps.end());
+        m_forgottenStamp = std::max(m_forgottenStamp, oldest.value());
+        m_removedStamps.erase(oldest);
+    }
+}
+
+LocationSummary LocationModelAdaptor::summary(WeatherLocation *location) const
+{
+    LocationSummary ret;
+    ret.locationId = location->locationId();
+    ret.locationName = location->locationName();
+    ret.changeStamp = m_stamps.value(ret.locationId);
+    ret.lastUpdated = location->lastUpdated().toSecsSinceEpoch();
+
+    const auto &current = location->currentForecast();
+    ret.temperature = current.temperature();
+    ret.weatherIcon = current.weatherIcon();
+    ret.weatherDescription = current.weatherDescription();
+
+    const auto forecast = location->forecast();
+    if (!forecast.dailyForecasts().isEmpty()) {
+        ret.maxTemp = forecast.dailyForecasts().first().maxTemp();
+        ret.minTemp = forecast.dailyForecasts().first().minTemp();
+    }
+    return ret;
+}
+
+quint64 LocationModelAdaptor::changeStamp()
+{
+    return m_changeStamp;
+}
+
+QList<LocationSummary> LocationModelAdaptor::locationSummaries(const QStringList &locationIds)
+{
+    QSet<QString> wanted;
+    for (const auto &id : locationIds)
+        wanted.insert(id);
+
+    QList<LocationSummary> ret;
+    for (auto location : m_model->getList()) {
+        if (wanted.isEmpty() || wanted.contains(location->locationId()))
+            ret.append(summary(location));
+    }
+    return ret;
+}
+
+QList<LocationSummary> LocationModelAdaptor::changedSince(quint64 stamp, QStringList &removed, quint64 &currentStamp, bool &resync)
+{
+    // a stamp outside of the ones handed out by this instance comes from an earlier
+    // or later daemon, its client needs everything, as does one that may have missed
+    // removals no longer remembered; m_forgottenStamp starts at our first stamp
+    resync = stamp > m_changeStamp || (stamp > 0 && stamp < m_forgottenStamp);
+    if (resync)
+        stamp = 0;
+
+    QList<LocationSummary> ret;
+    for (auto location : m_model->getList()) {
+        if (m_stamps.value(location->locationId()) > stamp)
+            ret.append(summary(location));
+    }
+    for (auto it = m_removedStamps.constBegin(); it != m_removedStamps.constEnd(); ++it) {
+        if (it.value() > stamp)
+            removed.append(it.key());
+    }
+    currentStamp = m_changeStamp;
+    return ret;
+}
+
+QStringList LocationModelAdaptor::locations()
+{
+    QStringList ret;
+    for (auto location : m_model->getList())
+        ret.append(location->locationId());
+    return ret;
+}
+
+void LocationModelAdaptor::refresh()
+{
+    for (auto location : m_model->getList())
+        location->update();
+}
+
+void LocationModelAdaptor::reloadLocations()
+{
+    m_model->reload();
+}
+
+/* ~~~ MetricsAdaptor ~~~ */
+
+MetricsAdaptor::MetricsAdaptor(Metrics *metrics)
+    : QDBusAbstractAdaptor(metrics)
+    , m_metrics(metrics)
+{
+    QDBusConnection::sessionBus().registerObject(QStringLiteral("/metrics"), metrics, QDBusConnection::ExportAdaptors);
+}
+
+QString MetricsAdaptor::prometheus()
+{
+    return QString::fromUtf8(m_metrics->toPrometheus());
+}
+
+QString MetricsAdaptor::json()
+{
+    return QString::fromUtf8(QJsonDocument(m_metrics->toJson()).toJson(QJsonDocument::Compact));
+}
+
+qint64 MetricsAdaptor::percentile(const QString &name, const QString &backend, const QString &host, double q)
+{
+    auto histogram = m_metrics->histogram(name, backend, host);
+    return histogram ? histogram->percentile(q) : -1;
+}
+
+QString MetricsAdaptor::startupProfile()
+{
+    return StartupProfiler::report();
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_DBUSADAPTORS_H
+#define KWEATHER_DBUSADAPTORS_H
+
+#include "dbustypes.h"
+
+#include <QDBusAbstractAdaptor>
+#include <QHash>
+#include <QStringList>
+
+class Metrics;
+class WeatherLocation;
+class WeatherLocationListModel;
+
+static const QString KWEATHER_DBUS_SERVICE = QStringLiteral("org.kde.kweather");
+
+// exported at /locations/<locationId>
+// prefer the typed methods and the *Changed delta signals over getWeatherData, which
+// serializes the whole forecast on every call
+class WeatherLocationAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kweather.WeatherLocation")
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(QString backend READ backend)
+    Q_PROPERTY(QString lastUpdated READ lastUpdated)
+
+public:
+    explicit WeatherLocationAdaptor(WeatherLocation *location);
+
+    static QString objectPath(const QString &locationId);
+
+    QString name() const;
+    QString backend() const;
+    QString lastUpdated() const;
+
+public slots:
+    QString getWeatherData(); // whole forecast as compact json
+    void update();
+
+    CurrentConditions currentConditions();
+    QList<DaySummary> daySummaries(int days);
+    QList<HourSummary> hourRange(qint64 from, qint64 to); // secs since epoch, inclusive
+    QString verification(); // error statistics per backend and lead time as json, see ForecastVerification
+
+signals:
+    void currentForecastChange();
+
+    // only emitted for values that differ from what was last announced
+    void currentConditionsChanged(const CurrentConditions &conditions);
+    void daySummaryChanged(int index, const DaySummary &day);
+    void daysRemoved(int count); // the forecast now has count fewer days
+
+private:
+    void announceChanges();
+
+    WeatherLocation *m_location;
+    CurrentConditions m_lastConditions;
+    QList<DaySummary> m_lastDays;
+};
+
+// exported at /, registers every location of the model below /locations
+//
+// Every change to a location (added, new forecast) bumps a global change stamp.
+// Clients remember the stamp they last saw and ask changedSince() for everything
+// newer in one round trip, instead of watching and polling each location. Stamps
+// start at the startup time of the daemon in msecs, so that those of a daemon
+// restarted meanwhile never overlap. Only the last 64 removals are remembered; a
+// client with a stamp from before those or from another daemon gets every location
+// and resync set, and drops whatever it has that is not listed.
+class LocationModelAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kweather.LocationModel")
+
+public:
+    explicit LocationModelAdaptor(WeatherLocationListModel *model);
+
+public slots:
+    QStringList locations();
+    void refresh();
+    void reloadLocations(); // re-read the location list after a client changed it
+
+    quint64 changeStamp();
+    // summaries of the given locations, or of all locations in order if the list is empty
+    QList<LocationSummary> locationSummaries(const QStringList &locationIds);
+    // locations changed after stamp, the ids removed after it and the current stamp
+    QList<LocationSummary> changedSince(quint64 stamp, QStringList &removed, quint64 &currentStamp, bool &resync);
+
+signals:
+    void added(const QString &locationId);
+    void removed(const QString &locationId);
+    void forecastUpdated(const QString &locationId);
+    void changed(quint64 stamp);
+
+private:
+    void exportLocation(WeatherLocation *location);
+    void touch(const QString &locationId);
+    void forgetOldRemovals();
+    LocationSummary summary(WeatherLocation *location) const;
+
+    WeatherLocationListModel *m_model;
+    quint64 m_changeStamp;
+    QHash<QString, quint64> m_stamps;
+    QHash<QString, quint64> m_removedStamps;
+    quint64 m_forgottenStamp; // the newest removal dropped from m_removedStamps
+};
+
+// exported at /metrics
+class MetricsAdaptor : public QDBusAbstractAdaptor
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.kde.kweather.Metrics")
+
+public:
+    explicit MetricsAdaptor(Metrics *metrics);
+
+public slots:
+    QString prometheus(); // Prometheus text exposition format
+    QString json();
+    qint64 percentile(const QString &name, const QString &backend, const QString &host, double q);
+    QString startupProfile(); // see StartupProfiler
+
+private:
+    Metrics *m_metrics;
+};
+
+#endif // KWEATHER_DBUSADAPTORS_H
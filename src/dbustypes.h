@@ -0,0 +1,162 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef KWEATHER_DBUSTYPES_H
+#define KWEATHER_DBUSTYPES_H
+
+// typed values of the org.kde.kweather.WeatherLocation interface, shared with the plasmoids
+
+#include <QDBusArgument>
+#include <QDBusMetaType>
+#include <QList>
+#include <QString>
+
+// (xdddidss)
+struct CurrentConditions {
+    qint64 time = 0; // secs since epoch
+    double temperature = 0; // celsius
+    double humidity = 0;    // %
+    double pressure = 0;    // hPa
+    int windDirection = 0;  // Kweather::WindDirection
+    double windSpeed = 0;   // m/s
+    QString weatherIcon;
+    QString weatherDescription;
+
+    bool operator==(const CurrentConditions &other) const
+    {
+        return time == other.time && temperature == other.temperature && humidity == other.humidity && pressure == other.pressure && windDirection == other.windDirection && windSpeed == other.windSpeed
+            && weatherIcon == other.weatherIcon && weatherDescription == other.weatherDescription;
+    }
+    bool operator!=(const CurrentConditions &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// (xdddss)
+struct DaySummary {
+    qint64 julianDay = 0;
+    double maxTemp = 0;
+    double minTemp = 0;
+    double precipitation = 0; // mm
+    QString weatherIcon;
+    QString weatherDescription;
+
+    bool operator==(const DaySummary &other) const
+    {
+        return julianDay == other.julianDay && maxTemp == other.maxTemp && minTemp == other.minTemp && precipitation == other.precipitation && weatherIcon == other.weatherIcon && weatherDescription == other.weatherDescription;
+    }
+    bool operator!=(const DaySummary &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// (xddds)
+struct HourSummary {
+    qint64 time = 0; // secs since epoch
+    double temperature = 0;
+    double precipitation = 0;
+    double windSpeed = 0;
+    QString weatherIcon;
+};
+
+// (sstxdssdd), one entry of the location index on /
+struct LocationSummary {
+    QString locationId;
+    QString locationName;
+    quint64 changeStamp = 0; // stamp of the last change of this location
+    qint64 lastUpdated = 0;  // secs since epoch
+    double temperature = 0;  // current
+    QString weatherIcon;
+    QString weatherDescription;
+    double maxTemp = 0; // today
+    double minTemp = 0;
+};
+
+Q_DECLARE_METATYPE(CurrentConditions)
+Q_DECLARE_METATYPE(DaySummary)
+Q_DECLARE_METATYPE(HourSummary)
+Q_DECLARE_METATYPE(LocationSummary)
+
+inline QDBusArgument &operator<<(QDBusArgument &arg, const CurrentConditions &c)
+{
+    arg.beginStructure();
+    arg << c.time << c.temperature << c.humidity << c.pressure << c.windDirection << c.windSpeed << c.weatherIcon << c.weatherDescription;
+    arg.endStructure();
+    return arg;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &arg, CurrentConditions &c)
+{
+    arg.beginStructure();
+    arg >> c.time >> c.temperature >> c.humidity >> c.pressure >> c.windDirection >> c.windSpeed >> c.weatherIcon >> c.weatherDescription;
+    arg.endStructure();
+    return arg;
+}
+
+inline QDBusArgument &operator<<(QDBusArgument &arg, const DaySummary &d)
+{
+    arg.beginStructure();
+    arg << d.julianDay << d.maxTemp << d.minTemp << d.precipitation << d.weatherIcon << d.weatherDescription;
+    arg.endStructure();
+    return arg;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &arg, DaySummary &d)
+{
+    arg.beginStructure();
+    arg >> d.julianDay >> d.maxTemp >> d.minTemp >> d.precipitation >> d.weatherIcon >> d.weatherDescription;
+    arg.endStructure();
+    return arg;
+}
+
+inline QDBusArgument &operator<<(QDBusArgument &arg, const HourSummary &h)
+{
+    arg.beginStructure();
+    arg << h.time << h.temperature << h.precipitation << h.windSpeed << h.weatherIcon;
+    arg.endStructure();
+    return arg;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &arg, HourSummary &h)
+{
+    arg.beginStructure();
+    arg >> h.time >> h.temperature >> h.precipitation >> h.windSpeed >> h.weatherIcon;
+    arg.endStructure();
+    return arg;
+}
+
+inline QDBusArgument &operator<<(QDBusArgument &arg, const LocationSummary &l)
+{
+    arg.beginStructure();
+    arg << l.locationId << l.locationName << l.changeStamp << l.lastUpdated << l.temperature << l.weatherIcon << l.weatherDescription << l.maxTemp << l.minTemp;
+    arg.endStructure();
+    return arg;
+}
+
+inline const QDBusArgument &operator>>(const QDBusArgument &arg, LocationSummary &l)
+{
+    arg.beginStructure();
+    arg >> l.locationId >> l.locationName >> l.changeStamp >> l.lastUpdated >> l.temperature >> l.weatherIcon >> l.weatherDescription >> l.maxTemp >> l.minTemp;
+    arg.endStructure();
+    return arg;
+}
+
+// call once before using the types on a connection
+inline void registerKWeatherDBusTypes()
+{
+    qDBusRegisterMetaType<CurrentConditions>();
+    qDBusRegisterMetaType<DaySummary>();
+    qDBusRegisterMetaType<HourSummary>();
+    qDBusRegisterMetaType<LocationSummary>();
+    qDBusRegisterMetaType<QList<LocationSummary>>();
+    qDBusRegisterMetaType<QList<DaySummary>>();
+    qDBusRegisterMetaType<QList<HourSummary>>();
+}
+
+#endif // KWEATHER_DBUSTYPES_H
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "derivedquantities.h"
+#include "abstracthourlyweatherforecast.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace DerivedQuantities
+{
+// upper bounds of forces 0 to 11, m/s
+static const float BEAUFORT_LIMITS[] = {0.5f, 1.6f, 3.4f, 5.5f, 8.0f, 10.8f, 13.9f, 17.2f, 20.8f, 24.5f, 28.5f, 32.7f};
+static const int BEAUFORT_LIMIT_COUNT = sizeof(BEAUFORT_LIMITS) / sizeof(BEAUFORT_LIMITS[0]);
+
+static inline int sectorOf(float degrees, float width, int mask)
+{
+    return static_cast<int>(std::floor(degrees / width + 0.5f)) & mask;
+}
+
+void compute(const Input &in, const Output &out, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const float t = in.temperature[i];
+        const float rh = std::min(std::max(in.humidity[i], 1.0f), 100.0f);
+        const float ws = std::max(in.windSpeed[i], 0.0f);
+
+        // water vapour pressure, hPa, for the apparent temperature of the australian bureau of meteorology
+        const float e = rh / 100 * 6.105f * std::exp(17.27f * t / (237.7f + t));
+        out.apparentTemperature[i] = t + 0.33f * e - 0.70f * ws - 4.00f;
+
+        // magnus formula
+        const float gamma = std::log(rh / 100) + 17.62f * t / (243.12f + t);
+        out.dewPoint[i] = 243.12f * gamma / (17.62f - gamma);
+
+        // environment canada, km/h, only below 10 °C in wind
+        const float kmh = ws * 3.6f;
+        const float v = std::pow(std::max(kmh, 1.0f), 0.16f);
+        const float chill = 13.12f + 0.6215f * t - 11.37f * v + 0.3965f * t * v;
+        out.windChill[i] = t <= 10 && kmh > 4.8f ? chill : t;
+
+        // rothfusz regression, fahrenheit, only in humid heat
+        const float f = t * 1.8f + 32;
+        const float heat = -42.379f + 2.04901523f * f + 10.14333127f * rh - 0.22475541f * f * rh - 0.00683783f * f * f - 0.05481717f * rh * rh
+            + 0.00122874f * f * f * rh + 0.00085282f * f * rh * rh - 0.00000199f * f * f * rh * rh;
+        out.heatIndex[i] = f >= 80 && rh >= 40 ? (heat - 32) / 1.8f : t;
+
+        out.windSector[i] = static_cast<qint8>(sectorOf(in.windDegrees[i], 22.5f, 15));
+        int force = 0;
+        for (int j = 0; j < BEAUFORT_LIMIT_COUNT; j++)
+            force += ws >= BEAUFORT_LIMITS[j];
+        out.beaufort[i] = static_cast<qint8>(force);
+    }
+}
+
+void apply(QList<AbstractHourlyWeatherForecast> &hours)
+{
+    static const int CHUNK = 64;
+    float temperature[CHUNK], humidity[CHUNK], windSpeed[CHUNK], windDegrees[CHUNK];
+    float apparentTemperature[CHUNK], dewPoint[CHUNK], windChill[CHUNK], heatIndex[CHUNK];
+    qint8 sector[CHUNK], force[CHUNK];
+    const Input input{temperature, humidity, windSpeed, windDegrees};
+    const Output output{apparentTemperature, dewPoint, windChill, heatIndex, sector, force};
+
+    for (int first = 0; first < hours.size(); first += CHUNK) {
+        const int count = std::min(CHUNK, hours.size() - first);
+        for (int i = 0; i < count; i++) {
+            const auto &hour = hours.at(first + i);
+            temperature[i] = hour.temperature();
+            humidity[i] = hour.humidity();
+            windSpeed[i] = hour.windSpeed();
+            windDegrees[i] = hour.windDegrees();
+        }
+        compute(input, output, count);
+        for (int i = 0; i < count; i++) {
+            auto &hour = hours[first + i];
+            hour.setApparentTemperature(apparentTemperature[i]);
+            hour.setDewPoint(dewPoint[i]);
+            hour.setWindChill(windChill[i]);
+            hour.setHeatIndex(heatIndex[i]);
+            hour.setWindSector(sector[i]);
+            hour.setBeaufort(force[i]);
+        }
+    }
+}
+
+int windSector(float degrees)
+{
+    return sectorOf(degrees, 22.5f, 15);
+}
+
+int beaufort(float windSpeed)
+{
+    return static_cast<int>(std::upper_bound(BEAUFORT_LIMITS, BEAUFORT_LIMITS + BEAUFORT_LIMIT_COUNT, windSpeed) - BEAUFORT_LIMITS);
+}
+
+QString sectorName(int sector)
+{
+    static const char *const names[] = {"N", "NNE", "NE", "ENE", "E", "ESE", "SE", "SSE", "S", "SSW", "SW", "WSW", "W", "WNW", "NW", "NNW"};
+    return QString::fromLatin1(names[sector & 15]);
+}
+
+Kweather::WindDirection windDirection(float degrees)
+{
+    using Kweather::WindDirection;
+    // indexed by the sector it comes from, N, NE, E, ... and pointing the other way
+    static const WindDirection directions[] = {WindDirection::S,
+                                               WindDirection::SW,
+                                               WindDirection::W,
+                                               WindDirection::NW,
+                                               WindDirection::N,
+                                               WindDirection::NE,
+                                               WindDirection::E,
+                                               WindDirection::SE};
+    return directions[sectorOf(degrees, 45, 7)];
+}
+
+float windDegrees(Kweather::WindDirection direction)
+{
+    // indexed by the enum, N, NW, W, SW, S, SE, E, NE
+    static const float degrees[] = {180, 135, 90, 45, 0, 315, 270, 225};
+    return degrees[static_cast<int>(direction)];
+}
+}
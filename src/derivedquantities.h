@@ -0,0 +1,56 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_DERIVEDQUANTITIES_H
+#define KWEATHER_DERIVEDQUANTITIES_H
+
+#include "global.h"
+
+#include <QList>
+#include <QString>
+
+class AbstractHourlyWeatherForecast;
+
+// Quantities computed from the ones backends send: apparent temperature, dew
+// point, wind chill, heat index, wind sector and Beaufort number. compute() runs
+// over whole series in plain arrays, every output is a select between formulas
+// rather than a branch, so the loop stays free for the compiler to vectorize.
+namespace DerivedQuantities
+{
+// celsius, %, m/s and the degrees the wind comes from
+struct Input {
+    const float *temperature;
+    const float *humidity;
+    const float *windSpeed;
+    const float *windDegrees;
+};
+
+struct Output {
+    float *apparentTemperature; // celsius, Steadman's, with wind and humidity
+    float *dewPoint; // celsius
+    float *windChill; // celsius, the temperature where it does not apply
+    float *heatIndex; // celsius, the temperature where it does not apply
+    qint8 *windSector; // 0 = N, clockwise, 16 points
+    qint8 *beaufort;
+};
+
+void compute(const Input &input, const Output &output, int count);
+
+// computes the derived fields of every hour, in chunks gathered on the stack
+void apply(QList<AbstractHourlyWeatherForecast> &hours);
+
+int windSector(float degrees);
+int beaufort(float windSpeed);
+// "N", "NNE", ... of a windSector()
+QString sectorName(int sector);
+// where the wind blows to, in eight points, for degrees it comes from
+Kweather::WindDirection windDirection(float degrees);
+// the middle of the sector it blows from, for forecasts cached without degrees
+float windDegrees(Kweather::WindDirection direction);
+}
+
+#endif // KWEATHER_DERIVEDQUANTITIES_H
@@ -0,0 +1,220 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_FIELDMAP_H
+#define KWEATHER_FIELDMAP_H
+
+#include "jsondecoder.h"
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+
+#include <initializer_list>
+#include <vector>
+
+// Short codes (icon and symbol names) kept inside a record, so that the scratch
+// records of a parse own no heap strings. view() shares the buffer, it must not
+// outlive the record.
+template<int Capacity> struct FixedText {
+    QChar text[Capacity];
+    int length = 0;
+
+    // up to, not including, the first stop character
+    void assign(const QString &value, QChar stop = QChar())
+    {
+        length = 0;
+        for (const QChar c : value) {
+            if (c == stop || length == Capacity)
+                break;
+            text[length++] = c;
+        }
+    }
+    bool isEmpty() const
+    {
+        return length == 0;
+    }
+    QString view() const
+    {
+        return QString::fromRawData(text, length);
+    }
+};
+
+// Declarative extraction of backend payloads. A FieldMap is built once from
+// dotted paths ("main.temp", "weather.0.icon") and the setter that stores each
+// value in a Record. The paths are merged into one tree, so apply() converts and
+// searches every json object on the way exactly once, however many fields it holds.
+// Setters only run for values that are present. With simdjson, apply() also walks
+// its dom directly and hands the setters just the leaves, as QJsonValues.
+template<typename Record> class FieldMap
+{
+public:
+    using Setter = void (*)(Record &record, const QJsonValue &value);
+
+    struct Field {
+        const char *path;
+        Setter setter;
+    };
+
+    FieldMap(std::initializer_list<Field> fields)
+    {
+        for (const auto &field : fields)
+            add(field);
+    }
+
+    void apply(const QJsonObject &object, Record &record) const
+    {
+        applyObject(m_root, object, record);
+    }
+
+#ifdef HAVE_SIMDJSON
+    void apply(simdjson::dom::object object, Record &record) const
+    {
+        applyObject(m_root, object, record);
+    }
+#endif
+
+private:
+    struct Node {
+        QString key; // for members
+        QByteArray utf8Key;
+        int index = -1; // for array elements
+        Setter setter = nullptr;
+        std::vector<Node> children;
+    };
+
+    void add(const Field &field)
+    {
+        Node *node = &m_root;
+        const auto segments = QString::fromLatin1(field.path).split(QLatin1Char('.'));
+        for (const auto &segment : segments) {
+            bool isIndex;
+            const int index = segment.toInt(&isIndex);
+            Node *child = nullptr;
+            for (auto &c : node->children) {
+                if (isIndex ? c.index == index : c.key == segment) {
+                    child = &c;
+                    break;
+                }
+            }
+            if (!child) {
+                node->children.emplace_back();
+                child = &node->children.back();
+                if (isIndex)
+                    child->index = index;
+                else
+                    child->key = segment;
+                child->utf8Key = segment.toUtf8();
+            }
+            node = child;
+        }
+        node->setter = field.setter;
+    }
+
+    void applyValue(const Node &node, const QJsonValue &value, Record &record) const
+    {
+        if (value.isUndefined() || value.isNull())
+            return;
+        if (node.setter)
+            node.setter(record, value);
+        if (node.children.empty())
+            return;
+        if (value.isObject())
+            applyObject(node, value.toObject(), record);
+        else if (value.isArray())
+            applyArray(node, value.toArray(), record);
+    }
+
+    void applyObject(const Node &node, const QJsonObject &object, Record &record) const
+    {
+        for (const auto &child : node.children) {
+            if (child.index < 0)
+                applyValue(child, object.value(child.key), record);
+        }
+    }
+
+    void applyArray(const Node &node, const QJsonArray &array, Record &record) const
+    {
+        for (const auto &child : node.children) {
+            if (child.index >= 0 && child.index < array.size())
+                applyValue(child, array.at(child.index), record);
+        }
+    }
+
+#ifdef HAVE_SIMDJSON
+    // only the error code api, kde code is built without exceptions
+    static QJsonValue toJsonValue(simdjson::dom::element element)
+    {
+        int64_t integer;
+        uint64_t unsignedInteger;
+        double number;
+        std::string_view str;
+        bool boolean;
+        switch (element.type()) {
+        case simdjson::dom::element_type::INT64:
+            element.get(integer);
+            return QJsonValue(static_cast<double>(integer));
+        case simdjson::dom::element_type::UINT64:
+            element.get(unsignedInteger);
+            return QJsonValue(static_cast<double>(unsignedInteger));
+        case simdjson::dom::element_type::DOUBLE:
+            element.get(number);
+            return QJsonValue(number);
+        case simdjson::dom::element_type::STRING:
+            element.get(str);
+            return QJsonValue(QString::fromUtf8(str.data(), static_cast<int>(str.size())));
+        case simdjson::dom::element_type::BOOL:
+            element.get(boolean);
+            return QJsonValue(boolean);
+        case simdjson::dom::element_type::NULL_VALUE:
+            return QJsonValue(QJsonValue::Null);
+        default:
+            // containers are only passed on to mark their presence
+            return QJsonValue(element.is_object() ? QJsonValue::Object : QJsonValue::Array);
+        }
+    }
+
+    void applyValue(const Node &node, simdjson::dom::element value, Record &record) const
+    {
+        if (value.is_null())
+            return;
+        if (node.setter)
+            node.setter(record, toJsonValue(value));
+        if (node.children.empty())
+            return;
+        simdjson::dom::object object;
+        simdjson::dom::array array;
+        if (!value.get(object))
+            applyObject(node, object, record);
+        else if (!value.get(array))
+            applyArray(node, array, record);
+    }
+
+    void applyObject(const Node &node, simdjson::dom::object object, Record &record) const
+    {
+        for (const auto &child : node.children) {
+            simdjson::dom::element value;
+            if (child.index < 0 && !object.at_key(std::string_view(child.utf8Key.constData(), child.utf8Key.size())).get(value))
+                applyValue(child, value, record);
+        }
+    }
+
+    void applyArray(const Node &node, simdjson::dom::array array, Record &record) const
+    {
+        for (const auto &child : node.children) {
+            simdjson::dom::element value;
+            if (child.index >= 0 && !array.at(child.index).get(value))
+                applyValue(child, value, record);
+        }
+    }
+#endif
+
+    Node m_root;
+};
+
+#endif // KWEATHER_FIELDMAP_H
@@ -0,0 +1,471 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "forecasthistory.h"
+#include "contenthash.h"
+#include "kweather_debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtAlgorithms>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const char MAGIC[8] = {'K', 'W', 'H', 'I', 'S', 'T', '\0', '\0'};
+const quint32 VERSION = 1;
+const quint32 BLOCK_MAGIC = 0x4248574b; // "KWHB" in the file
+const int COLUMNS = 6; // temperature, pressure, humidity, wind speed, wind degrees, precipitation
+const qint64 DEFAULT_STEP = 3600; // the delta expected before the first, hourly costs a bit per point
+
+// native byte order, the file never leaves the machine
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 reserved;
+};
+
+struct BlockHeader {
+    quint32 magic;
+    quint32 size; // of the payload following
+    qint64 issued;
+    qint64 firstValid;
+    qint64 lastValid;
+    quint16 count;
+    quint8 backend;
+    quint8 columns;
+    quint32 checksum; // of the payload
+};
+
+static_assert(sizeof(FileHeader) == 16, "file header must not have padding");
+static_assert(sizeof(BlockHeader) == 40, "block header must not have padding");
+
+class BitWriter
+{
+public:
+    // the low bits of value, up to 32
+    void write(quint32 value, int bits)
+    {
+        m_buffer = (m_buffer << bits) | (value & (bits == 32 ? 0xffffffffu : (1u << bits) - 1));
+        m_bits += bits;
+        while (m_bits >= 8) {
+            m_bits -= 8;
+            m_data.append(static_cast<char>(m_buffer >> m_bits));
+        }
+    }
+    QByteArray finish()
+    {
+        if (m_bits > 0)
+            m_data.append(static_cast<char>(m_buffer << (8 - m_bits)));
+        m_bits = 0;
+        return m_data;
+    }
+
+private:
+    QByteArray m_data;
+    quint64 m_buffer = 0;
+    int m_bits = 0;
+};
+
+class BitReader
+{
+public:
+    explicit BitReader(const QByteArray &data)
+        : m_data(reinterpret_cast<const uchar *>(data.constData()))
+        , m_size(static_cast<qint64>(data.size()) * 8)
+    {
+    }
+
+    quint32 read(int bits)
+    {
+        if (m_position + bits > m_size) {
+            m_failed = true;
+            return 0;
+        }
+        quint32 value = 0;
+        while (bits > 0) {
+            const int available = 8 - static_cast<int>(m_position & 7);
+            const int take = std::min(available, bits);
+            const quint32 byte = m_data[m_position >> 3];
+            value = (value << take) | ((byte >> (available - take)) & ((1u << take) - 1));
+            m_position += take;
+            bits -= take;
+        }
+        return value;
+    }
+    bool failed() const
+    {
+        return m_failed;
+    }
+
+private:
+    const uchar *m_data;
+    qint64 m_size;
+    qint64 m_position = 0;
+    bool m_failed = false;
+};
+
+qint32 signExtend(quint32 value, int bits)
+{
+    const quint32 sign = 1u << (bits - 1);
+    return static_cast<qint32>((value ^ sign) - sign);
+}
+
+// the first time is in the block header
+void writeTimes(BitWriter &writer, const QVector<qint64> &times)
+{
+    qint64 previousDelta = DEFAULT_STEP;
+    for (int i = 1; i < times.size(); i++) {
+        const qint64 delta = times[i] - times[i - 1];
+        const qint64 dod = delta - previousDelta;
+        if (dod == 0) {
+            writer.write(0, 1);
+        } else if (dod >= -64 && dod < 64) {
+            writer.write(0x2, 2);
+            writer.write(static_cast<quint32>(dod), 7);
+        } else if (dod >= -256 && dod < 256) {
+            writer.write(0x6, 3);
+            writer.write(static_cast<quint32>(dod), 9);
+        } else if (dod >= -2048 && dod < 2048) {
+            writer.write(0xe, 4);
+            writer.write(static_cast<quint32>(dod), 12);
+        } else {
+            writer.write(0xf, 4);
+            writer.write(static_cast<quint32>(dod), 32);
+        }
+        previousDelta = delta;
+    }
+}
+
+void readTimes(BitReader &reader, qint64 first, int count, QVector<qint64> &times)
+{
+    times.resize(count);
+    times[0] = first;
+    qint64 previousDelta = DEFAULT_STEP;
+    for (int i = 1; i < count; i++) {
+        qint64 dod = 0;
+        if (reader.read(1)) {
+            if (!reader.read(1))
+                dod = signExtend(reader.read(7), 7);
+            else if (!reader.read(1))
+                dod = signExtend(reader.read(9), 9);
+            else if (!reader.read(1))
+                dod = signExtend(reader.read(12), 12);
+            else
+                dod = static_cast<qint32>(reader.read(32));
+        }
+        previousDelta += dod;
+        times[i] = times[i - 1] + previousDelta;
+    }
+}
+
+quint32 floatBits(float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+// the first value whole, then the xor with the one before: nothing when equal,
+// the changed bits within the window of the last change where they fit, or a new
+// window of 5 bits leading zeros and 5 bits length
+void writeFloats(BitWriter &writer, const float *values, int count)
+{
+    quint32 previous = floatBits(values[0]);
+    writer.write(previous, 32);
+    int leading = -1, trailing = 0;
+    for (int i = 1; i < count; i++) {
+        const quint32 current = floatBits(values[i]);
+        const quint32 x = current ^ previous;
+        previous = current;
+        if (x == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+        writer.write(1, 1);
+        const int lead = std::min(static_cast<int>(qCountLeadingZeroBits(x)), 31);
+        const int trail = static_cast<int>(qCountTrailingZeroBits(x));
+        if (leading >= 0 && lead >= leading && trail >= trailing) {
+            writer.write(0, 1);
+            writer.write(x >> trailing, 32 - leading - trailing);
+        } else {
+            const int length = 32 - lead - trail;
+            writer.write(1, 1);
+            writer.write(lead, 5);
+            writer.write(length - 1, 5);
+            writer.write(x >> trail, length);
+            leading = lead;
+            trailing = trail;
+        }
+    }
+}
+
+void readFloats(BitReader &reader, int count, float *values)
+{
+    quint32 previous = reader.read(32);
+    std::memcpy(&values[0], &previous, sizeof(float));
+    int leading = 0, trailing = 0;
+    for (int i = 1; i < count; i++) {
+        if (reader.read(1)) {
+            if (reader.read(1)) {
+                leading = reader.read(5);
+                trailing = 32 - leading - (reader.read(5) + 1);
+            }
+            previous ^= reader.read(32 - leading - trailing) << trailing;
+        }
+        std::memcpy(&values[i], &previous, sizeof(float));
+    }
+}
+
+bool readFileHeader(QFile &file)
+{
+    FileHeader header;
+    return file.read(reinterpret_cast<char *>(&header), sizeof(header)) == sizeof(header) && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+        && header.version == VERSION;
+}
+
+bool writeFileHeader(QIODevice &file)
+{
+    FileHeader header = {};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    return file.write(reinterpret_cast<const char *>(&header), sizeof(header)) == sizeof(header);
+}
+
+bool readBlockHeader(QFile &file, BlockHeader &header)
+{
+    return file.read(reinterpret_cast<char *>(&header), sizeof(header)) == sizeof(header) && header.magic == BLOCK_MAGIC && header.columns == COLUMNS
+        && header.count > 0 && file.pos() + header.size <= file.size();
+}
+
+// the runs from the file position on, up to the first block that is cut off or
+// damaged; returns where that one starts
+qint64 scanBlocks(QFile &file, QVector<ForecastHistory::Run> &runs)
+{
+    BlockHeader header;
+    qint64 end = file.pos();
+    while (!file.atEnd() && readBlockHeader(file, header)) {
+        runs.append({header.issued,
+                     header.firstValid,
+                     header.lastValid,
+                     header.count,
+                     static_cast<Kweather::Backend>(header.backend),
+                     file.pos(),
+                     header.size,
+                     header.checksum});
+        end = file.pos() + header.size;
+        file.seek(end);
+    }
+    return end;
+}
+
+// a torn append leaves a partial block behind, and every block appended after it
+// would be out of reach of the index; cut the file back to the last complete one
+void dropDamagedTail(QFile &file, qint64 end, const QString &path)
+{
+    if (end >= file.size())
+        return;
+    qCWarning(KWEATHER_LOG) << "forecast history" << path << "is damaged at" << end << "- dropping" << file.size() - end << "bytes";
+    if (!(file.openMode() & QIODevice::WriteOnly) || !file.resize(end))
+        qCWarning(KWEATHER_LOG) << "unable to truncate" << path << file.errorString();
+}
+}
+
+ForecastHistory::ForecastHistory(const QString &path)
+    : m_path(path)
+{
+}
+
+QString ForecastHistory::directory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/history");
+}
+
+QString ForecastHistory::pathFor(const QString &locationId)
+{
+    return directory() + QLatin1Char('/') + locationId;
+}
+
+bool ForecastHistory::append(qint64 issued, Kweather::Backend backend, const QList<AbstractHourlyWeatherForecast> &hours, qint64 now)
+{
+    const int count = std::min(hours.size(), 0xffff);
+    if (count == 0)
+        return false;
+
+    QDir().mkpath(QFileInfo(m_path).path());
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadWrite)) {
+        qCWarning(KWEATHER_LOG) << "unable to open" << m_path << file.errorString();
+        return false;
+    }
+    m_runs.clear();
+    m_indexed = true;
+    if (file.size() == 0 || !readFileHeader(file)) {
+        if (file.size() > 0)
+            qCWarning(KWEATHER_LOG) << "discarding forecast history of unknown format" << m_path;
+        file.resize(0);
+        file.seek(0);
+        writeFileHeader(file);
+    } else {
+        dropDamagedTail(file, scanBlocks(file, m_runs), m_path);
+    }
+    // the same run handed over again, e.g. republished once the sunrise data came in
+    if (!m_runs.isEmpty() && m_runs.last().issued == issued && m_runs.last().backend == backend)
+        return false;
+    const qint64 oldest = m_runs.isEmpty() ? issued : m_runs.first().issued;
+
+    QVector<qint64> times(count);
+    QVector<float> columns(COLUMNS * count);
+    BitWriter writer;
+    for (int i = 0; i < count; i++) {
+        const auto &hour = hours.at(i);
+        times[i] = hour.date().toSecsSinceEpoch();
+        columns[i] = hour.temperature();
+        columns[count + i] = hour.pressure();
+        columns[2 * count + i] = hour.humidity();
+        columns[3 * count + i] = hour.windSpeed();
+        columns[4 * count + i] = hour.windDegrees();
+        columns[5 * count + i] = hour.precipitationAmount();
+    }
+    writeTimes(writer, times);
+    for (int i = 0; i < count; i++)
+        writer.write(hours.at(i).interpolated(), 1);
+    for (int column = 0; column < COLUMNS; column++)
+        writeFloats(writer, columns.constData() + column * count, count);
+    const QByteArray payload = writer.finish();
+
+    BlockHeader header = {};
+    header.magic = BLOCK_MAGIC;
+    header.size = payload.size();
+    header.issued = issued;
+    header.firstValid = times.first();
+    header.lastValid = times.last();
+    header.count = count;
+    header.backend = static_cast<quint8>(backend);
+    header.columns = COLUMNS;
+    header.checksum = static_cast<quint32>(ContentHash::of(payload));
+
+    file.seek(file.size());
+    const qint64 offset = file.pos() + sizeof(header);
+    if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header) || file.write(payload) != payload.size()) {
+        qCWarning(KWEATHER_LOG) << "unable to append to" << m_path << file.errorString();
+        return false;
+    }
+    file.close();
+    m_runs.append({issued, header.firstValid, header.lastValid, count, backend, offset, header.size, header.checksum});
+
+    // a day of slack, so that the file is rewritten once a day rather than every time
+    if (oldest < now - m_retention - 86400)
+        compact(now - m_retention);
+    return true;
+}
+
+const QVector<ForecastHistory::Run> &ForecastHistory::runs()
+{
+    if (!m_indexed)
+        readIndex();
+    return m_runs;
+}
+
+bool ForecastHistory::readIndex()
+{
+    m_runs.clear();
+    m_indexed = true;
+    QFile file(m_path);
+    if (!(file.open(QIODevice::ReadWrite) || file.open(QIODevice::ReadOnly)) || !readFileHeader(file))
+        return false;
+    const qint64 end = scanBlocks(file, m_runs);
+    dropDamagedTail(file, end, m_path);
+    return end == file.size();
+}
+
+QVector<ForecastHistory::Point> ForecastHistory::query(qint64 validFrom, qint64 validTo, qint64 issuedFrom, qint64 issuedTo)
+{
+    QVector<Point> points;
+    QFile file(m_path);
+    if (runs().isEmpty() || !file.open(QIODevice::ReadOnly))
+        return points;
+    for (const auto &run : qAsConst(m_runs)) {
+        if (run.issued < issuedFrom || run.issued >= issuedTo || run.lastValid < validFrom || run.firstValid >= validTo)
+            continue;
+        file.seek(run.offset);
+        const QByteArray payload = file.read(run.size);
+        if (static_cast<quint32>(ContentHash::of(payload)) != run.checksum || !decode(run, payload, points, validFrom, validTo))
+            qCWarning(KWEATHER_LOG) << "skipping damaged run of" << m_path << "issued at" << run.issued;
+    }
+    return points;
+}
+
+bool ForecastHistory::decode(const Run &run, const QByteArray &payload, QVector<Point> &points, qint64 validFrom, qint64 validTo) const
+{
+    BitReader reader(payload);
+    QVector<qint64> times;
+    readTimes(reader, run.firstValid, run.count, times);
+    QVector<bool> interpolated(run.count);
+    for (int i = 0; i < run.count; i++)
+        interpolated[i] = reader.read(1);
+    QVector<float> columns(COLUMNS * run.count);
+    for (int column = 0; column < COLUMNS; column++)
+        readFloats(reader, run.count, columns.data() + column * run.count);
+    if (reader.failed())
+        return false;
+
+    const int count = run.count;
+    for (int i = 0; i < count; i++) {
+        if (times[i] < validFrom || times[i] >= validTo)
+            continue;
+        points.append({run.issued,
+                       times[i],
+                       run.backend,
+                       interpolated[i],
+                       columns[i],
+                       columns[count + i],
+                       columns[2 * count + i],
+                       columns[3 * count + i],
+                       columns[4 * count + i],
+                       columns[5 * count + i]});
+    }
+    return true;
+}
+
+bool ForecastHistory::compact(qint64 before)
+{
+    readIndex();
+    QFile in(m_path);
+    QSaveFile out(m_path);
+    if (!in.open(QIODevice::ReadOnly) || !out.open(QIODevice::WriteOnly)) {
+        qCWarning(KWEATHER_LOG) << "unable to compact" << m_path;
+        return false;
+    }
+    writeFileHeader(out);
+    QVector<Run> kept;
+    for (auto run : qAsConst(m_runs)) {
+        if (run.issued < before)
+            continue;
+        in.seek(run.offset - sizeof(BlockHeader));
+        out.write(in.read(sizeof(BlockHeader) + run.size));
+        run.offset = out.pos() - run.size;
+        kept.append(run);
+    }
+    in.close();
+    if (!out.commit()) {
+        qCWarning(KWEATHER_LOG) << "unable to compact" << m_path << out.errorString();
+        return false;
+    }
+    m_runs = kept;
+    return true;
+}
+
+qint64 ForecastHistory::fileSize() const
+{
+    return QFileInfo(m_path).size();
+}
@@ -0,0 +1,91 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_FORECASTHISTORY_H
+#define KWEATHER_FORECASTHISTORY_H
+
+#include "abstracthourlyweatherforecast.h"
+#include "global.h"
+
+#include <QList>
+#include <QString>
+#include <QVector>
+
+#include <limits>
+
+// Every forecast run fetched for one location, appended to
+// $XDG_DATA_HOME/kweather/history/<locationId>, so that what was predicted
+// earlier can be looked at once the time has come.
+//
+// The file is a header and one block per run. A block header holds the issue
+// time, the backend and the range of valid times, followed by the hours packed
+// column by column: valid times as delta of deltas, every float column xor'ed
+// with its previous value and only the bits that changed kept, as in Gorilla.
+// An hourly series costs a bit per timestamp and a couple of bytes per value.
+//
+// Appending and queries scan the block headers into an index first; queries then
+// decode only the blocks in range. A block cut off by a crash is truncated away
+// on that scan, so later appends stay reachable. Runs older than the retention
+// are dropped by rewriting the file, at most once a day.
+class ForecastHistory
+{
+public:
+    struct Run {
+        qint64 issued; // secs since epoch
+        qint64 firstValid, lastValid;
+        int count;
+        Kweather::Backend backend;
+        qint64 offset; // of the payload in the file
+        quint32 size;
+        quint32 checksum;
+    };
+
+    struct Point {
+        qint64 issued;
+        qint64 valid;
+        Kweather::Backend backend;
+        bool interpolated;
+        float temperature, pressure, humidity, windSpeed, windDegrees, precipitation;
+    };
+
+    explicit ForecastHistory(const QString &path);
+
+    static QString directory();
+    static QString pathFor(const QString &locationId);
+
+    void setRetention(qint64 secs)
+    {
+        m_retention = secs;
+    }
+
+    // hours in time order; also drops runs older than the retention before now.
+    // Returns whether the run was stored, not when it is the last one stored already
+    // (same issue time and backend) or the file could not be written.
+    bool append(qint64 issued, Kweather::Backend backend, const QList<AbstractHourlyWeatherForecast> &hours, qint64 now);
+
+    // every stored run, in the order appended
+    const QVector<Run> &runs();
+    // hours valid in [validFrom, validTo) of runs issued in [issuedFrom, issuedTo), by run then time
+    QVector<Point> query(qint64 validFrom,
+                         qint64 validTo,
+                         qint64 issuedFrom = std::numeric_limits<qint64>::min(),
+                         qint64 issuedTo = std::numeric_limits<qint64>::max());
+
+    qint64 fileSize() const;
+
+private:
+    bool readIndex();
+    bool decode(const Run &run, const QByteArray &payload, QVector<Point> &points, qint64 validFrom, qint64 validTo) const;
+    bool compact(qint64 before);
+
+    QString m_path;
+    qint64 m_retention = 30 * 86400;
+    QVector<Run> m_runs;
+    bool m_indexed = false;
+};
+
+#endif // KWEATHER_FORECASTHISTORY_H
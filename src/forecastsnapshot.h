@@ -0,0 +1,146 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef KWEATHER_FORECASTSNAPSHOT_H
+#define KWEATHER_FORECASTSNAPSHOT_H
+
+// Layout of $XDG_RUNTIME_DIR/kweather.snapshot, a read-only table of the current
+// conditions and daily summaries of every location. Local consumers map the file
+// and read it in place, no D-Bus round trip and no json involved.
+//
+// The file is a Table header followed by capacity Location entries, count of them
+// in use. The writer grows the file when there are more locations than entries
+// and never shrinks it; a reader whose mapping is shorter than bytes(capacity)
+// maps the file again. Should growing fail, total tells how many were left out.
+//
+// The process fetching the forecasts is the only writer. It guards every update
+// with a seqlock: the sequence is odd while the table is being written, so a
+// reader takes the sequence, reads, and retries if it was odd or has moved since.
+// Use ForecastSnapshotReader below rather than doing this by hand.
+//
+// All strings are nul terminated UTF-8, truncated to fit; temperatures in celsius.
+// Bump version whenever the layout changes.
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <cstring>
+
+namespace ForecastSnapshot
+{
+static constexpr char MAGIC[8] = {'K', 'W', 'S', 'N', 'A', 'P', '\0', '\0'};
+static constexpr quint32 VERSION = 2;
+static constexpr int MIN_CAPACITY = 32;
+static constexpr int MAX_DAYS = 7;
+
+struct Day {
+    qint64 julianDay;
+    double maxTemp;
+    double minTemp;
+    double precipitation; // mm
+    char weatherIcon[32];
+};
+
+struct Location {
+    char locationId[64];
+    char locationName[96];
+    qint64 lastUpdated; // secs since epoch
+    // current conditions
+    qint64 time; // secs since epoch
+    double temperature;
+    double humidity; // %
+    double pressure; // hPa
+    double windSpeed; // m/s
+    qint32 windDirection; // Kweather::WindDirection
+    qint32 dayCount;
+    char weatherIcon[32];
+    char weatherDescription[64];
+    Day days[MAX_DAYS];
+};
+
+struct Table {
+    char magic[8];
+    quint32 version;
+    quint32 size; // sizeof(Table) of the writer
+    std::atomic<quint32> sequence;
+    qint32 count; // entries in use
+    qint32 capacity; // entries the file has room for
+    qint32 total; // locations of the writer, more than count only if the file could not grow
+    qint64 written; // secs since epoch
+
+    // the entries follow the header
+    const Location *locations() const
+    {
+        return reinterpret_cast<const Location *>(this + 1);
+    }
+    Location *locations()
+    {
+        return reinterpret_cast<Location *>(this + 1);
+    }
+};
+
+// file size of a table with room for capacity locations
+inline qint64 bytes(int capacity)
+{
+    return static_cast<qint64>(sizeof(Table)) + static_cast<qint64>(capacity) * static_cast<qint64>(sizeof(Location));
+}
+
+static_assert(sizeof(std::atomic<quint32>) == sizeof(quint32), "sequence must be a plain 32 bit word in the mapping");
+static_assert(sizeof(Table) % alignof(Location) == 0, "the entries must be aligned right after the header");
+}
+
+// Reads a mapped table consistently. f is called with the table and the number of
+// entries to read, which may be fewer than count while a read races the writer.
+// It may run more than once and must not keep pointers into the table after
+// returning. read() fails once the table outgrew the mapping, see needsRemap().
+class ForecastSnapshotReader
+{
+public:
+    ForecastSnapshotReader(const ForecastSnapshot::Table *table, qint64 mappedSize)
+        : m_table(table)
+        , m_mappedSize(mappedSize)
+    {
+    }
+
+    bool isValid() const
+    {
+        return m_table && m_mappedSize >= static_cast<qint64>(sizeof(ForecastSnapshot::Table))
+            && std::memcmp(m_table->magic, ForecastSnapshot::MAGIC, sizeof(ForecastSnapshot::MAGIC)) == 0 && m_table->version == ForecastSnapshot::VERSION
+            && m_table->size == sizeof(ForecastSnapshot::Table);
+    }
+
+    // the writer grew the file past what was mapped, map it again
+    bool needsRemap() const
+    {
+        return isValid() && ForecastSnapshot::bytes(m_table->capacity) > m_mappedSize;
+    }
+
+    template<typename F> bool read(F f, int attempts = 100) const
+    {
+        if (!isValid())
+            return false;
+        for (int i = 0; i < attempts; i++) {
+            const quint32 begin = m_table->sequence.load(std::memory_order_acquire);
+            if (begin & 1)
+                continue; // writer busy
+            if (needsRemap())
+                return false;
+            const qint64 mapped = (m_mappedSize - static_cast<qint64>(sizeof(ForecastSnapshot::Table))) / static_cast<qint64>(sizeof(ForecastSnapshot::Location));
+            f(*m_table, static_cast<int>(qBound<qint64>(0, m_table->count, mapped)));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_table->sequence.load(std::memory_order_relaxed) == begin)
+                return true;
+        }
+        return false;
+    }
+
+private:
+    const ForecastSnapshot::Table *m_table;
+    qint64 m_mappedSize;
+};
+
+#endif // KWEATHER_FORECASTSNAPSHOT_H
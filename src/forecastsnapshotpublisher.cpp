@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "forecastsnapshotpublisher.h"
+#include "abstractdailyweatherforecast.h"
+#include "abstracthourlyweatherforecast.h"
+#include "kweather_debug.h"
+#include "weatherlocation.h"
+#include "weatherlocationmodel.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QStandardPaths>
+#include <QTimer>
+
+// copy as much of str as fits, without cutting a UTF-8 sequence in half
+template<int N> static void copyString(char (&dest)[N], const QString &str)
+{
+    const QByteArray utf8 = str.toUtf8();
+    int len = qMin(utf8.size(), N - 1);
+    while (len > 0 && len < utf8.size() && (static_cast<uchar>(utf8.at(len)) & 0xC0) == 0x80)
+        len--;
+    std::memcpy(dest, utf8.constData(), len);
+    std::memset(dest + len, 0, N - len);
+}
+
+ForecastSnapshotPublisher::ForecastSnapshotPublisher(WeatherLocationListModel &model, QObject *parent)
+    : QObject(parent)
+    , m_model(model)
+    , m_file(snapshotPath())
+    , m_pending(new QTimer(this))
+{
+    m_pending->setSingleShot(true);
+    m_pending->setInterval(0);
+    connect(m_pending, &QTimer::timeout, this, &ForecastSnapshotPublisher::publish);
+
+    for (auto location : m_model.getList())
+        watch(location);
+    connect(&m_model, &WeatherLocationListModel::locationAdded, this, [this](WeatherLocation *location) {
+        watch(location);
+        m_pending->start();
+    });
+    connect(&m_model, &WeatherLocationListModel::locationRemoved, m_pending, qOverload<>(&QTimer::start));
+}
+
+ForecastSnapshotPublisher::~ForecastSnapshotPublisher()
+{
+    // the file stays, readers can still tell how old it is from lastUpdated
+    if (m_table)
+        m_file.unmap(reinterpret_cast<uchar *>(m_table));
+}
+
+QString ForecastSnapshotPublisher::snapshotPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QStringLiteral("/kweather.snapshot");
+}
+
+bool ForecastSnapshotPublisher::open()
+{
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        qCWarning(KWEATHER_LOG) << "unable to open" << snapshotPath() << m_file.errorString();
+        return false;
+    }
+    m_file.setPermissions(QFileDevice::ReadOwner | QFileDevice::WriteOwner);
+
+    // never smaller than the last writer left it, readers may still map all of it
+    const qint64 entries = (m_file.size() - static_cast<qint64>(sizeof(ForecastSnapshot::Table))) / static_cast<qint64>(sizeof(ForecastSnapshot::Location));
+    if (!map(static_cast<int>(qBound<qint64>(ForecastSnapshot::MIN_CAPACITY, entries, 1 << 20))))
+        return false;
+
+    // keep counting from the last writer so readers that still map the file notice the change,
+    // a writer that died mid-update left the sequence odd
+    const quint32 sequence = m_table->sequence.load(std::memory_order_relaxed);
+    if (sequence & 1)
+        m_table->sequence.store(sequence + 1, std::memory_order_relaxed);
+
+    publish();
+    return true;
+}
+
+bool ForecastSnapshotPublisher::map(int capacity)
+{
+    const qint64 size = ForecastSnapshot::bytes(capacity);
+    if (m_file.size() < size && !m_file.resize(size)) {
+        qCWarning(KWEATHER_LOG) << "unable to grow" << snapshotPath() << m_file.errorString();
+        return false;
+    }
+    auto table = reinterpret_cast<ForecastSnapshot::Table *>(m_file.map(0, size));
+    if (!table) {
+        qCWarning(KWEATHER_LOG) << "unable to map" << snapshotPath() << m_file.errorString();
+        return false;
+    }
+    if (m_table)
+        m_file.unmap(reinterpret_cast<uchar *>(m_table));
+    m_table = table;
+    m_capacity = capacity;
+    return true;
+}
+
+void ForecastSnapshotPublisher::watch(WeatherLocation *location)
+{
+    connect(location, &WeatherLocation::currentForecastChange, m_pending, qOverload<>(&QTimer::start));
+}
+
+void ForecastSnapshotPublisher::fill(ForecastSnapshot::Location &entry, WeatherLocation *location)
+{
+    copyString(entry.locationId, location->locationId());
+    copyString(entry.locationName, location->locationName());
+    entry.lastUpdated = location->lastUpdated().isValid() ? location->lastUpdated().toSecsSinceEpoch() : 0;
+
+    const auto &current = location->currentForecast();
+    entry.time = current.date().isValid() ? current.date().toSecsSinceEpoch() : 0;
+    entry.temperature = current.temperature();
+    entry.humidity = current.humidity();
+    entry.pressure = current.pressure();
+    entry.windSpeed = current.windSpeed();
+    entry.windDirection = static_cast<qint32>(current.windDirection());
+    copyString(entry.weatherIcon, current.weatherIcon());
+    copyString(entry.weatherDescription, current.weatherDescription());
+
+    const auto forecast = location->forecast();
+    const auto &days = forecast.dailyForecasts();
+    entry.dayCount = qMin(days.count(), ForecastSnapshot::MAX_DAYS);
+    for (int i = 0; i < ForecastSnapshot::MAX_DAYS; i++) {
+        auto &day = entry.days[i];
+        if (i >= entry.dayCount) {
+            std::memset(&day, 0, sizeof(day));
+            continue;
+        }
+        day.julianDay = days.at(i).date().toJulianDay();
+        day.maxTemp = days.at(i).maxTemp();
+        day.minTemp = days.at(i).minTemp();
+        day.precipitation = days.at(i).precipitation();
+        copyString(day.weatherIcon, days.at(i).weatherIcon());
+    }
+}
+
+void ForecastSnapshotPublisher::publish()
+{
+    if (!m_table)
+        return;
+
+    const auto &locations = m_model.getList();
+
+    // seqlock, odd while writing
+    const quint32 sequence = m_table->sequence.load(std::memory_order_relaxed);
+    m_table->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // the same file mapped again, the odd sequence carries over
+    if (locations.count() > m_capacity) {
+        int capacity = m_capacity;
+        while (capacity < locations.count())
+            capacity *= 2;
+        if (!map(capacity) && !m_truncated) {
+            qCWarning(KWEATHER_LOG) << "forecast snapshot only holds the first" << m_capacity << "locations";
+            m_truncated = true;
+        }
+    }
+
+    std::memcpy(m_table->magic, ForecastSnapshot::MAGIC, sizeof(ForecastSnapshot::MAGIC));
+    m_table->version = ForecastSnapshot::VERSION;
+    m_table->size = sizeof(ForecastSnapshot::Table);
+    m_table->capacity = m_capacity;
+    m_table->total = locations.count();
+    m_table->count = qMin(locations.count(), m_capacity);
+    m_table->written = QDateTime::currentSecsSinceEpoch();
+    for (int i = 0; i < m_table->count; i++)
+        fill(m_table->locations()[i], locations.at(i));
+    std::memset(m_table->locations() + m_table->count, 0, (m_capacity - m_table->count) * sizeof(ForecastSnapshot::Location));
+
+    m_table->sequence.store(sequence + 2, std::memory_order_release);
+}
@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_FORECASTSNAPSHOTPUBLISHER_H
+#define KWEATHER_FORECASTSNAPSHOTPUBLISHER_H
+
+#include "forecastsnapshot.h"
+
+#include <QFile>
+#include <QObject>
+
+class QTimer;
+class WeatherLocation;
+class WeatherLocationListModel;
+
+// keeps the shared memory snapshot (see forecastsnapshot.h) in sync with the model,
+// only the process that fetches the forecasts should run one
+class ForecastSnapshotPublisher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ForecastSnapshotPublisher(WeatherLocationListModel &model, QObject *parent = nullptr);
+    ~ForecastSnapshotPublisher() override;
+
+    bool open();
+    static QString snapshotPath();
+
+private slots:
+    void publish();
+
+private:
+    void watch(WeatherLocation *location);
+    void fill(ForecastSnapshot::Location &entry, WeatherLocation *location);
+    bool map(int capacity); // grows the file if needed
+
+    WeatherLocationListModel &m_model;
+    QFile m_file;
+    ForecastSnapshot::Table *m_table = nullptr;
+    int m_capacity = 0;
+    bool m_truncated = false; // warned that the file could not grow
+    QTimer *m_pending; // coalesces bursts of changes into one write
+};
+
+#endif // KWEATHER_FORECASTSNAPSHOTPUBLISHER_H
@@ -0,0 +1,251 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "forecastverification.h"
+#include "forecasthistory.h"
+#include "kweather_debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+const int VERSION = 1;
+const int LEAD_HOURS[ForecastVerification::LEAD_BUCKETS] = {3, 6, 12, 24, 48, 72, 120, 168, 240};
+const char *const QUANTITY_NAMES[ForecastVerification::QUANTITIES] = {"temperature", "precipitation", "windSpeed", "pressure"};
+const char *const BACKEND_NAMES[ForecastVerification::BACKENDS] = {"nmi", "owm"};
+
+float value(const ForecastHistory::Point &point, int quantity)
+{
+    switch (quantity) {
+    case ForecastVerification::Temperature:
+        return point.temperature;
+    case ForecastVerification::Precipitation:
+        return point.precipitation;
+    case ForecastVerification::WindSpeed:
+        return point.windSpeed;
+    case ForecastVerification::Pressure:
+    default:
+        return point.pressure;
+    }
+}
+}
+
+void ForecastVerification::Accumulator::add(double error)
+{
+    count++;
+    const double delta = error - mean;
+    mean += delta / count;
+    m2 += delta * (error - mean);
+    meanAbsolute += (std::abs(error) - meanAbsolute) / count;
+}
+
+double ForecastVerification::Accumulator::rmse() const
+{
+    // the mean squared error is the variance plus the bias squared
+    return count == 0 ? 0 : std::sqrt(m2 / count + mean * mean);
+}
+
+double ForecastVerification::Accumulator::standardDeviation() const
+{
+    return count < 2 ? 0 : std::sqrt(m2 / (count - 1));
+}
+
+ForecastVerification::ForecastVerification(const QString &path)
+    : m_path(path)
+{
+    load();
+}
+
+QString ForecastVerification::directory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + QStringLiteral("/verification");
+}
+
+QString ForecastVerification::pathFor(const QString &locationId)
+{
+    return directory() + QLatin1Char('/') + locationId;
+}
+
+int ForecastVerification::leadHours(int bucket)
+{
+    return LEAD_HOURS[bucket];
+}
+
+int ForecastVerification::leadBucket(qint64 leadSecs)
+{
+    const int bucket = std::lower_bound(LEAD_HOURS, LEAD_HOURS + LEAD_BUCKETS, (leadSecs + 3599) / 3600) - LEAD_HOURS;
+    return bucket < LEAD_BUCKETS ? bucket : -1;
+}
+
+double ForecastVerification::meanSquaredError(Kweather::Backend backend, Quantity quantity, int maxLeadHours, quint64 *count) const
+{
+    quint64 n = 0;
+    double sum = 0;
+    for (int bucket = 0; bucket < LEAD_BUCKETS && LEAD_HOURS[bucket] <= maxLeadHours; bucket++) {
+        const Accumulator &stats = m_stats[static_cast<int>(backend)][bucket][quantity];
+        // the squared errors summed are m2 plus count times the mean squared
+        sum += stats.m2 + stats.count * stats.mean * stats.mean;
+        n += stats.count;
+    }
+    if (count)
+        *count = n;
+    return n ? sum / n : 0;
+}
+
+int ForecastVerification::update(ForecastHistory &history, qint64 now)
+{
+    qint64 from = m_verifiedUntil;
+    if (from == 0) {
+        // first time, everything in the history
+        const auto &runs = history.runs();
+        if (runs.isEmpty())
+            return 0;
+        from = std::numeric_limits<qint64>::max();
+        for (const auto &run : runs)
+            from = std::min(from, run.firstValid);
+    }
+    if (from >= now)
+        return 0;
+
+    // runs older than the longest lead cannot have a say about these hours
+    QVector<ForecastHistory::Point> points = history.query(from, now, from - static_cast<qint64>(LEAD_HOURS[LEAD_BUCKETS - 1]) * 3600, now);
+    std::stable_sort(points.begin(), points.end(), [](const ForecastHistory::Point &a, const ForecastHistory::Point &b) {
+        return a.valid < b.valid;
+    });
+
+    int scored = 0;
+    for (int begin = 0, end = 0; begin < points.size(); begin = end) {
+        const qint64 valid = points.at(begin).valid;
+        end = begin;
+        while (end < points.size() && points.at(end).valid == valid)
+            end++;
+
+        // the nowcast, the most recent run issued shortly before the hour, of either backend
+        int truth = -1;
+        for (int i = begin; i < end; i++) {
+            const auto &point = points.at(i);
+            const qint64 lead = valid - point.issued;
+            if (point.interpolated || lead < 0 || lead > NOWCAST_LEAD)
+                continue;
+            if (truth < 0 || point.issued > points.at(truth).issued)
+                truth = i;
+        }
+        if (truth < 0)
+            continue; // no run came in time, the hour cannot be verified anymore
+
+        for (int i = begin; i < end; i++) {
+            const auto &point = points.at(i);
+            if (point.interpolated || valid - point.issued <= NOWCAST_LEAD)
+                continue;
+            const int bucket = leadBucket(valid - point.issued);
+            const int backend = static_cast<int>(point.backend);
+            if (bucket < 0 || backend < 0 || backend >= BACKENDS)
+                continue;
+            for (int quantity = 0; quantity < QUANTITIES; quantity++) {
+                const float forecast = value(point, quantity);
+                const float actual = value(points.at(truth), quantity);
+                if (std::isnan(forecast) || std::isnan(actual))
+                    continue;
+                m_stats[backend][bucket][quantity].add(forecast - actual);
+                scored++;
+            }
+        }
+    }
+
+    m_verifiedUntil = now;
+    save();
+    return scored;
+}
+
+QJsonObject ForecastVerification::toJson() const
+{
+    QJsonObject ret;
+    for (int backend = 0; backend < BACKENDS; backend++) {
+        QJsonObject leads;
+        for (int bucket = 0; bucket < LEAD_BUCKETS; bucket++) {
+            QJsonObject quantities;
+            for (int quantity = 0; quantity < QUANTITIES; quantity++) {
+                const auto &stats = m_stats[backend][bucket][quantity];
+                if (stats.count == 0)
+                    continue;
+                quantities[QLatin1String(QUANTITY_NAMES[quantity])] = QJsonObject{{QStringLiteral("count"), static_cast<double>(stats.count)},
+                                                                                   {QStringLiteral("bias"), stats.mean},
+                                                                                   {QStringLiteral("mae"), stats.meanAbsolute},
+                                                                                   {QStringLiteral("rmse"), stats.rmse()}};
+            }
+            if (!quantities.isEmpty())
+                leads[QString::number(LEAD_HOURS[bucket])] = quantities;
+        }
+        if (!leads.isEmpty())
+            ret[QLatin1String(BACKEND_NAMES[backend])] = leads;
+    }
+    return ret;
+}
+
+void ForecastVerification::load()
+{
+    QFile file(m_path);
+    if (!file.open(QIODevice::ReadOnly))
+        return; // nothing verified yet
+
+    const QJsonObject obj = QJsonDocument::fromJson(file.readAll()).object();
+    const QJsonArray stats = obj[QStringLiteral("stats")].toArray();
+    if (obj[QStringLiteral("version")].toInt() != VERSION || stats.size() != BACKENDS * LEAD_BUCKETS * QUANTITIES * 4) {
+        qCWarning(KWEATHER_LOG) << "discarding forecast verification of unknown format" << m_path;
+        return;
+    }
+    m_verifiedUntil = static_cast<qint64>(obj[QStringLiteral("verifiedUntil")].toDouble());
+    auto it = stats.constBegin();
+    for (auto &backend : m_stats) {
+        for (auto &bucket : backend) {
+            for (auto &accumulator : bucket) {
+                accumulator.count = static_cast<quint64>((*it++).toDouble());
+                accumulator.mean = (*it++).toDouble();
+                accumulator.m2 = (*it++).toDouble();
+                accumulator.meanAbsolute = (*it++).toDouble();
+            }
+        }
+    }
+}
+
+bool ForecastVerification::save() const
+{
+    // backend, lead bucket, quantity, each as count, mean, m2, mean absolute
+    QJsonArray stats;
+    for (const auto &backend : m_stats) {
+        for (const auto &bucket : backend) {
+            for (const auto &accumulator : bucket) {
+                stats.append(static_cast<double>(accumulator.count));
+                stats.append(accumulator.mean);
+                stats.append(accumulator.m2);
+                stats.append(accumulator.meanAbsolute);
+            }
+        }
+    }
+    const QJsonObject obj{{QStringLiteral("version"), VERSION},
+                          {QStringLiteral("verifiedUntil"), static_cast<double>(m_verifiedUntil)},
+                          {QStringLiteral("stats"), stats}};
+
+    QDir().mkpath(QFileInfo(m_path).path());
+    QSaveFile file(m_path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(KWEATHER_LOG) << "unable to write forecast verification to" << m_path << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(obj).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_FORECASTVERIFICATION_H
+#define KWEATHER_FORECASTVERIFICATION_H
+
+#include "global.h"
+
+#include <QJsonObject>
+#include <QString>
+
+class ForecastHistory;
+
+// How far off the runs of each backend were for one location, by lead time.
+//
+// There are no observations, so the nowcast stands in for them: for every hour
+// that has passed, the run issued at most NOWCAST_LEAD before it is taken as
+// what happened, and every earlier run's value for that hour is scored against
+// it. Only the hours backends actually sent count, not interpolated ones.
+//
+// The statistics are running sums (Welford), kept in
+// $XDG_DATA_HOME/kweather/verification/<locationId>; the raw runs stay only as
+// long as the forecast history keeps them.
+class ForecastVerification
+{
+public:
+    enum Quantity { Temperature, Precipitation, WindSpeed, Pressure };
+    static const int QUANTITIES = 4;
+    static const int BACKENDS = 2; // Kweather::Backend, nmi and owm; a blend is made of them
+    static const int LEAD_BUCKETS = 9;
+    static const qint64 NOWCAST_LEAD = 3600;
+
+    struct Accumulator {
+        quint64 count = 0;
+        double mean = 0; // of forecast - nowcast, the bias
+        double m2 = 0; // sum of squared differences from the mean
+        double meanAbsolute = 0;
+
+        void add(double error);
+        double rmse() const;
+        double standardDeviation() const;
+    };
+
+    explicit ForecastVerification(const QString &path);
+
+    static QString directory();
+    static QString pathFor(const QString &locationId);
+    // upper bound of a lead bucket in hours
+    static int leadHours(int bucket);
+    static int leadBucket(qint64 leadSecs);
+
+    // scores the hours in the history that passed since the last call and saves,
+    // returns how many forecast values were scored
+    int update(ForecastHistory &history, qint64 now);
+
+    const Accumulator &stats(Kweather::Backend backend, int bucket, Quantity quantity) const
+    {
+        return m_stats[static_cast<int>(backend)][bucket][quantity];
+    }
+    // of the lead buckets up to maxLeadHours together, count the values it comes from
+    double meanSquaredError(Kweather::Backend backend, Quantity quantity, int maxLeadHours, quint64 *count = nullptr) const;
+    qint64 verifiedUntil() const
+    {
+        return m_verifiedUntil;
+    }
+
+    // {"nmi": {"3": {"temperature": {"count", "bias", "mae", "rmse"}, ...}, ...}, ...}
+    QJsonObject toJson() const;
+
+private:
+    void load();
+    bool save() const;
+
+    QString m_path;
+    qint64 m_verifiedUntil = 0; // hours valid before this are done
+    Accumulator m_stats[BACKENDS][LEAD_BUCKETS][QUANTITIES];
+};
+
+#endif // KWEATHER_FORECASTVERIFICATION_H
@@ -6,6 +6,7 @@
  */
 
 #include "geoiplookup.h"
+#include "kweather_debug.h"
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QXmlStreamReader>
@@ -45,7 +46,7 @@ void GeoIPLookup::process(QNetworkReply *reply)
 {
     reply->deleteLater();
     if (reply->error()) {
-        qDebug() << "Network error:" << reply->errorString();
+        qCDebug(KWEATHER_LOG) << "Network error:" << reply->errorString();
         emit networkError();
         return;
     }
@@ -6,6 +6,7 @@
  */
 
 #include "geotimezone.h"
+#include "kweather_debug.h"
 #include <QJsonDocument>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
@@ -26,7 +27,7 @@ GeoTimeZone::GeoTimeZone(float lat, float lon, QObject *parent)
     query.addQueryItem(QLatin1String("lng"), QString::number(lon));
     query.addQueryItem(QLatin1String("username"), QLatin1String("kweatherdev"));
     url.setQuery(query);
-    qDebug() << url;
+    qCDebug(KWEATHER_LOG) << url;
     QNetworkRequest req(url);
 
     connect(manager, &QNetworkAccessManager::finished, this, &GeoTimeZone::downloadFinished);
@@ -42,7 +43,7 @@ void GeoTimeZone::downloadFinished(QNetworkReply *reply)
 {
     reply->deleteLater();
     if (reply->error()) {
-        qDebug() << "network error";
+        qCDebug(KWEATHER_LOG) << "network error";
         emit networkError();
         return;
     }
@@ -50,7 +51,7 @@ void GeoTimeZone::downloadFinished(QNetworkReply *reply)
     QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
     // if our api calls reached daily limit
     if (doc[QLatin1String("status")][QLatin1String("value")].toInt() == 18) {
-        qWarning() << "api calls reached daily limit";
+        qCWarning(KWEATHER_LOG) << "api calls reached daily limit";
         return;
     }
     tz = doc["timezoneId"].toString();
@@ -13,7 +13,7 @@
 namespace Kweather
 {
 enum class WindDirection { N, NW, W, SW, S, SE, E, NE };
-enum class Backend { NMI, OWM };
+enum class Backend { NMI, OWM, Blend }; // saved as int, append only
 struct ResolvedWeatherDesc {
     QString icon = "weather-none-available", desc = "Unknown";
     ResolvedWeatherDesc() = default;
@@ -26,6 +26,12 @@ struct ResolvedWeatherDesc {
 
 static const QString API_NMI = "Norway Meteorologisk Institutt";
 static const QString API_OWM = "OpenWeatherMap";
+static const QString API_BLEND = "Blended";
+
+inline Backend backendFromInt(int value)
+{
+    return value == static_cast<int>(Backend::OWM) ? Backend::OWM : value == static_cast<int>(Backend::Blend) ? Backend::Blend : Backend::NMI;
+}
 
 }
 #endif // ICONMAP_H
@@ -0,0 +1,43 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "hedgebudget.h"
+#include "metrics.h"
+
+#include <algorithm>
+
+static const double MAX_BALANCE = 3; // hedges saved up for a burst of slow refreshes
+static const quint64 MIN_SAMPLES = 20; // below this the p90 is mostly noise
+static const int DEFAULT_DELAY = 3000;
+static const int MIN_DELAY = 200, MAX_DELAY = 15000;
+
+HedgeBudget &HedgeBudget::instance()
+{
+    static HedgeBudget budget;
+    return budget;
+}
+
+void HedgeBudget::deposit()
+{
+    m_balance = std::min(m_balance + m_ratio, MAX_BALANCE);
+}
+
+bool HedgeBudget::withdraw()
+{
+    if (m_balance < 1)
+        return false;
+    m_balance -= 1;
+    return true;
+}
+
+int HedgeBudget::delay(const QString &backend)
+{
+    const Histogram latency = Metrics::instance().merged(QStringLiteral("kweather_request_latency_microseconds"), backend);
+    if (latency.count() < MIN_SAMPLES)
+        return DEFAULT_DELAY;
+    return std::max(MIN_DELAY, std::min(static_cast<int>(latency.percentile(0.9) / 1000), MAX_DELAY));
+}
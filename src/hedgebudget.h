@@ -0,0 +1,45 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_HEDGEBUDGET_H
+#define KWEATHER_HEDGEBUDGET_H
+
+#include <QString>
+
+// Whether a refresh that is taking long may also be sent to the other backend,
+// shared by every location. Each request sent to a location's own backend earns
+// a share of a hedge (hedgeBudgetPercent), each hedge spends a whole one, and
+// only a few are saved up; so hedging adds at most that share of requests, no
+// matter how slow the backends get.
+class HedgeBudget
+{
+public:
+    static HedgeBudget &instance();
+
+    void setRatio(double ratio)
+    {
+        m_ratio = ratio;
+    }
+    void deposit(); // a request went out to a location's own backend
+    bool withdraw(); // false when there is no hedge left to spend
+    double balance() const
+    {
+        return m_balance;
+    }
+
+    // msecs to wait for backend before hedging, the p90 of its latency once it
+    // has answered often enough
+    static int delay(const QString &backend);
+
+private:
+    HedgeBudget() = default;
+
+    double m_ratio = 0.1;
+    double m_balance = 1;
+};
+
+#endif // KWEATHER_HEDGEBUDGET_H
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "historyworker.h"
+#include "forecasthistory.h"
+#include "forecastverification.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+
+HistoryWorker &HistoryWorker::instance()
+{
+    static HistoryWorker *worker = new HistoryWorker;
+    return *worker;
+}
+
+HistoryWorker::HistoryWorker()
+    : QObject(qApp)
+    , m_context(new QObject)
+{
+    m_thread.setObjectName(QStringLiteral("kweather history"));
+    m_context->moveToThread(&m_thread);
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &HistoryWorker::stop);
+    m_thread.start(QThread::LowPriority);
+}
+
+HistoryWorker::~HistoryWorker()
+{
+    stop();
+}
+
+void HistoryWorker::stop()
+{
+    if (!m_context)
+        return;
+    // queued behind the runs still pending, so they are written first
+    QMetaObject::invokeMethod(m_context, [this] { m_thread.quit(); }, Qt::QueuedConnection);
+    m_thread.wait();
+    delete m_context;
+    m_context = nullptr;
+}
+
+void HistoryWorker::append(const QString &locationId, qint64 issued, Kweather::Backend backend, const QList<AbstractHourlyWeatherForecast> &hours, qint64 retention)
+{
+    if (!m_context)
+        return; // quitting
+    m_pending.fetch_add(1, std::memory_order_relaxed);
+    // the hours are implicitly shared, queueing them copies nothing
+    QMetaObject::invokeMethod(
+        m_context,
+        [this, locationId, issued, backend, hours, retention] {
+            QElapsedTimer timer;
+            timer.start();
+            const qint64 now = QDateTime::currentSecsSinceEpoch();
+            ForecastHistory history(ForecastHistory::pathFor(locationId));
+            history.setRetention(retention);
+            if (history.append(issued, backend, hours, now)) {
+                ForecastVerification verification(ForecastVerification::pathFor(locationId));
+                verification.update(history, now);
+            }
+            m_busyNsecs.fetch_add(timer.nsecsElapsed(), std::memory_order_relaxed);
+            m_pending.fetch_sub(1, std::memory_order_relaxed);
+        },
+        Qt::QueuedConnection);
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_HISTORYWORKER_H
+#define KWEATHER_HISTORYWORKER_H
+
+#include "abstracthourlyweatherforecast.h"
+#include "global.h"
+
+#include <QList>
+#include <QObject>
+#include <QThread>
+
+#include <atomic>
+
+// Appends fetched runs to the ForecastHistory of their location and scores them
+// with ForecastVerification, off the gui thread: scoring decodes every run of the
+// last ten days and rewrites the scores, too much to do on every refresh of every
+// location in line. One thread does all of it in the order queued, so two runs of
+// a location never race for the same file. Readers of the scores only ever see a
+// whole file, see QSaveFile.
+//
+// Created on first use and owned by the application, which waits for the queue
+// to drain when it quits.
+class HistoryWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    static HistoryWorker &instance();
+
+    // returns right away, retention in secs as set in the settings
+    void append(const QString &locationId, qint64 issued, Kweather::Backend backend, const QList<AbstractHourlyWeatherForecast> &hours, qint64 retention);
+
+    int pending() const
+    {
+        return m_pending.load(std::memory_order_relaxed);
+    }
+    qint64 busyMsecs() const // spent on the worker thread so far
+    {
+        return m_busyNsecs.load(std::memory_order_relaxed) / 1000000;
+    }
+
+private:
+    HistoryWorker();
+    ~HistoryWorker() override;
+    void stop();
+
+    QThread m_thread;
+    QObject *m_context; // lives on m_thread, the queued work runs in its event loop; null once stopped
+    std::atomic<int> m_pending{0};
+    std::atomic<qint64> m_busyNsecs{0};
+};
+
+#endif // KWEATHER_HISTORYWORKER_H
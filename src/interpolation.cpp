@@ -0,0 +1,177 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "interpolation.h"
+#include "abstracthourlyweatherforecast.h"
+#include "arena.h"
+#include "derivedquantities.h"
+#include "zoneoffsettable.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace Interpolation
+{
+template<typename T> using Column = std::vector<T, ArenaAllocator<T>>;
+
+void positions(const qint64 *x, int n, qint64 start, qint64 step, int count, Position *out)
+{
+    int segment = 0;
+    for (int k = 0; k < count; k++) {
+        const qint64 t = start + k * step;
+        while (segment < n - 2 && x[segment + 1] <= t)
+            segment++;
+        const float weight = static_cast<float>(t - x[segment]) / (x[segment + 1] - x[segment]);
+        out[k] = {segment, std::min(std::max(weight, 0.0f), 1.0f)};
+    }
+}
+
+void monotoneTangents(const qint64 *x, const float *y, int n, float *tangents)
+{
+    // secants of the two segments around every point
+    float before = (y[1] - y[0]) / (x[1] - x[0]);
+    tangents[0] = before;
+    for (int i = 1; i < n - 1; i++) {
+        const float h0 = x[i] - x[i - 1], h1 = x[i + 1] - x[i];
+        const float after = (y[i + 1] - y[i]) / h1;
+        // flat at extremes, a weighted harmonic mean of the secants otherwise
+        const float w0 = 2 * h1 + h0, w1 = h1 + 2 * h0;
+        tangents[i] = before * after > 0 ? (w0 + w1) / (w0 / before + w1 / after) : 0;
+        before = after;
+    }
+    tangents[n - 1] = before;
+}
+
+void cubic(const qint64 *x, const float *y, const float *tangents, const Position *positions, int count, float *out)
+{
+    for (int k = 0; k < count; k++) {
+        const int i = positions[k].segment;
+        const float u = positions[k].weight, u2 = u * u, u3 = u2 * u;
+        const float h = x[i + 1] - x[i];
+        // cubic hermite basis
+        const float h00 = 2 * u3 - 3 * u2 + 1, h10 = u3 - 2 * u2 + u, h01 = -2 * u3 + 3 * u2, h11 = u3 - u2;
+        out[k] = h00 * y[i] + h10 * h * tangents[i] + h01 * y[i + 1] + h11 * h * tangents[i + 1];
+    }
+}
+
+void linear(const float *y, const Position *positions, int count, float *out)
+{
+    for (int k = 0; k < count; k++) {
+        const int i = positions[k].segment;
+        out[k] = y[i] + positions[k].weight * (y[i + 1] - y[i]);
+    }
+}
+
+void circular(const float *y, const Position *positions, int count, float *out)
+{
+    for (int k = 0; k < count; k++) {
+        const int i = positions[k].segment;
+        const float delta = y[i + 1] - y[i] - 360 * std::floor((y[i + 1] - y[i] + 180) / 360);
+        const float degrees = y[i] + positions[k].weight * delta;
+        out[k] = degrees - 360 * std::floor(degrees / 360);
+    }
+}
+
+void redistribute(const qint64 *x, const float *amount, int n, qint64 start, qint64 step, int count, float *out)
+{
+    std::fill(out, out + count, 0.0f);
+    int k = 0;
+    for (int i = 0; i < n && k < count; i++) {
+        const qint64 from = x[i];
+        const qint64 to = i + 1 < n ? x[i + 1] : x[i] + (x[i] - x[i - 1]);
+        const float rate = amount[i] / (to - from);
+        // cells before this period are done, it may overlap the last one of the previous
+        while (k < count && start + (k + 1) * step <= from)
+            k++;
+        for (int j = k; j < count && start + j * step < to; j++) {
+            const qint64 cellStart = start + j * step;
+            const qint64 overlap = std::min(cellStart + step, to) - std::max(cellStart, from);
+            out[j] += rate * overlap;
+        }
+    }
+}
+
+void resample(QList<AbstractHourlyWeatherForecast> &hours, qint64 step, MonotonicArena &arena, const ZoneOffsetTable *offsets)
+{
+    const int n = hours.size();
+    if (n < 2)
+        return;
+
+    Column<qint64> x{ArenaAllocator<qint64>(arena)};
+    Column<float> temperature{ArenaAllocator<float>(arena)}, pressure{ArenaAllocator<float>(arena)}, humidity{ArenaAllocator<float>(arena)},
+        windSpeed{ArenaAllocator<float>(arena)}, windDegrees{ArenaAllocator<float>(arena)}, fog{ArenaAllocator<float>(arena)},
+        uvIndex{ArenaAllocator<float>(arena)}, precipitation{ArenaAllocator<float>(arena)};
+    for (auto column : {&temperature, &pressure, &humidity, &windSpeed, &windDegrees, &fog, &uvIndex, &precipitation})
+        column->reserve(n);
+    x.reserve(n);
+    for (const auto &hour : hours) {
+        x.push_back(hour.date().toSecsSinceEpoch());
+        temperature.push_back(hour.temperature());
+        pressure.push_back(hour.pressure());
+        humidity.push_back(hour.humidity());
+        windSpeed.push_back(hour.windSpeed());
+        windDegrees.push_back(hour.windDegrees());
+        fog.push_back(hour.fog());
+        uvIndex.push_back(hour.uvIndex());
+        precipitation.push_back(hour.precipitationAmount());
+    }
+
+    // the grid ends with the period of the last hour, so no precipitation is lost
+    const qint64 start = (x.front() + step - 1) / step * step;
+    const qint64 end = x[n - 1] + (x[n - 1] - x[n - 2]);
+    if (end <= start)
+        return;
+    const int count = static_cast<int>((end - start + step - 1) / step);
+
+    Column<Position> grid{ArenaAllocator<Position>(arena)};
+    grid.resize(count);
+    positions(x.data(), n, start, step, count, grid.data());
+
+    // one column after the other, in a single block
+    Column<float> resampled{ArenaAllocator<float>(arena)};
+    resampled.resize(static_cast<std::size_t>(8) * count);
+    float *column[8];
+    for (int c = 0; c < 8; c++)
+        column[c] = resampled.data() + c * count;
+    Column<float> tangents{ArenaAllocator<float>(arena)};
+    tangents.resize(n);
+    monotoneTangents(x.data(), temperature.data(), n, tangents.data());
+    cubic(x.data(), temperature.data(), tangents.data(), grid.data(), count, column[0]);
+    monotoneTangents(x.data(), pressure.data(), n, tangents.data());
+    cubic(x.data(), pressure.data(), tangents.data(), grid.data(), count, column[1]);
+    linear(humidity.data(), grid.data(), count, column[2]);
+    linear(windSpeed.data(), grid.data(), count, column[3]);
+    circular(windDegrees.data(), grid.data(), count, column[4]);
+    linear(fog.data(), grid.data(), count, column[5]);
+    linear(uvIndex.data(), grid.data(), count, column[6]);
+    redistribute(x.data(), precipitation.data(), n, start, step, count, column[7]);
+
+    QList<AbstractHourlyWeatherForecast> result;
+    result.reserve(count);
+    for (int k = 0; k < count; k++) {
+        const qint64 t = start + k * step;
+        const Position &position = grid[k];
+        // on a source hour, or the hour whose period it falls in
+        const int source = position.weight >= 1 && t >= x[position.segment + 1] ? position.segment + 1 : position.segment;
+        AbstractHourlyWeatherForecast hour = hours.at(source);
+        hour.setInterpolated(t != x[source]);
+        hour.setDate(offsets && offsets->isValid() ? offsets->toDateTime(t) : QDateTime::fromSecsSinceEpoch(t, Qt::OffsetFromUTC, hour.date().offsetFromUtc()));
+        hour.setTemperature(column[0][k]);
+        hour.setPressure(column[1][k]);
+        hour.setHumidity(column[2][k]);
+        hour.setWindSpeed(column[3][k]);
+        hour.setWindDegrees(column[4][k]);
+        hour.setWindDirection(DerivedQuantities::windDirection(hour.windDegrees()));
+        hour.setFog(column[5][k]);
+        hour.setUvIndex(column[6][k]);
+        hour.setPrecipitationAmount(column[7][k]);
+        result.append(hour);
+    }
+    hours = result;
+}
+}
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_INTERPOLATION_H
+#define KWEATHER_INTERPOLATION_H
+
+#include <QList>
+
+class AbstractHourlyWeatherForecast;
+class MonotonicArena;
+class ZoneOffsetTable;
+
+// Resampling of forecast series onto a uniform grid. Backends step 1, 3 or 6
+// hours apart, and met.no changes step within one document. Temperature and
+// pressure follow a monotone cubic, which never overshoots the source points;
+// precipitation is redistributed by overlap, so amounts over any stretch of the
+// grid add up to what the backend gave for it. The grid positions are worked out
+// once, then every column is one loop over them.
+namespace Interpolation
+{
+// a grid point lies weight of the way from source point segment to segment + 1
+struct Position {
+    int segment;
+    float weight;
+};
+
+// source times x ascending, grid from start every step for count points; weights
+// are clamped to [0, 1], points beyond the last source point take its values
+void positions(const qint64 *x, int n, qint64 start, qint64 step, int count, Position *out);
+
+// tangents, per second, of a monotone cubic through (x, y), Fritsch-Butland
+void monotoneTangents(const qint64 *x, const float *y, int n, float *tangents);
+void cubic(const qint64 *x, const float *y, const float *tangents, const Position *positions, int count, float *out);
+void linear(const float *y, const Position *positions, int count, float *out);
+// degrees, along the shorter way round
+void circular(const float *y, const Position *positions, int count, float *out);
+
+// amount[i] fell in [x[i], x[i + 1]), the last one in a period as long as the one
+// before; out[k] is what of it falls in [start + k * step, start + (k + 1) * step)
+void redistribute(const qint64 *x, const float *amount, int n, qint64 start, qint64 step, int count, float *out);
+
+// resamples hours, in time order, every step seconds from the first multiple of
+// step at or after the first hour until the period of the last hour ends. Points
+// that fall on a source hour keep it, the others are marked interpolated and take
+// the condition of the hour before them. Dates come from offsets where given, the
+// offset of the hour before otherwise.
+void resample(QList<AbstractHourlyWeatherForecast> &hours, qint64 step, MonotonicArena &arena, const ZoneOffsetTable *offsets = nullptr);
+}
+
+#endif // KWEATHER_INTERPOLATION_H
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "jsondecoder.h"
+
+#include <QtGlobal>
+
+namespace JsonDecoder
+{
+static bool &simdEnabled()
+{
+    static bool enabled = simdAvailable() && qgetenv("KWEATHER_JSON_DECODER") != "qt";
+    return enabled;
+}
+
+bool simdAvailable()
+{
+#ifdef HAVE_SIMDJSON
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool useSimd()
+{
+    return simdEnabled();
+}
+
+void setUseSimd(bool use)
+{
+    simdEnabled() = use && simdAvailable();
+}
+
+#ifdef HAVE_SIMDJSON
+simdjson::dom::parser &parser()
+{
+    static thread_local simdjson::dom::parser parser;
+    return parser;
+}
+#endif
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_JSONDECODER_H
+#define KWEATHER_JSONDECODER_H
+
+#ifdef HAVE_SIMDJSON
+#include <simdjson.h>
+#endif
+
+// Chooses how the forecast documents are decoded. When built with simdjson the
+// backends read them with its parser, which does not build a QJsonValue per number;
+// otherwise, or with KWEATHER_JSON_DECODER=qt, they go through QJsonDocument.
+namespace JsonDecoder
+{
+bool simdAvailable();
+bool useSimd();
+void setUseSimd(bool use); // for comparing both paths, ignored without simdjson
+
+#ifdef HAVE_SIMDJSON
+// one per thread, it keeps its buffers between documents
+simdjson::dom::parser &parser();
+#endif
+}
+
+#endif // KWEATHER_JSONDECODER_H
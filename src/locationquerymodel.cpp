@@ -6,6 +6,7 @@
  */
 
 #include "locationquerymodel.h"
+#include "kweather_debug.h"
 #include <QTimer>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -87,7 +88,7 @@ void LocationQueryModel::setQuery()
     urlQuery.addQueryItem("maxRows", "50");
     urlQuery.addQueryItem("username", "kweatherdev");
     url.setQuery(urlQuery);
-    qDebug() << url.toString();
+    qCDebug(KWEATHER_LOG) << url.toString();
     networkAccessManager->get(QNetworkRequest(url));
     connect(networkAccessManager, &QNetworkAccessManager::finished, this, &LocationQueryModel::handleQueryResults);
 }
@@ -106,7 +107,7 @@ void LocationQueryModel::handleQueryResults(QNetworkReply *reply)
     loading_ = false;
     if (reply->error()) {
         networkError_ = true;
-        qDebug() << "Network error:" << reply->error();
+        qCDebug(KWEATHER_LOG) << "Network error:" << reply->error();
         emit propertyChanged();
         return;
     }
@@ -124,7 +125,7 @@ void LocationQueryModel::handleQueryResults(QNetworkReply *reply)
     }
     // if our api calls reached daily limit
     if (root[QLatin1String("status")].toObject()[QLatin1String("value")].toInt() == 18) {
-        qWarning() << "api calls reached daily limit";
+        qCWarning(KWEATHER_LOG) << "api calls reached daily limit";
         networkError_ = true;
         emit propertyChanged();
         return;
@@ -6,12 +6,19 @@
  */
 
 #include <QApplication>
+#include <QCommandLineParser>
 #include <QMetaObject>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QQmlEngine>
+#include <QQuickWindow>
+#include <QTextStream>
 #include <QUrl>
 #include <QtQml>
+#ifndef Q_OS_ANDROID
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#endif
 
 #include <KAboutData>
 #include <KConfigCore/KConfig>
@@ -20,32 +27,130 @@
 
 #include "abstractdailyweatherforecast.h"
 #include "abstracthourlyweatherforecast.h"
+#include "forecastsnapshotpublisher.h"
+#include "kweather_debug.h"
 #include "kweathersettings.h"
 #include "locationquerymodel.h"
+#include "metrics.h"
+#include "startupprofiler.h"
+#include "tracing.h"
+#include "weatherchartmodel.h"
 #include "weatherdaymodel.h"
 #include "weatherforecastmanager.h"
 #include "weatherhourmodel.h"
 #include "weatherlocation.h"
 #include "weatherlocationmodel.h"
+#include "weatherqueryserver.h"
+#ifndef Q_OS_ANDROID
+#include "dbusadaptors.h"
+#endif
 
 class AbstractHourlyWeatherForecast;
 class AbstractDailyWeatherForecast;
 
+// shared by the gui and the daemon, both have to agree on config and cache locations
+// returns whether the startup profile was asked for
+static bool setupApplication(QCoreApplication &app)
+{
+    KLocalizedString::setApplicationDomain("kweather");
+    KAboutData aboutData("kweather", i18n("Weather"), "0.3", i18n("Weather application in Kirigami"), KAboutLicense::GPL, i18n("© 2020 KDE Community"));
+    KAboutData::setApplicationData(aboutData);
+
+    QCommandLineParser parser;
+    parser.addOption(QCommandLineOption(QStringLiteral("daemon"), i18n("Keep forecasts of all locations up to date without showing a window")));
+    parser.addOption(QCommandLineOption(QStringLiteral("startup-profile"), i18n("Print how long each startup phase took")));
+    aboutData.setupCommandLine(&parser);
+    parser.process(app);
+    aboutData.processCommandLine(&parser);
+    return parser.isSet(QStringLiteral("startup-profile"));
+}
+
+static void finishStartupProfile(bool print)
+{
+    if (StartupProfiler::isFinished())
+        return;
+    StartupProfiler::finish();
+    if (print)
+        QTextStream(stderr) << StartupProfiler::report();
+}
+
+// headless mode: refresh and cache forecasts, answer queries over D-Bus and a local socket
+static int runDaemon(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    const bool startupProfile = setupApplication(app);
+    StartupProfiler::mark("application created");
+
+    auto *weatherLocationListModel = new WeatherLocationListModel(&app);
+    StartupProfiler::mark("locations loaded");
+    WeatherForecastManager::instance(*weatherLocationListModel);
+    StartupProfiler::mark("cache read");
+
+#ifndef Q_OS_ANDROID
+    new LocationModelAdaptor(weatherLocationListModel);
+    new MetricsAdaptor(&Metrics::instance());
+    if (!QDBusConnection::sessionBus().registerService(KWEATHER_DBUS_SERVICE)) {
+        qCWarning(KWEATHER_LOG) << "kweather is already running on this session bus";
+        return 1;
+    }
+#endif
+
+    WeatherQueryServer queryServer(*weatherLocationListModel);
+    queryServer.listen();
+    ForecastSnapshotPublisher snapshotPublisher(*weatherLocationListModel);
+    snapshotPublisher.open();
+    StartupProfiler::mark("ready");
+    finishStartupProfile(startupProfile);
+
+    return app.exec();
+}
+
 Q_DECL_EXPORT int main(int argc, char *argv[])
 {
+    StartupProfiler::mark("main");
+
+    // decide before creating the application, the daemon must not need a display
+    for (int i = 1; i < argc; i++) {
+        if (qstrcmp(argv[i], "--daemon") == 0)
+            return runDaemon(argc, argv);
+    }
+
     QGuiApplication::setAttribute(Qt::AA_EnableHighDpiScaling);
     QApplication app(argc, argv);
     QQmlApplicationEngine engine;
 
-    KLocalizedString::setApplicationDomain("kweather");
+    const bool startupProfile = setupApplication(app);
+    StartupProfiler::mark("application created");
     engine.rootContext()->setContextObject(new KLocalizedContext(&engine));
-    KAboutData aboutData("kweather", i18n("Weather"), "0.3", i18n("Weather application in Kirigami"), KAboutLicense::GPL, i18n("© 2020 KDE Community"));
-    KAboutData::setApplicationData(aboutData);
+
+    // if the daemon is running it keeps the forecasts up to date, we only read its snapshots
+    bool clientMode = false;
+#ifndef Q_OS_ANDROID
+    clientMode = QDBusConnection::sessionBus().interface() && QDBusConnection::sessionBus().interface()->isServiceRegistered(KWEATHER_DBUS_SERVICE);
+#endif
 
     // initialize models in context
     auto *weatherLocationListModel = new WeatherLocationListModel();
     auto *locationQueryModel = new LocationQueryModel();
-    WeatherForecastManager::instance(*weatherLocationListModel);
+    StartupProfiler::mark("locations loaded");
+    // cold start: only the first location is loaded and fetched before the first frame
+    auto &manager = WeatherForecastManager::instance(*weatherLocationListModel, clientMode, true);
+    StartupProfiler::mark("cache read");
+
+    // what the daemon serves, once we fetch by ourselves
+    auto registerServices = [weatherLocationListModel, &app] {
+#ifndef Q_OS_ANDROID
+        new LocationModelAdaptor(weatherLocationListModel);
+        new MetricsAdaptor(&Metrics::instance());
+        QDBusConnection::sessionBus().registerService(KWEATHER_DBUS_SERVICE);
+#endif
+        (new ForecastSnapshotPublisher(*weatherLocationListModel, &app))->open();
+    };
+    if (clientMode)
+        QObject::connect(&manager, &WeatherForecastManager::clientModeEnded, &app, registerServices);
+    else
+        registerServices();
+    StartupProfiler::mark("services registered");
 
     KWeatherSettings settings;
 
@@ -61,6 +166,7 @@ Q_DECL_EXPORT int main(int argc, char *argv[])
     qmlRegisterType<WeatherHour>("kweather", 1, 0, "WeatherHour");
     qmlRegisterType<WeatherHourListModel>("kweather", 1, 0, "WeatherHourListModel");
     qmlRegisterType<WeatherDayListModel>("kweather", 1, 0, "WeatherDayListModel");
+    qmlRegisterType<WeatherChartModel>("kweather", 1, 0, "WeatherChartModel");
 
     // load setup wizard if first launch
     engine.load(QUrl(QStringLiteral("qrc:///qml/main.qml")));
@@ -68,6 +174,26 @@ Q_DECL_EXPORT int main(int argc, char *argv[])
     if (engine.rootObjects().isEmpty()) {
         return -1;
     }
+    StartupProfiler::mark("qml loaded");
+
+    // the deferred locations are loaded and fetched once the first frame is out
+    auto finishStartup = [weatherLocationListModel, startupProfile] {
+        if (StartupProfiler::isFinished())
+            return;
+        StartupProfiler::mark("first frame");
+        finishStartupProfile(startupProfile);
+        WeatherForecastManager::instance(*weatherLocationListModel).finishStartup();
+    };
+    if (auto window = qobject_cast<QQuickWindow *>(engine.rootObjects().first()))
+        QObject::connect(window, &QQuickWindow::frameSwapped, &app, finishStartup, Qt::QueuedConnection);
+    else
+        finishStartup();
+
+    // render end of the refresh path in the trace
+    if (Tracing::isEnabled()) {
+        if (auto window = qobject_cast<QQuickWindow *>(engine.rootObjects().first()))
+            QObject::connect(window, &QQuickWindow::frameSwapped, [] { Tracing::instant("frame swapped"); });
+    }
 
     return app.exec();
 }
@@ -0,0 +1,242 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "metrics.h"
+#include "kweather_debug.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QNetworkReply>
+#include <QSaveFile>
+#include <QTimer>
+
+#include <cmath>
+#include <memory>
+
+static constexpr int SUB_BUCKET_BITS = 5;
+static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+static constexpr int BUCKETS = (63 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+/* ~~~ Histogram ~~~ */
+
+Histogram::Histogram()
+    : m_buckets(BUCKETS, 0)
+{
+}
+
+int Histogram::bucketIndex(qint64 value)
+{
+    if (value < SUB_BUCKETS)
+        return std::max<qint64>(value, 0);
+    const int exp = 63 - qCountLeadingZeroBits(static_cast<quint64>(value));
+    const int sub = (value >> (exp - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exp - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+qint64 Histogram::bucketLowerBound(int index)
+{
+    if (index < SUB_BUCKETS)
+        return index;
+    const int exp = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    return static_cast<qint64>(SUB_BUCKETS + index % SUB_BUCKETS) << (exp - SUB_BUCKET_BITS);
+}
+
+void Histogram::record(qint64 value)
+{
+    value = std::max<qint64>(value, 0);
+    m_buckets[bucketIndex(value)]++;
+    m_min = m_count ? std::min(m_min, value) : value;
+    m_max = std::max(m_max, value);
+    m_sum += value;
+    m_count++;
+}
+
+void Histogram::merge(const Histogram &other)
+{
+    if (!other.m_count)
+        return;
+    for (int i = 0; i < m_buckets.size(); i++)
+        m_buckets[i] += other.m_buckets.at(i);
+    m_min = m_count ? std::min(m_min, other.m_min) : other.m_min;
+    m_max = std::max(m_max, other.m_max);
+    m_sum += other.m_sum;
+    m_count += other.m_count;
+}
+
+qint64 Histogram::percentile(double q) const
+{
+    if (!m_count)
+        return 0;
+    const quint64 rank = std::max<quint64>(1, std::ceil(q * m_count));
+    quint64 seen = 0;
+    for (int i = 0; i < m_buckets.size(); i++) {
+        seen += m_buckets.at(i);
+        if (seen >= rank) {
+            // report the bucket's upper edge, but never more than was actually seen
+            return i + 1 < m_buckets.size() ? std::min(bucketLowerBound(i + 1) - 1, m_max) : m_max;
+        }
+    }
+    return m_max;
+}
+
+quint64 Histogram::countBelow(qint64 bound) const
+{
+    quint64 ret = 0;
+    for (int i = 0; i < m_buckets.size() && bucketLowerBound(i) < bound; i++)
+        ret += m_buckets.at(i);
+    return ret;
+}
+
+/* ~~~ Metrics ~~~ */
+
+Metrics::Metrics()
+    : m_textFile(qEnvironmentVariable("KWEATHER_METRICS_FILE"))
+{
+    if (!m_textFile.isEmpty()) {
+        auto timer = new QTimer(qApp);
+        connect(timer, &QTimer::timeout, this, &Metrics::writeTextFile);
+        connect(qApp, &QCoreApplication::aboutToQuit, this, &Metrics::writeTextFile);
+        timer->start(60 * 1000);
+    }
+}
+
+Metrics &Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+void Metrics::increment(const QString &name, const QString &backend, const QString &host, qint64 by)
+{
+    m_counters[{name, backend, host}] += by;
+}
+
+void Metrics::setGauge(const QString &name, double value)
+{
+    m_gauges[name] = value;
+}
+
+void Metrics::record(const QString &name, const QString &backend, const QString &host, qint64 value)
+{
+    m_histograms[{name, backend, host}].record(value);
+}
+
+const Histogram *Metrics::histogram(const QString &name, const QString &backend, const QString &host) const
+{
+    auto it = m_histograms.constFind({name, backend, host});
+    return it == m_histograms.constEnd() ? nullptr : &it.value();
+}
+
+Histogram Metrics::merged(const QString &name, const QString &backend) const
+{
+    Histogram ret;
+    for (auto it = m_histograms.lowerBound({name, backend, QString()}); it != m_histograms.constEnd() && it.key().name == name && it.key().backend == backend; ++it)
+        ret.merge(it.value());
+    return ret;
+}
+
+void Metrics::trackReply(QNetworkReply *reply, const QString &backend)
+{
+    const QString host = reply->url().host();
+    increment(QStringLiteral("kweather_requests_total"), backend, host);
+
+    auto timer = std::make_shared<QElapsedTimer>();
+    timer->start();
+    connect(reply, &QNetworkReply::finished, this, [this, reply, backend, host, timer] {
+        if (reply->error() == QNetworkReply::OperationCanceledError) {
+            increment(QStringLiteral("kweather_requests_cancelled_total"), backend, host);
+            return;
+        }
+        if (reply->error() != QNetworkReply::NoError) {
+            increment(QStringLiteral("kweather_request_errors_total"), backend, host);
+            return;
+        }
+        record(QStringLiteral("kweather_request_latency_microseconds"), backend, host, timer->nsecsElapsed() / 1000);
+        // the body has not been read yet when finished is delivered
+        record(QStringLiteral("kweather_response_bytes"), backend, host, reply->bytesAvailable());
+    });
+}
+
+QByteArray Metrics::labels(const Key &key, const QByteArray &extra)
+{
+    QByteArrayList ret;
+    if (!key.backend.isEmpty())
+        ret << "backend=\"" + key.backend.toUtf8() + '"';
+    if (!key.host.isEmpty())
+        ret << "host=\"" + key.host.toUtf8() + '"';
+    if (!extra.isEmpty())
+        ret << extra;
+    return ret.isEmpty() ? QByteArray() : '{' + ret.join(',') + '}';
+}
+
+QByteArray Metrics::toPrometheus() const
+{
+    QByteArray ret;
+    QString lastName;
+    for (auto it = m_counters.constBegin(); it != m_counters.constEnd(); ++it) {
+        if (it.key().name != lastName)
+            ret += "# TYPE " + it.key().name.toUtf8() + " counter\n";
+        lastName = it.key().name;
+        ret += it.key().name.toUtf8() + labels(it.key()) + ' ' + QByteArray::number(it.value()) + '\n';
+    }
+    for (auto it = m_gauges.constBegin(); it != m_gauges.constEnd(); ++it)
+        ret += "# TYPE " + it.key().toUtf8() + " gauge\n" + it.key().toUtf8() + ' ' + QByteArray::number(it.value()) + '\n';
+
+    for (auto it = m_histograms.constBegin(); it != m_histograms.constEnd(); ++it) {
+        const QByteArray name = it.key().name.toUtf8();
+        const Histogram &h = it.value();
+        if (it.key().name != lastName)
+            ret += "# TYPE " + name + " histogram\n";
+        lastName = it.key().name;
+        // cumulative buckets at powers of two up to the largest value seen
+        for (qint64 bound = 1; bound <= h.max(); bound <<= 1)
+            ret += name + "_bucket" + labels(it.key(), "le=\"" + QByteArray::number(bound - 1) + '"') + ' ' + QByteArray::number(h.countBelow(bound)) + '\n';
+        ret += name + "_bucket" + labels(it.key(), "le=\"+Inf\"") + ' ' + QByteArray::number(h.count()) + '\n';
+        ret += name + "_sum" + labels(it.key()) + ' ' + QByteArray::number(h.sum()) + '\n';
+        ret += name + "_count" + labels(it.key()) + ' ' + QByteArray::number(h.count()) + '\n';
+    }
+    return ret;
+}
+
+QJsonObject Metrics::toJson() const
+{
+    QJsonArray counters, histograms;
+    for (auto it = m_counters.constBegin(); it != m_counters.constEnd(); ++it)
+        counters.append(QJsonObject{{"name", it.key().name}, {"backend", it.key().backend}, {"host", it.key().host}, {"value", it.value()}});
+    for (auto it = m_histograms.constBegin(); it != m_histograms.constEnd(); ++it) {
+        const Histogram &h = it.value();
+        histograms.append(QJsonObject{{"name", it.key().name},
+                                      {"backend", it.key().backend},
+                                      {"host", it.key().host},
+                                      {"count", static_cast<qint64>(h.count())},
+                                      {"min", h.min()},
+                                      {"p50", h.percentile(0.5)},
+                                      {"p90", h.percentile(0.9)},
+                                      {"p99", h.percentile(0.99)},
+                                      {"max", h.max()}});
+    }
+    QJsonObject gauges;
+    for (auto it = m_gauges.constBegin(); it != m_gauges.constEnd(); ++it)
+        gauges[it.key()] = it.value();
+    return QJsonObject{{"counters", counters}, {"gauges", gauges}, {"histograms", histograms}};
+}
+
+void Metrics::writeTextFile()
+{
+    if (m_textFile.isEmpty())
+        return;
+    // written whole or not at all, scrapers never see half a file
+    QSaveFile file(m_textFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(KWEATHER_LOG) << "unable to write metrics to" << m_textFile << file.errorString();
+        return;
+    }
+    file.write(toPrometheus());
+    file.commit();
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_METRICS_H
+#define KWEATHER_METRICS_H
+
+#include <QMap>
+#include <QObject>
+#include <QVector>
+
+#include <tuple>
+
+class QJsonObject;
+class QNetworkReply;
+
+// log-linear histogram in the spirit of HdrHistogram: exact below 32, above that
+// every power of two is split into 32 buckets, so any value is off by at most ~3%
+class Histogram
+{
+public:
+    Histogram();
+
+    void record(qint64 value);
+    void merge(const Histogram &other);
+
+    quint64 count() const
+    {
+        return m_count;
+    }
+    qint64 sum() const
+    {
+        return m_sum;
+    }
+    qint64 min() const
+    {
+        return m_count ? m_min : 0;
+    }
+    qint64 max() const
+    {
+        return m_max;
+    }
+    qint64 percentile(double q) const; // q in [0, 1]
+    quint64 countBelow(qint64 bound) const; // values < bound, bound a power of two
+
+    static int bucketIndex(qint64 value);
+    static qint64 bucketLowerBound(int index);
+
+private:
+    QVector<quint64> m_buckets;
+    quint64 m_count = 0;
+    qint64 m_sum = 0;
+    qint64 m_min = 0;
+    qint64 m_max = 0;
+};
+
+/*
+ * Process wide counters, gauges and histograms, labelled with backend and host.
+ * Exported as Prometheus text (D-Bus /metrics, $KWEATHER_METRICS_FILE) and as json
+ * (socket command 'metrics'). Only touched from the main thread.
+ *
+ * Metric names used by kweather:
+ *   kweather_requests_total, kweather_request_errors_total, kweather_request_retries_total
+ *   kweather_cache_hits_total, kweather_cache_misses_total   (the 300 s freshness check in update())
+ *   kweather_request_latency_microseconds, kweather_response_bytes, kweather_parse_microseconds
+ *   kweather_requests_cancelled_total, kweather_hedged_requests_total, kweather_hedges_won_total,
+ *   kweather_hedges_denied_total   (see HedgeBudget)
+ *   kweather_backend_outages_total, kweather_backend_recoveries_total   (see BackendHealthTracker)
+ *   kweather_backend_failovers_total   (label: the backend locations moved to)
+ *   kweather_locations
+ */
+class Metrics : public QObject
+{
+    Q_OBJECT
+
+public:
+    static Metrics &instance();
+
+    void increment(const QString &name, const QString &backend, const QString &host = QString(), qint64 by = 1);
+    void setGauge(const QString &name, double value);
+    void record(const QString &name, const QString &backend, const QString &host, qint64 value);
+
+    // nullptr if nothing has been recorded yet
+    const Histogram *histogram(const QString &name, const QString &backend, const QString &host = QString()) const;
+    // of every host together
+    Histogram merged(const QString &name, const QString &backend) const;
+
+    // request count, errors, latency and bytes of a network request
+    void trackReply(QNetworkReply *reply, const QString &backend);
+
+    QByteArray toPrometheus() const;
+    QJsonObject toJson() const;
+
+    void writeTextFile(); // to $KWEATHER_METRICS_FILE if set
+
+private:
+    Metrics();
+
+    struct Key {
+        QString name, backend, host;
+        bool operator<(const Key &other) const
+        {
+            return std::tie(name, backend, host) < std::tie(other.name, other.backend, other.host);
+        }
+    };
+    static QByteArray labels(const Key &key, const QByteArray &extra = QByteArray());
+
+    QMap<Key, qint64> m_counters;
+    QMap<QString, double> m_gauges;
+    QMap<Key, Histogram> m_histograms;
+    QString m_textFile;
+};
+
+#endif // KWEATHER_METRICS_H
@@ -7,6 +7,11 @@
 
 #include "nmisunriseapi.h"
 #include "abstractsunrise.h"
+#include "abstractweatherapi.h"
+#include "kweather_debug.h"
+#include "metrics.h"
+#include "timestamp.h"
+#include "tracing.h"
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
@@ -14,20 +19,12 @@
 #include <QNetworkReply>
 #include <QUrlQuery>
 #include <QtMath>
-#include <QTimeZone>
 
 NMISunriseAPI::NMISunriseAPI(float latitude, float longitude, int offset_secs)
     : latitude_(latitude)
     , longitude_(longitude)
     , offset_(offset_secs)
 {
-    manager = new QNetworkAccessManager(this);
-
-    manager->setRedirectPolicy(QNetworkRequest::NoLessSafeRedirectPolicy);
-    manager->setStrictTransportSecurityEnabled(true);
-    manager->enableStrictTransportSecurityStore(true);
-
-    connect(manager, &QNetworkAccessManager::finished, this, &NMISunriseAPI::process);
 }
 
 void NMISunriseAPI::update()
@@ -59,53 +56,66 @@ void NMISunriseAPI::update()
     query.addQueryItem(QLatin1String("offset"), offset);
 
     url.setQuery(query);
-    qDebug() << url;
+    AbstractWeatherAPI::applyServerOverride(url);
+    qCDebug(KWEATHER_LOG) << url;
     QNetworkRequest req(url);
-    manager->get(req);
+    auto reply = AbstractWeatherAPI::networkAccessManager()->get(req);
+    Metrics::instance().trackReply(reply, QStringLiteral("sunrise"));
+    Tracing::traceReply(reply, "fetch sunrise");
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() { process(reply); });
 }
 
 void NMISunriseAPI::process(QNetworkReply *reply)
 {
     reply->deleteLater();
     if (reply->error()) {
-        qDebug() << "nmisunriseapi network error:" << reply->errorString();
+        qCDebug(KWEATHER_LOG) << "nmisunriseapi network error:" << reply->errorString();
         emit networkError();
         return;
     }
-    
-    QTimeZone tz = QTimeZone(offset_);
 
-    QJsonDocument doc = QJsonDocument::fromJson(reply->readAll());
+    processData(reply->readAll());
+}
+
+void NMISunriseAPI::processData(const QByteArray &data)
+{
+    TraceSpan span("parse sunrise");
+
+    // times are wall clock at offset_, the offset we asked for
+    const int offset = offset_;
+    auto time = [offset](const QJsonObject &event) -> QDateTime {
+        qint64 wallSecs;
+        Timestamp::Suffix suffix;
+        int suffixOffset;
+        if (!Timestamp::decode(event[QLatin1String("time")].toString(), wallSecs, suffix, suffixOffset))
+            return QDateTime();
+        return QDateTime::fromSecsSinceEpoch(wallSecs - offset, Qt::OffsetFromUTC, offset);
+    };
+
+    QJsonDocument doc = QJsonDocument::fromJson(data);
     QJsonArray array = doc["location"].toObject()["time"].toArray();
     for (int i = 0; i <= array.count() - 2; i++) // we don't want last one
     {
+        const QJsonObject day = array.at(i).toObject();
+        const QJsonObject solarMidnight = day[QLatin1String("solarmidnight")].toObject(), solarNoon = day[QLatin1String("solarnoon")].toObject();
+        const QJsonObject highMoon = day[QLatin1String("high_moon")].toObject(), lowMoon = day[QLatin1String("low_moon")].toObject();
+
         AbstractSunrise sr;
-        sr.setSunSet(QDateTime::fromString(array.at(i).toObject()["sunset"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"));
-        sr.setSunRise(QDateTime::fromString(array.at(i).toObject()["sunrise"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"));
-        sr.setMoonSet(QDateTime::fromString(array.at(i).toObject()["moonset"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"));
-        sr.setMoonRise(QDateTime::fromString(array.at(i).toObject()["moonrise"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"));
-        sr.setSolarMidnight(QPair<QDateTime, double>(QDateTime::fromString(array.at(i).toObject()["solarmidnight"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"),
-                                                     array.at(i).toObject()["solarmidnight"].toObject()["elevation"].toString().toDouble()));
-        sr.setSolarNoon(QPair<QDateTime, double>(QDateTime::fromString(array.at(i).toObject()["solarnoon"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"),
-                                                 array.at(i).toObject()["solarnoon"].toObject()["elevation"].toString().toDouble()));
-        sr.setHighMoon(QPair<QDateTime, double>(QDateTime::fromString(array.at(i).toObject()["high_moon"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"),
-                                                array.at(i).toObject()["high_moon"].toObject()["elevation"].toString().toDouble()));
-        sr.setLowMoon(QPair<QDateTime, double>(QDateTime::fromString(array.at(i).toObject()["low_moon"].toObject()["time"].toString().left(19), "yyyy-MM-ddThh:mm:ss"),
-                                               array.at(i).toObject()["low_moon"].toObject()["elevation"].toString().toDouble()));
-        sr.setMoonPhase(array.at(i).toObject()["moonposition"].toObject()["phase"].toString().toDouble());
-        
-        // use proper timezone (not local time)
-        sr.setSunSet(QDateTime(sr.sunSet().date(), sr.sunSet().time(), tz));
-        sr.setSunRise(QDateTime(sr.sunRise().date(), sr.sunRise().time(), tz));
-        sr.setMoonSet(QDateTime(sr.moonSet().date(), sr.moonSet().time(), tz));
-        sr.setMoonRise(QDateTime(sr.moonRise().date(), sr.moonRise().time(), tz));
-        
+        sr.setSunSet(time(day[QLatin1String("sunset")].toObject()));
+        sr.setSunRise(time(day[QLatin1String("sunrise")].toObject()));
+        sr.setMoonSet(time(day[QLatin1String("moonset")].toObject()));
+        sr.setMoonRise(time(day[QLatin1String("moonrise")].toObject()));
+        sr.setSolarMidnight(QPair<QDateTime, double>(time(solarMidnight), solarMidnight[QLatin1String("elevation")].toString().toDouble()));
+        sr.setSolarNoon(QPair<QDateTime, double>(time(solarNoon), solarNoon[QLatin1String("elevation")].toString().toDouble()));
+        sr.setHighMoon(QPair<QDateTime, double>(time(highMoon), highMoon[QLatin1String("elevation")].toString().toDouble()));
+        sr.setLowMoon(QPair<QDateTime, double>(time(lowMoon), lowMoon[QLatin1String("elevation")].toString().toDouble()));
+        sr.setMoonPhase(day[QLatin1String("moonposition")].toObject()[QLatin1String("phase")].toString().toDouble());
+
         sunrise_.push_back(sr);
     }
 
     noData = false;
     emit finished();
-    reply->deleteLater();
 }
 
 void NMISunriseAPI::popDay()
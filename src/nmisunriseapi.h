@@ -20,6 +20,7 @@ public:
     NMISunriseAPI(float latitude, float longitude, int offset);
     void update();
     void popDay();
+    void processData(const QByteArray &data); // parse a downloaded sunrise document
     void setOffset(int offset)
     {
         offset_ = offset;
@@ -43,7 +44,6 @@ private slots:
 
 private:
     float longitude_, latitude_, offset_;
-    QNetworkAccessManager *manager = nullptr;
     QList<AbstractSunrise> sunrise_;
     bool noData = true;
 };
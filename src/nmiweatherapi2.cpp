@@ -9,16 +9,27 @@
 #include "abstractdailyweatherforecast.h"
 #include "abstracthourlyweatherforecast.h"
 #include "abstractweatherforecast.h"
+#include "aggregation.h"
+#include "arena.h"
+#include "backendhealthtracker.h"
+#include "derivedquantities.h"
+#include "fieldmap.h"
 #include "global.h"
+#include "interpolation.h"
+#include "jsondecoder.h"
+#include "kweather_debug.h"
+#include "metrics.h"
+#include "timestamp.h"
+#include "tracing.h"
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
-#include <QTimeZone>
 #include <QUrlQuery>
 #include <utility>
 
@@ -27,18 +38,147 @@ NMIWeatherAPI2::NMIWeatherAPI2(QString locationId, QString timeZone, double lati
 {
 }
 
+const QMap<QString, ResolvedWeatherDesc> &NMIWeatherAPI2::apiDescMap()
+{
+    // built once and shared by every location using this backend
+    static const QMap<QString, ResolvedWeatherDesc> map = {
+        {"heavyrainandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"heavyrainandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"heavyrainandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"heavysleetandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"heavysleetandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"heavysleetandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"heavysnowshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"heavysnowshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"heavysnowshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"heavysnow_neutral", ResolvedWeatherDesc("weather-snow", i18n("Heavy Snow"))},
+        {"heavysnow_day", ResolvedWeatherDesc("weather-snow", i18n("Heavy Snow"))},
+        {"heavysnow_night", ResolvedWeatherDesc("weather-snow", i18n("Heavy Snow"))},
+        {"rainandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"rainandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"rainandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"heavysleetshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"heavysleetshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"heavysleetshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"rainshowers_neutral", ResolvedWeatherDesc("weather-showers", i18n("Rain"))},
+        {"rainshowers_day", ResolvedWeatherDesc("weather-showers-day", i18n("Rain"))},
+        {"rainshowers_night", ResolvedWeatherDesc("weather-showers-night", i18n("Rain"))},
+        {"fog_neutral", ResolvedWeatherDesc("weather-fog", i18n("Fog"))},
+        {"fog_day", ResolvedWeatherDesc("weather-fog", i18n("Fog"))},
+        {"fog_night", ResolvedWeatherDesc("weather-fog", i18n("Fog"))},
+        {"heavysleetshowers_neutral", ResolvedWeatherDesc("weather-freezing-rain", i18n("Heavy Sleet"))},
+        {"heavysleetshowers_day", ResolvedWeatherDesc("weather-freezing-rain", i18n("Heavy Sleet"))},
+        {"heavysleetshowers_night", ResolvedWeatherDesc("weather-freezing-rain", i18n("Heavy Sleet"))},
+        {"lightssnowshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"lightssnowshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"lightssnowshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"cloudy_neutral", ResolvedWeatherDesc("weather-clouds", i18n("Cloudy"))},
+        {"cloudy_day", ResolvedWeatherDesc("weather-clouds", i18n("Cloudy"))},
+        {"cloudy_night", ResolvedWeatherDesc("weather-clouds-night", i18n("Cloudy"))},
+        {"snowshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"snowshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"snowshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"lightsnowshowers_neutral", ResolvedWeatherDesc("weather-snow-scattered", i18n("Light Snow"))},
+        {"lightsnowshowers_day", ResolvedWeatherDesc("weather-snow-scattered-day", i18n("Light Snow"))},
+        {"lightsnowshowers_night", ResolvedWeatherDesc("weather-snow-scattered-night", i18n("Light Snow"))},
+        {"heavysleet_neutral", ResolvedWeatherDesc("weather-freezing-rain", i18n("Heavy Sleet"))},
+        {"heavysleet_day", ResolvedWeatherDesc("weather-freezing-rain", i18n("Heavy Sleet"))},
+        {"heavysleet_night", ResolvedWeatherDesc("weather-freezing-rain", i18n("Heavy Sleet"))},
+        {"lightsnowandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"lightsnowandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"lightsnowandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"sleetshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"sleetshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"sleetshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"rainshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"rainshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"rainshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"lightsleet_neutral", ResolvedWeatherDesc("weather-showers-scattered", i18n("Light Sleet"))},
+        {"lightsleet_day", ResolvedWeatherDesc("weather-showers-scattered-day", i18n("Light Sleet"))},
+        {"lightsleet_night", ResolvedWeatherDesc("weather-showers-scattered-night", i18n("Light Sleet"))},
+        {"lightssleetshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"lightssleetshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"lightssleetshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"sleetandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"sleetandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"sleetandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"lightsnow_neutral", ResolvedWeatherDesc("weather-snow-scattered", i18n("Light Snow"))},
+        {"lightsnow_day", ResolvedWeatherDesc("weather-snow-scattered-day", i18n("Light Snow"))},
+        {"lightsnow_night", ResolvedWeatherDesc("weather-snow-scattered-night", i18n("Light Snow"))},
+        {"sleet_neutral", ResolvedWeatherDesc("weather-freezing-rain", i18n("Sleet"))},
+        {"sleet_day", ResolvedWeatherDesc("weather-freezing-rain", i18n("Sleet"))},
+        {"sleet_night", ResolvedWeatherDesc("weather-freezing-rain", i18n("Sleet"))},
+        {"heavyrainshowers_neutral", ResolvedWeatherDesc("weather-showers", i18n("Heavy Rain"))},
+        {"heavyrainshowers_day", ResolvedWeatherDesc("weather-showers-day", i18n("Heavy Rain"))},
+        {"heavyrainshowers_night", ResolvedWeatherDesc("weather-showers-night", i18n("Heavy Rain"))},
+        {"lightsleetshowers_neutral", ResolvedWeatherDesc("weather-showers-scattered", i18n("Light Sleet"))},
+        {"lightsleetshowers_day", ResolvedWeatherDesc("weather-showers-scattered-day", i18n("Light Sleet"))},
+        {"lightsleetshowers_night", ResolvedWeatherDesc("weather-showers-scattered-night", i18n("Light Sleet"))},
+        {"snowshowers_neutral", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snowshowers_day", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snowshowers_night", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snowandthunder_neutral", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snowandthunder_day", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snowandthunder_night", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"lightsleetandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"lightsleetandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"lightsleetandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"snow_neutral", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snow_day", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"snow_night", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"heavyrainshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"heavyrainshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"heavyrainshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"rain_neutral", ResolvedWeatherDesc("weather-showers", i18n("Rain"))},
+        {"rain_day", ResolvedWeatherDesc("weather-showers-day", i18n("Rain"))},
+        {"rain_night", ResolvedWeatherDesc("weather-showers-night", i18n("Rain"))},
+        {"heavysnowshowers_neutral", ResolvedWeatherDesc("weather-snow", i18n("Heavy Snow"))},
+        {"heavysnowshowers_day", ResolvedWeatherDesc("weather-snow", i18n("Heavy Snow"))},
+        {"heavysnowshowers_night", ResolvedWeatherDesc("weather-snow", i18n("Heavy Snow"))},
+        {"lightrain_neutral", ResolvedWeatherDesc("weather-showers-scattered", i18n("Light Rain"))},
+        {"lightrain_day", ResolvedWeatherDesc("weather-showers-scattered-day", i18n("Light Rain"))},
+        {"lightrain_night", ResolvedWeatherDesc("weather-showers-scattered-night", i18n("Light Rain"))},
+        {"fair_neutral", ResolvedWeatherDesc("weather-few-clouds", i18n("Light Clouds"))},
+        {"fair_day", ResolvedWeatherDesc("weather-few-clouds", i18n("Partly Sunny"))},
+        {"fair_night", ResolvedWeatherDesc("weather-few-clouds-night", i18n("Light Clouds"))},
+        {"partlycloudy_neutral", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"partlycloudy_day", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"partlycloudy_night", ResolvedWeatherDesc("weather-clouds-night", i18n("Partly Cloudy"))},
+        {"clearsky_neutral", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
+        {"clearsky_day", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
+        {"clearsky_night", ResolvedWeatherDesc("weather-clear-night", i18n("Clear"))},
+        {"lightrainshowers_neutral", ResolvedWeatherDesc("weather-showers-scattered", i18n("Light Rain"))},
+        {"lightrainshowers_day", ResolvedWeatherDesc("weather-showers-scattered-day", i18n("Light Rain"))},
+        {"lightrainshowers_night", ResolvedWeatherDesc("weather-showers-scattered-night", i18n("Light Rain"))},
+        {"sleetshowers_neutral", ResolvedWeatherDesc("weather-freezing-rain", i18n("Sleet"))},
+        {"sleetshowers_day", ResolvedWeatherDesc("weather-freezing-rain", i18n("Sleet"))},
+        {"sleetshowers_night", ResolvedWeatherDesc("weather-freezing-rain", i18n("Sleet"))},
+        {"lightrainandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"lightrainandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"lightrainandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"lightrainshowersandthunder_neutral", ResolvedWeatherDesc("weather-storm", i18n("Storm"))},
+        {"lightrainshowersandthunder_day", ResolvedWeatherDesc("weather-storm-day", i18n("Storm"))},
+        {"lightrainshowersandthunder_night", ResolvedWeatherDesc("weather-storm-night", i18n("Storm"))},
+        {"heavyrain_neutral", ResolvedWeatherDesc("weather-showers", i18n("Heavy Rain"))},
+        {"heavyrain_day", ResolvedWeatherDesc("weather-showers-day", i18n("Heavy Rain"))},
+        {"heavyrain_night", ResolvedWeatherDesc("weather-showers-night", i18n("Heavy Rain"))},
+    };
+    return map;
+}
+
 QString NMIWeatherAPI2::getSymbolCodeDescription(bool isDay, const QString &symbolCode)
 {
-    return isDay ? apiDescMap[symbolCode + "_day"].desc : apiDescMap[symbolCode + "_night"].desc;
+    return isDay ? apiDescMap()[symbolCode + "_day"].desc : apiDescMap()[symbolCode + "_night"].desc;
 }
 
 QString NMIWeatherAPI2::getSymbolCodeIcon(bool isDay, const QString &symbolCode)
 {
-    return isDay ? apiDescMap[symbolCode + "_day"].icon : apiDescMap[symbolCode + "_night"].icon;
+    return isDay ? apiDescMap()[symbolCode + "_day"].icon : apiDescMap()[symbolCode + "_night"].icon;
 }
 
 void NMIWeatherAPI2::applySunriseDataToForecast()
 {
+    TraceSpan span("sunrise application", locationId_);
     currentData_.setSunrise(currentSunriseData_);
     for (int i = 0; i < currentData_.hourlyForecasts().count(); i++) {
         auto hourForecast = currentData_.hourlyForecasts()[i];
@@ -61,9 +201,13 @@ void NMIWeatherAPI2::update()
 {
     // don't update if updated recently, and forecast is not empty
     if (!currentData_.dailyForecasts().empty() && !currentData_.hourlyForecasts().empty() && currentData_.timeCreated().secsTo(QDateTime::currentDateTime()) < 300) {
-        emit updated(currentData_);
+        Metrics::instance().increment(QStringLiteral("kweather_cache_hits_total"), QStringLiteral("nmi"));
+        publish();
         return;
     }
+    Metrics::instance().increment(QStringLiteral("kweather_cache_misses_total"), QStringLiteral("nmi"));
+    if (lastRequestFailed_)
+        Metrics::instance().increment(QStringLiteral("kweather_request_retries_total"), QStringLiteral("nmi"));
 
     // query weather api
     QUrl url("https://api.met.no/weatherapi/locationforecast/2.0/complete");
@@ -72,8 +216,9 @@ void NMIWeatherAPI2::update()
     query.addQueryItem("lon", QString::number(longitude_));
 
     url.setQuery(query);
+    applyServerOverride(url);
 
-    qDebug() << url;
+    qCDebug(KWEATHER_LOG) << url;
     QNetworkRequest req(url);
     req.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
 
@@ -84,150 +229,203 @@ void NMIWeatherAPI2::update()
     // see §Compression on https://api.met.no/conditions_service.html
     //    req.setRawHeader("Accept-Encoding", "gzip, deflate");
     mReply = mManager->get(req);
-    connect(
-        mReply, &QNetworkReply::finished, this, [this]() { this->parse(this->mReply); }, Qt::ConnectionType::UniqueConnection);
+    Metrics::instance().trackReply(mReply, QStringLiteral("nmi")); // before parse() consumes the body
+    BackendHealthTracker::instance().trackReply(mReply, Kweather::Backend::NMI);
+    Tracing::traceReply(mReply, "fetch forecast", locationId_);
+    QNetworkReply *reply = mReply;
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() { this->parse(reply); });
 }
 
 void NMIWeatherAPI2::parse(QNetworkReply *reply)
 {
     reply->deleteLater();
     if (reply->error()) {
-        qDebug() << "network error when fetching forecast:" << reply->errorString();
+        qCDebug(KWEATHER_LOG) << "network error when fetching forecast:" << reply->errorString();
+        lastRequestFailed_ = true;
         emit networkError();
         return;
     }
+    lastRequestFailed_ = false;
 
-    qDebug() << "data arrived";
-    // parse json for weather forecast
-    QJsonDocument jsonDocument = QJsonDocument::fromJson(reply->readAll());
-
-    if (jsonDocument.isObject()) {
-        QJsonObject obj = jsonDocument.object();
-        QJsonObject prop = obj["properties"].toObject();
-
-        if (prop.contains("timeseries")) {
-            QJsonArray timeseries = prop["timeseries"].toArray();
+    qCDebug(KWEATHER_LOG) << "data arrived";
+    const QByteArray body = reply->readAll();
+    if (bodyUnchanged(body))
+        return;
+    parseData(body);
+}
 
-            QHash<QDate, AbstractDailyWeatherForecast> dayCache;
-            QList<AbstractHourlyWeatherForecast> hoursList;
+// one entry of "timeseries", https://api.met.no/weatherapi/locationforecast/2.0/documentation
+struct NMIWeatherAPI2::Entry {
+    bool hasTime = false, hasNextHour = false, hasNextSixHours = false;
+    qint64 time = 0;
+    // whatever the payload leaves out reads as 0
+    float temperature = 0, pressure = 0, windSpeed = 0, humidity = 0, fog = 0, uvIndex = 0;
+    double windDeg = 0, sixHoursMax = 0, sixHoursMin = 0;
+    double nextHourPrecipitation = 0, nextSixHoursPrecipitation = 0;
+    FixedText<32> nextHourSymbol, nextSixHoursSymbol; // without the _day/_night suffix
+};
+
+const FieldMap<NMIWeatherAPI2::Entry> &NMIWeatherAPI2::entryFields()
+{
+    static const FieldMap<Entry> fields = {
+        {"time", [](Entry &e, const QJsonValue &v) { e.hasTime = Timestamp::toEpoch(v.toString(), e.time); }},
+        {"data.instant.details.air_temperature", [](Entry &e, const QJsonValue &v) { e.temperature = v.toDouble(); }},
+        {"data.instant.details.air_pressure_at_sea_level", [](Entry &e, const QJsonValue &v) { e.pressure = v.toDouble(); }},
+        {"data.instant.details.wind_speed", [](Entry &e, const QJsonValue &v) { e.windSpeed = v.toDouble(); }},
+        {"data.instant.details.relative_humidity", [](Entry &e, const QJsonValue &v) { e.humidity = v.toDouble(); }},
+        {"data.instant.details.fog_area_fraction", [](Entry &e, const QJsonValue &v) { e.fog = v.toDouble(); }},
+        {"data.instant.details.ultraviolet_index_clear_sky", [](Entry &e, const QJsonValue &v) { e.uvIndex = v.toDouble(); }},
+        {"data.instant.details.wind_from_direction", [](Entry &e, const QJsonValue &v) { e.windDeg = v.toDouble(); }},
+        {"data.next_1_hours", [](Entry &e, const QJsonValue &) { e.hasNextHour = true; }},
+        {"data.next_1_hours.summary.symbol_code", [](Entry &e, const QJsonValue &v) { e.nextHourSymbol.assign(v.toString(), QLatin1Char('_')); }},
+        {"data.next_1_hours.details.precipitation_amount", [](Entry &e, const QJsonValue &v) { e.nextHourPrecipitation = v.toDouble(); }},
+        {"data.next_6_hours", [](Entry &e, const QJsonValue &) { e.hasNextSixHours = true; }},
+        {"data.next_6_hours.summary.symbol_code", [](Entry &e, const QJsonValue &v) { e.nextSixHoursSymbol.assign(v.toString(), QLatin1Char('_')); }},
+        {"data.next_6_hours.details.precipitation_amount", [](Entry &e, const QJsonValue &v) { e.nextSixHoursPrecipitation = v.toDouble(); }},
+        {"data.next_6_hours.details.air_temperature_max", [](Entry &e, const QJsonValue &v) { e.sixHoursMax = v.toDouble(); }},
+        {"data.next_6_hours.details.air_temperature_min", [](Entry &e, const QJsonValue &v) { e.sixHoursMin = v.toDouble(); }},
+    };
+    return fields;
+}
 
-            // loop over all forecast data
-            for (QJsonValueRef ref : timeseries) {
-                QJsonObject refObj = ref.toObject();
-                parseOneElement(refObj, dayCache, hoursList);
-            }
+bool NMIWeatherAPI2::decodeEntries(const QByteArray &data, EntryList &entries)
+{
+#ifdef HAVE_SIMDJSON
+    if (JsonDecoder::useSimd()) {
+        simdjson::dom::element document;
+        simdjson::dom::array timeseries;
+        if (JsonDecoder::parser().parse(data.constData(), data.size()).get(document) || document["properties"]["timeseries"].get(timeseries))
+            return false;
+        entries.reserve(timeseries.size());
+        for (simdjson::dom::element element : timeseries) {
+            simdjson::dom::object object;
+            entries.emplace_back();
+            if (!element.get(object))
+                entryFields().apply(object, entries.back());
+        }
+        return true;
+    }
+#endif
 
-            // sort the daily forecasts
-            auto daysList = dayCache.values();
-            std::sort(daysList.begin(), daysList.end(), [](AbstractDailyWeatherForecast h1, AbstractDailyWeatherForecast h2) -> bool { return h1.date() < h2.date(); });
+    // parse json for weather forecast
+    QJsonDocument jsonDocument = QJsonDocument::fromJson(data);
+    const QJsonObject prop = jsonDocument.object()["properties"].toObject();
+    if (!prop.contains("timeseries"))
+        return false;
+
+    const QJsonArray timeseries = prop["timeseries"].toArray();
+    entries.reserve(timeseries.size());
+    for (const auto &ref : timeseries) {
+        entries.emplace_back();
+        entryFields().apply(ref.toObject(), entries.back());
+    }
+    return true;
+}
 
-            // process and build abstract forecast
-            currentData_ = AbstractWeatherForecast(QDateTime::currentDateTime(), locationId_, latitude_, longitude_, hoursList, daysList);
+void NMIWeatherAPI2::parseData(const QByteArray &data)
+{
+    TraceSpan span("parse", locationId_);
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+
+    // scratch records live in the arena, only the forecast itself goes to the heap
+    MonotonicArena &arena = MonotonicArena::scratch();
+    MonotonicArena::Scope scope(arena);
+    EntryList entries{ArenaAllocator<Entry>(arena)};
+    if (decodeEntries(data, entries)) {
+        Aggregation::Series series(arena);
+        QList<AbstractHourlyWeatherForecast> hoursList;
+        const ZoneOffsetTable &offsets = zoneOffsets();
+
+        // loop over all forecast data
+        series.reserve(static_cast<int>(entries.size()));
+        hoursList.reserve(static_cast<int>(entries.size()));
+        for (const auto &entry : entries)
+            parseOneElement(entry, offsets, series, hoursList);
+
+        // daily forecasts, the worst condition of a day describes it
+        Aggregation::Column<Aggregation::Summary> days{ArenaAllocator<Aggregation::Summary>(arena)};
+        Aggregation::aggregate(series, Aggregation::Window::Day, days);
+        QList<AbstractDailyWeatherForecast> daysList;
+        daysList.reserve(static_cast<int>(days.size()));
+        for (const auto &day : days) {
+            const AbstractHourlyWeatherForecast &hour = hoursList.at(day.dominant);
+            daysList.append(AbstractDailyWeatherForecast(day.maxTemperature,
+                                                         day.minTemperature,
+                                                         day.precipitation,
+                                                         day.uvIndex,
+                                                         day.humidity,
+                                                         day.pressure,
+                                                         hour.neutralWeatherIcon(),
+                                                         apiDescMap().value(hour.symbolCode() + QStringLiteral("_neutral")).desc,
+                                                         day.date()));
         }
-    }
 
-    for (auto fc : currentData_.hourlyForecasts()) {
-        fc.setDate(fc.date().toTimeZone(QTimeZone(timeZone_.toUtf8())));
+        // from 1 hour steps to 6 hour steps and back to an even grid, the days are made from what the backend sent
+        Interpolation::resample(hoursList, 3600, arena, &offsets);
+        DerivedQuantities::apply(hoursList);
+
+        // process and build abstract forecast
+        currentData_ = AbstractWeatherForecast(QDateTime::currentDateTime(), locationId_, latitude_, longitude_, hoursList, daysList);
     }
 
     applySunriseDataToForecast(); // applies sunrise data whether we have it or not
+    Metrics::instance().record(QStringLiteral("kweather_parse_microseconds"), QStringLiteral("nmi"), QString(), parseTimer.nsecsElapsed() / 1000);
 
-    emit updated(currentData_);
+    publish();
 }
 
-// https://api.met.no/weatherapi/locationforecast/2.0/documentation
-void NMIWeatherAPI2::parseOneElement(QJsonObject &object, QHash<QDate, AbstractDailyWeatherForecast> &dayCache, QList<AbstractHourlyWeatherForecast> &hoursList)
+void NMIWeatherAPI2::parseOneElement(const Entry &entry, const ZoneOffsetTable &offsets, Aggregation::Series &series, QList<AbstractHourlyWeatherForecast> &hoursList)
 {
-    /*~~~~~~~~~~ static variable ~~~~~~~~~~~*/
-    // rank weather (for what best describes the day overall)
-    static const QHash<QString, int> rank = {// only need neutral icons
-                                             {"weather-none-available", -1},
-                                             {"weather-clear", 0},
-                                             {"weather-few-clouds", 1},
-                                             {"weather-clouds", 2},
-                                             {"weather-fog", 3},
-                                             {"weather-mist", 3},
-                                             {"weather-showers-scattered", 4},
-                                             {"weather-snow-scattered", 4},
-                                             {"weather-showers", 5},
-                                             {"weather-hail", 5},
-                                             {"weather-snow", 5},
-                                             {"weather-freezing-rain", 6},
-                                             {"weather-freezing-storm", 6},
-                                             {"weather-snow-rain", 6},
-                                             {"weather-storm", 7}};
-
-    QJsonObject data = object["data"].toObject(), instant = data["instant"].toObject()["details"].toObject();
     // ignore last forecast, which does not have enough data
-    if (!data.contains("next_6_hours") && !data.contains("next_1_hours"))
+    if (!entry.hasTime || (!entry.hasNextHour && !entry.hasNextSixHours))
         return;
 
-    // correct date to corresponding timezone of location if possible
-    QDateTime date;
-    if (timeZone_.isEmpty()) {
-        date = QDateTime::fromString(object.value("time").toString(), Qt::ISODate);
-    } else {
-        date = QDateTime::fromString(object.value("time").toString(), Qt::ISODate).toTimeZone(QTimeZone(timeZone_.toUtf8()));
-    }
-
-    AbstractHourlyWeatherForecast hourForecast;
+    // times are UTC, shift them to the location's zone if we know it
+    const QDateTime date = offsets.toDateTime(entry.time);
 
-    // set initial hour fields
-    hourForecast.setDate(date); // the first time will be at the exact time of
-                                // query, otherwise the beginning of each hour
-    hourForecast.setTemperature(instant["air_temperature"].toDouble());
-    hourForecast.setPressure(instant["air_pressure_at_sea_level"].toDouble());
-    hourForecast.setWindSpeed(instant["wind_speed"].toDouble());
-    hourForecast.setHumidity(instant["relative_humidity"].toDouble());
-    hourForecast.setFog(instant["fog_area_fraction"].toDouble());
-    hourForecast.setUvIndex(instant["ultraviolet_index_clear_sky"].toDouble());
-
-    // wind direction
-    double windDirectionDeg = instant["wind_from_direction"].toDouble();
-    hourForecast.setWindDirection(getWindDirect(windDirectionDeg));
-
-    QString symbolCode;
     // some fields contain only "next_1_hours", and others may contain only
-    // "next_6_hours"
-    if (data.contains("next_1_hours")) {
-        QJsonObject nextOneHours = data["next_1_hours"].toObject();
-        symbolCode = nextOneHours["summary"].toObject()["symbol_code"].toString("unknown");
-        hourForecast.setPrecipitationAmount(nextOneHours["details"].toObject()["precipitation_amount"].toDouble());
-    } else {
-        QJsonObject nextSixHours = data["next_6_hours"].toObject();
-        symbolCode = nextSixHours["summary"].toObject()["symbol_code"].toString("unknown");
-        hourForecast.setPrecipitationAmount(nextSixHours["details"].toObject()["precipitation_amount"].toDouble());
-    }
-
-    symbolCode = symbolCode.split('_')[0]; // trim _[day/night] from end -
-                                           // https://api.met.no/weatherapi/weathericon/2.0/legends
-    hourForecast.setNeutralWeatherIcon(apiDescMap[symbolCode + "_neutral"].icon);
-    hourForecast.setSymbolCode(symbolCode);
-
-    // add day if not already created
-    if (!dayCache.contains(date.date())) {
-        dayCache[date.date()] = AbstractDailyWeatherForecast(-1e9, 1e9, 0, 0, 0, 0, "weather-none-available", "Unknown", date.date());
-    }
-
-    // update day forecast with hour information if needed
-    AbstractDailyWeatherForecast &dayForecast = dayCache[date.date()];
-
-    dayForecast.setPrecipitation(dayForecast.precipitation() + hourForecast.precipitationAmount());
-    dayForecast.setUvIndex(std::max(dayForecast.uvIndex(), hourForecast.uvIndex()));
-    dayForecast.setHumidity(std::max(dayForecast.humidity(), hourForecast.humidity()));
-    dayForecast.setPressure(std::max(dayForecast.pressure(), hourForecast.pressure()));
-
-    if (data.contains("next_6_hours")) {
-        QJsonObject details = data["next_6_hours"].toObject()["details"].toObject();
-        dayForecast.setMaxTemp(std::max(dayForecast.maxTemp(), (float)details["air_temperature_max"].toDouble()));
-        dayForecast.setMinTemp(std::min(dayForecast.minTemp(), (float)details["air_temperature_min"].toDouble()));
-    }
-
-    // set description and icon if it is higher ranked
-    if (rank[hourForecast.neutralWeatherIcon()] >= rank[dayForecast.weatherIcon()]) {
-        dayForecast.setWeatherDescription(apiDescMap[symbolCode + "_neutral"].desc);
-        dayForecast.setWeatherIcon(hourForecast.neutralWeatherIcon());
-    }
+    // "next_6_hours"; the suffix is already trimmed -
+    // https://api.met.no/weatherapi/weathericon/2.0/legends
+    const FixedText<32> &symbol = entry.hasNextHour ? entry.nextHourSymbol : entry.nextSixHoursSymbol;
+    const QString symbolCode = symbol.isEmpty() ? QStringLiteral("unknown") : symbol.view();
+
+    // look up symbolCode + "_neutral" without building that string on the heap
+    static const QLatin1String neutral("_neutral");
+    QChar key[32 + 8];
+    std::copy(symbolCode.constBegin(), symbolCode.constEnd(), key);
+    for (int i = 0; i < neutral.size(); i++)
+        key[symbolCode.size() + i] = QLatin1Char(neutral.data()[i]);
+    const ResolvedWeatherDesc desc = apiDescMap().value(QString::fromRawData(key, symbolCode.size() + neutral.size()));
+
+    // the first time will be at the exact time of query, otherwise the beginning of each hour
+    AbstractHourlyWeatherForecast hourForecast(date,
+                                               QStringLiteral("Unknown"),
+                                               QStringLiteral("weather-none-available"),
+                                               desc.icon,
+                                               entry.temperature,
+                                               entry.pressure,
+                                               getWindDirect(entry.windDeg),
+                                               entry.windSpeed,
+                                               entry.humidity,
+                                               entry.fog,
+                                               entry.uvIndex,
+                                               entry.hasNextHour ? entry.nextHourPrecipitation : entry.nextSixHoursPrecipitation);
+    hourForecast.setSymbolCode(QString(symbolCode.constData(), symbolCode.size())); // a copy, the view dies with the entry
+    hourForecast.setWindDegrees(entry.windDeg);
+
+    // the extremes of next_6_hours where there are any, the instant temperature otherwise
+    const float minTemperature = entry.hasNextSixHours ? entry.sixHoursMin : entry.temperature;
+    const float maxTemperature = entry.hasNextSixHours ? entry.sixHoursMax : entry.temperature;
+    series.append(entry.time + date.offsetFromUtc(),
+                  entry.temperature,
+                  minTemperature,
+                  maxTemperature,
+                  hourForecast.precipitationAmount(),
+                  entry.uvIndex,
+                  entry.humidity,
+                  entry.pressure,
+                  Aggregation::rank(desc.icon));
 
     // add hour forecast to list
     hoursList.append(hourForecast);
@@ -6,27 +6,92 @@
  */
 
 #include "owmweatherapi.h"
+#include "aggregation.h"
+#include "arena.h"
+#include "backendhealthtracker.h"
+#include "derivedquantities.h"
+#include "fieldmap.h"
+#include "interpolation.h"
+#include "jsondecoder.h"
+#include "kweather_debug.h"
 #include "kweathersettings.h"
+#include "metrics.h"
+#include "tracing.h"
 
+#include <QElapsedTimer>
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
-#include <QTimeZone>
 #include <QUrlQuery>
 #include <utility>
 
 OWMWeatherAPI::OWMWeatherAPI(QString locationId, QString timeZone, double latitude, double longitude)
     : AbstractWeatherAPI(std::move(locationId), std::move(timeZone), 3, latitude, longitude)
 {
+    connect(this, &OWMWeatherAPI::TokenInvalid, this, [] { BackendHealthTracker::instance().credentialsRejected(Kweather::Backend::OWM); });
+    connect(this, &OWMWeatherAPI::TooManyCalls, this, [] { BackendHealthTracker::instance().quotaExhausted(Kweather::Backend::OWM); });
 }
 
 OWMWeatherAPI::~OWMWeatherAPI() = default;
 
+const QMap<QString, ResolvedWeatherDesc> &OWMWeatherAPI::apiDescMap()
+{
+    // built once and shared by every location using this backend
+    static const QMap<QString, ResolvedWeatherDesc> map = {
+        {"01d", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
+        {"01n", ResolvedWeatherDesc("weather-clear-night", i18n("Clear"))},
+        {"02d", ResolvedWeatherDesc("weather-few-clouds", i18n("Mostly Sunny"))},
+        {"02n", ResolvedWeatherDesc("weather-few-clouds-night", i18n("Mostly Sunny"))},
+        {"03d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"03n", ResolvedWeatherDesc("weather-clouds-night", i18n("Partly Cloudy"))},
+        {"04d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"04n", ResolvedWeatherDesc("weather-clouds-night", i18n("Partly Cloudy"))},
+        {"09d", ResolvedWeatherDesc("weather-showers-day", i18n("Rain Showers"))},
+        {"09n", ResolvedWeatherDesc("weather-showers-night", i18n("Rain Showers"))},
+        {"10d", ResolvedWeatherDesc("weather-showers-day", i18n("Rain"))},
+        {"10n", ResolvedWeatherDesc("weather-showers-night", i18n("Rain"))},
+        {"11d", ResolvedWeatherDesc("weather-storm-day", i18n("Thunderstorm"))},
+        {"11n", ResolvedWeatherDesc("weather-storm-night", i18n("Thunderstorm"))},
+        {"13d", ResolvedWeatherDesc("weather-snow-scattered-day", i18n("Snow"))},
+        {"13n", ResolvedWeatherDesc("weather-snow-scattered-night", i18n("Snow"))},
+        {"50d", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
+        {"50n", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
+    };
+    return map;
+}
+
+const QMap<QString, ResolvedWeatherDesc> &OWMWeatherAPI::neutralApiDescMap()
+{
+    // built once and shared by every location using this backend
+    static const QMap<QString, ResolvedWeatherDesc> map = {
+        {"01d", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
+        {"01n", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
+        {"02d", ResolvedWeatherDesc("weather-few-clouds", i18n("Mostly Sunny"))},
+        {"02n", ResolvedWeatherDesc("weather-few-clouds", i18n("Mostly Sunny"))},
+        {"03d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"03n", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"04d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"04n", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
+        {"09d", ResolvedWeatherDesc("weather-showers", i18n("Rain Showers"))},
+        {"09n", ResolvedWeatherDesc("weather-showers", i18n("Rain Showers"))},
+        {"10d", ResolvedWeatherDesc("weather-showers", i18n("Rain"))},
+        {"10n", ResolvedWeatherDesc("weather-showers", i18n("Rain"))},
+        {"11d", ResolvedWeatherDesc("weather-storm", i18n("Thunderstorm"))},
+        {"11n", ResolvedWeatherDesc("weather-storm", i18n("Thunderstorm"))},
+        {"13d", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"13n", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
+        {"50d", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
+        {"50n", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
+    };
+    return map;
+}
+
 void OWMWeatherAPI::applySunriseDataToForecast()
 {
+    TraceSpan span("sunrise application", locationId_);
     currentData_.setSunrise(currentSunriseData_);
 }
 
@@ -34,98 +99,162 @@ void OWMWeatherAPI::parse(QNetworkReply *reply)
 {
     reply->deleteLater();
     if (reply->error()) {
-        qDebug() << "network error when fetching forecast:" << reply->errorString();
+        qCDebug(KWEATHER_LOG) << "network error when fetching forecast:" << reply->errorString();
+        lastRequestFailed_ = true;
+        // the status owm puts in the body comes as the http one too
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (status == 401)
+            emit TokenInvalid();
+        else if (status == 429)
+            emit TooManyCalls();
         emit networkError();
         return;
     }
+    lastRequestFailed_ = false;
 
-    /*~~~~~~~~~ static variable ~~~~~~~~*/
-    // rank weather (for what best describes the day overall)
-    static const QHash<QString, int> rank = {
-        // only need neutral icons
-
-        {"weather-clear", 0},
-        {"weather-clear-night", 0},
-        {"weather-few-clouds", 1},
-        {"weather-few-clouds-night", 1},
-        {"weather-clouds", 2},
-        {"weather-clouds-night", 2},
-        {"weather-mist", 2},
-        {"weather-many-clouds", 3},
-        {"weather-showers", 4},
-        {"weather-showers-day", 4},
-        {"weather-showers-night", 4},
-        {"weather-showers-scattered-day", 5},
-        {"weather-showers-scattered-night", 5},
-        {"weather-snow", 5},
-        {"weather-snow-scattered-day", 5},
-        {"weather-snow-scattered-night", 5},
-        {"weather-storm", 6},
-        {"weather-storm-day", 6},
-        {"weather-storm-night", 6},
+    const QByteArray body = reply->readAll();
+    if (bodyUnchanged(body))
+        return;
+    parseData(body);
+}
+
+// one entry of "list", https://openweathermap.org/forecast5
+struct OWMWeatherAPI::Entry {
+    qint64 time = 0;
+    // whatever the payload leaves out reads as 0
+    float temperature = 0, pressure = 0, windSpeed = 0, humidity = 0, precipitation = 0;
+    double tempMax = 0, tempMin = 0, windDeg = 0;
+    FixedText<4> icon;
+};
+
+const FieldMap<OWMWeatherAPI::Entry> &OWMWeatherAPI::entryFields()
+{
+    static const FieldMap<Entry> fields = {
+        {"dt", [](Entry &e, const QJsonValue &v) { e.time = static_cast<qint64>(v.toDouble()); }},
+        {"main.temp", [](Entry &e, const QJsonValue &v) { e.temperature = v.toDouble(); }},
+        {"main.temp_max", [](Entry &e, const QJsonValue &v) { e.tempMax = v.toDouble(); }},
+        {"main.temp_min", [](Entry &e, const QJsonValue &v) { e.tempMin = v.toDouble(); }},
+        {"main.humidity", [](Entry &e, const QJsonValue &v) { e.humidity = v.toInt(); }},
+        {"main.pressure", [](Entry &e, const QJsonValue &v) { e.pressure = v.toInt(); }},
+        {"wind.speed", [](Entry &e, const QJsonValue &v) { e.windSpeed = v.toDouble(); }},
+        {"wind.deg", [](Entry &e, const QJsonValue &v) { e.windDeg = v.toDouble(); }},
+        {"weather.0.icon", [](Entry &e, const QJsonValue &v) { e.icon.assign(v.toString()); }},
+        {"rain.3h", [](Entry &e, const QJsonValue &v) { e.precipitation += v.toDouble(); }},
+        {"snow.3h", [](Entry &e, const QJsonValue &v) { e.precipitation += v.toDouble(); }},
     };
+    return fields;
+}
 
-    /*~~~~~~~~~~~ end of static variable ~~~~~~~~~~*/
+void OWMWeatherAPI::decodeEntries(const QByteArray &data, EntryList &entries, int &status, int &offset)
+{
+#ifdef HAVE_SIMDJSON
+    if (JsonDecoder::useSimd()) {
+        simdjson::dom::element document;
+        if (JsonDecoder::parser().parse(data.constData(), data.size()).get(document))
+            return;
+        int64_t value;
+        if (!document["cod"].get(value)) // a string when all is well
+            status = static_cast<int>(value);
+        if (!document["city"]["timezone"].get(value))
+            offset = static_cast<int>(value);
+        simdjson::dom::array list;
+        if (document["list"].get(list))
+            return;
+        entries.reserve(list.size());
+        for (simdjson::dom::element element : list) {
+            simdjson::dom::object object;
+            entries.emplace_back();
+            if (!element.get(object))
+                entryFields().apply(object, entries.back());
+        }
+        return;
+    }
+#endif
+
+    QJsonDocument mJson = QJsonDocument::fromJson(data);
+    status = mJson["cod"].toInt();
+    offset = mJson["city"].toObject()["timezone"].toInt();
+    const QJsonArray mArray = mJson["list"].toArray();
+    entries.reserve(mArray.size());
+    for (const auto &fc : mArray) {
+        entries.emplace_back();
+        entryFields().apply(fc.toObject(), entries.back());
+    }
+}
+
+void OWMWeatherAPI::parseData(const QByteArray &data)
+{
+    TraceSpan span("parse", locationId_);
+    QElapsedTimer parseTimer;
+    parseTimer.start();
 
-    QJsonDocument mJson = QJsonDocument::fromJson(reply->readAll());
-    if (mJson["cod"].toInt() == 401) // API Token invalid
+    // scratch records live in the arena, only the forecast itself goes to the heap
+    MonotonicArena &arena = MonotonicArena::scratch();
+    MonotonicArena::Scope scope(arena);
+    EntryList entries{ArenaAllocator<Entry>(arena)};
+    int status = 0, offset = 0;
+    decodeEntries(data, entries, status, offset);
+    if (status == 401) // API Token invalid
     {
         emit TokenInvalid();
         return;
     }
-    if (mJson["cod"].toInt() == 429) // calls reached limit
+    if (status == 429) // calls reached limit
     {
         emit TooManyCalls();
         return;
     }
-    AbstractHourlyWeatherForecast hourly;
     QList<AbstractHourlyWeatherForecast> hourlyList;
-    QHash<QDate, AbstractDailyWeatherForecast> dayCache;
-
-    int offset = mJson["city"].toObject()["timezone"].toInt();
-    QJsonArray mArray = mJson["list"].toArray();
-    for (auto fc : mArray) {
-        auto date = QDateTime::fromSecsSinceEpoch(fc.toObject()["dt"].toInt()).toTimeZone(QTimeZone(offset));
-        hourly = AbstractHourlyWeatherForecast();
-        hourly.setDate(date);
-        hourly.setFog(-1);
-        hourly.setUvIndex(-1);
-        hourly.setHumidity(fc.toObject()["main"].toObject()["humidity"].toInt());
-        hourly.setPressure(fc.toObject()["main"].toObject()["pressure"].toInt());
-        hourly.setWindSpeed(fc.toObject()["wind"].toObject()["speed"].toDouble());
-        hourly.setTemperature(fc.toObject()["main"].toObject()["temp"].toDouble());
-        hourly.setNeutralWeatherIcon(neutralApiDescMap[fc.toObject()["weather"].toArray().at(0)["icon"].toString()].icon);
-        hourly.setWeatherIcon(apiDescMap[fc.toObject()["weather"].toArray().at(0)["icon"].toString()].icon);
-        hourly.setWindDirection(getWindDirect(fc.toObject()["wind"].toObject()["deg"].toDouble()));
-        hourly.setWeatherDescription(apiDescMap[fc.toObject()["weather"].toArray().at(0)["icon"].toString()].desc /*fc.toObject()["weather"].toArray().at(0)["description"].toString()*/);
-        hourly.setPrecipitationAmount(fc.toObject()["rain"].toObject()["3h"].toDouble() + fc.toObject()["snow"].toObject()["3h"].toDouble());
-        hourlyList.push_back(hourly);
-        // add day if not already created
-        if (!dayCache.contains(date.date())) {
-            dayCache[date.date()] = AbstractDailyWeatherForecast(-1e9, 1e9, 0, 0, 0, 0, "weather-none-available", "", date.date());
-        }
-
-        // update day forecast with hour information if needed
-        AbstractDailyWeatherForecast &dayForecast = dayCache[date.date()];
+    Aggregation::Series series(arena);
 
-        dayForecast.setPrecipitation(dayForecast.precipitation() + hourly.precipitationAmount());
-        dayForecast.setUvIndex(std::max(dayForecast.uvIndex(), hourly.uvIndex()));
-        dayForecast.setHumidity(std::max(dayForecast.humidity(), hourly.humidity()));
-        dayForecast.setPressure(std::max(dayForecast.pressure(), hourly.pressure()));
-
-        dayForecast.setMaxTemp(std::max(dayForecast.maxTemp(), (float)fc.toObject()["main"].toObject()["temp_max"].toDouble()));
-        dayForecast.setMinTemp(std::min(dayForecast.minTemp(), (float)fc.toObject()["main"].toObject()["temp_min"].toDouble()));
+    series.reserve(static_cast<int>(entries.size()));
+    hourlyList.reserve(static_cast<int>(entries.size()));
+    for (const auto &entry : entries) {
+        const auto date = QDateTime::fromSecsSinceEpoch(entry.time, Qt::OffsetFromUTC, offset);
+        const QString icon = entry.icon.view(); // only for the lookups, it dies with the entry
+        const ResolvedWeatherDesc desc = apiDescMap().value(icon);
+        AbstractHourlyWeatherForecast hourly(date,
+                                             desc.desc,
+                                             desc.icon,
+                                             neutralApiDescMap().value(icon).icon,
+                                             entry.temperature,
+                                             entry.pressure,
+                                             getWindDirect(entry.windDeg),
+                                             entry.windSpeed,
+                                             entry.humidity,
+                                             -1, // no fog or uv index from owm
+                                             -1,
+                                             entry.precipitation);
+        hourly.setWindDegrees(entry.windDeg);
+        series.append(entry.time + offset, entry.temperature, entry.tempMin, entry.tempMax, entry.precipitation, 0, entry.humidity, entry.pressure, Aggregation::rank(hourly.neutralWeatherIcon()));
+        hourlyList.push_back(hourly);
+    }
 
-        // set description and icon if it is higher ranked
-        if (rank[hourly.weatherIcon()] >= rank[dayForecast.weatherIcon()]) {
-            dayForecast.setWeatherDescription(hourly.weatherDescription());
-            dayForecast.setWeatherIcon(hourly.neutralWeatherIcon());
-        }
+    // daily forecasts, the worst condition of a day describes it
+    Aggregation::Column<Aggregation::Summary> days{ArenaAllocator<Aggregation::Summary>(arena)};
+    Aggregation::aggregate(series, Aggregation::Window::Day, days);
+    QList<AbstractDailyWeatherForecast> daysList;
+    daysList.reserve(static_cast<int>(days.size()));
+    for (const auto &day : days) {
+        const AbstractHourlyWeatherForecast &hour = hourlyList.at(day.dominant);
+        daysList.append(AbstractDailyWeatherForecast(day.maxTemperature,
+                                                     day.minTemperature,
+                                                     day.precipitation,
+                                                     day.uvIndex,
+                                                     day.humidity,
+                                                     day.pressure,
+                                                     hour.neutralWeatherIcon(),
+                                                     hour.weatherDescription(),
+                                                     day.date()));
     }
 
-    auto forecasts = AbstractWeatherForecast(QDateTime::currentDateTime(), locationId_, latitude_, longitude_, hourlyList, dayCache.values());
-    currentData_ = forecasts;
-    emit updated(forecasts);
+    // 3 hour steps to hourly ones, the days are made from what the backend sent
+    Interpolation::resample(hourlyList, 3600, arena);
+    DerivedQuantities::apply(hourlyList);
+
+    currentData_ = AbstractWeatherForecast(QDateTime::currentDateTime(), locationId_, latitude_, longitude_, hourlyList, daysList);
+    Metrics::instance().record(QStringLiteral("kweather_parse_microseconds"), QStringLiteral("owm"), QString(), parseTimer.nsecsElapsed() / 1000);
+    publish();
 }
 
 void OWMWeatherAPI::update()
@@ -133,9 +262,13 @@ void OWMWeatherAPI::update()
     // don't update if updated recently, and forecast is not empty
     if (!currentData_.dailyForecasts().empty() && !currentData_.hourlyForecasts().empty() &&
         currentData_.timeCreated().secsTo(QDateTime::currentDateTime()) < 300) {
-        emit updated(currentData_);
+        Metrics::instance().increment(QStringLiteral("kweather_cache_hits_total"), QStringLiteral("owm"));
+        publish();
         return;
     }
+    Metrics::instance().increment(QStringLiteral("kweather_cache_misses_total"), QStringLiteral("owm"));
+    if (lastRequestFailed_)
+        Metrics::instance().increment(QStringLiteral("kweather_request_retries_total"), QStringLiteral("owm"));
 
     QUrlQuery query;
     query.addQueryItem(QLatin1String("lat"), QString().setNum(latitude_));
@@ -148,9 +281,14 @@ void OWMWeatherAPI::update()
     url.setHost(QLatin1String("api.openweathermap.org"));
     url.setPath(QLatin1String("/data/2.5/forecast"));
     url.setQuery(query);
-    qDebug() << url;
+    applyServerOverride(url);
+    qCDebug(KWEATHER_LOG) << url;
 
     QNetworkRequest req(url);
     mReply = mManager->get(req);
-    connect(mManager, &QNetworkAccessManager::finished, this, &OWMWeatherAPI::parse);
+    Metrics::instance().trackReply(mReply, QStringLiteral("owm")); // before parse() consumes the body
+    BackendHealthTracker::instance().trackReply(mReply, Kweather::Backend::OWM);
+    Tracing::traceReply(mReply, "fetch forecast", locationId_);
+    QNetworkReply *reply = mReply;
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() { this->parse(reply); });
 }
@@ -8,10 +8,15 @@
 #ifndef OPENWEATHERMAP_H
 #define OPENWEATHERMAP_H
 #include "abstractweatherapi.h"
+#include "arena.h"
 #include "global.h"
 
 #include <QObject>
 
+#include <vector>
+
+template<typename Record> class FieldMap;
+
 using namespace Kweather;
 
 // OpenWeatherMap API Implementation
@@ -25,7 +30,12 @@ public:
     ~OWMWeatherAPI();
 
     void update() override;
+    void parseData(const QByteArray &data) override;
     void applySunriseDataToForecast() override;
+    QString backendName() const override
+    {
+        return QStringLiteral("owm");
+    }
 signals:
     void TokenInvalid();
     void TooManyCalls();
@@ -35,47 +45,16 @@ private slots:
     void parse(QNetworkReply *Reply) override;
 
 private:
-    // map for weather ID to icon
-    const QMap<QString, ResolvedWeatherDesc> apiDescMap = {
-        {"01d", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
-        {"01n", ResolvedWeatherDesc("weather-clear-night", i18n("Clear"))},
-        {"02d", ResolvedWeatherDesc("weather-few-clouds", i18n("Mostly Sunny"))},
-        {"02n", ResolvedWeatherDesc("weather-few-clouds-night", i18n("Mostly Sunny"))},
-        {"03d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
-        {"03n", ResolvedWeatherDesc("weather-clouds-night", i18n("Partly Cloudy"))},
-        {"04d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
-        {"04n", ResolvedWeatherDesc("weather-clouds-night", i18n("Partly Cloudy"))},
-        {"09d", ResolvedWeatherDesc("weather-showers-day", i18n("Rain Showers"))},
-        {"09n", ResolvedWeatherDesc("weather-showers-night", i18n("Rain Showers"))},
-        {"10d", ResolvedWeatherDesc("weather-showers-day", i18n("Rain"))},
-        {"10n", ResolvedWeatherDesc("weather-showers-night", i18n("Rain"))},
-        {"11d", ResolvedWeatherDesc("weather-storm-day", i18n("Thunderstorm"))},
-        {"11n", ResolvedWeatherDesc("weather-storm-night", i18n("Thunderstorm"))},
-        {"13d", ResolvedWeatherDesc("weather-snow-scattered-day", i18n("Snow"))},
-        {"13n", ResolvedWeatherDesc("weather-snow-scattered-night", i18n("Snow"))},
-        {"50d", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
-        {"50n", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
-    };
+    struct Entry;
+    // parse scratch, allocated from MonotonicArena::scratch()
+    using EntryList = std::vector<Entry, ArenaAllocator<Entry>>;
 
-    const QMap<QString, ResolvedWeatherDesc> neutralApiDescMap = {
-        {"01d", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
-        {"01n", ResolvedWeatherDesc("weather-clear", i18n("Clear"))},
-        {"02d", ResolvedWeatherDesc("weather-few-clouds", i18n("Mostly Sunny"))},
-        {"02n", ResolvedWeatherDesc("weather-few-clouds", i18n("Mostly Sunny"))},
-        {"03d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
-        {"03n", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
-        {"04d", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
-        {"04n", ResolvedWeatherDesc("weather-clouds", i18n("Partly Cloudy"))},
-        {"09d", ResolvedWeatherDesc("weather-showers", i18n("Rain Showers"))},
-        {"09n", ResolvedWeatherDesc("weather-showers", i18n("Rain Showers"))},
-        {"10d", ResolvedWeatherDesc("weather-showers", i18n("Rain"))},
-        {"10n", ResolvedWeatherDesc("weather-showers", i18n("Rain"))},
-        {"11d", ResolvedWeatherDesc("weather-storm", i18n("Thunderstorm"))},
-        {"11n", ResolvedWeatherDesc("weather-storm", i18n("Thunderstorm"))},
-        {"13d", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
-        {"13n", ResolvedWeatherDesc("weather-snow", i18n("Snow"))},
-        {"50d", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
-        {"50n", ResolvedWeatherDesc("weather-mist", i18n("Mist"))},
-    };
+    static const FieldMap<Entry> &entryFields();
+    // simdjson or QJsonDocument, status is the "cod" of the reply
+    static void decodeEntries(const QByteArray &data, EntryList &entries, int &status, int &offset);
+
+    // map for weather ID to icon
+    static const QMap<QString, ResolvedWeatherDesc> &apiDescMap();
+    static const QMap<QString, ResolvedWeatherDesc> &neutralApiDescMap();
 };
 #endif // OPENWEATHERMAP_H
@@ -4,100 +4,182 @@
 */
 
 #include "kweather_1x4.h"
-#include <QDBusInterface>
-#include <QDBusReply>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
 #include <QDate>
-#include <QJsonArray>
-#include <QJsonDocument>
 #include <QLocale>
-#include <QXmlStreamReader>
+#include <QSet>
+
+#include <algorithm>
+
+static const QString SERVICE = QStringLiteral("org.kde.kweather");
+static const QString MODEL_INTERFACE = QStringLiteral("org.kde.kweather.LocationModel");
+
 KWeather_1x4::KWeather_1x4(QObject *parent, const QVariantList &args)
     : Plasma::Applet(parent, args)
 {
+    registerKWeatherDBusTypes();
+
     auto system = QLocale::system().measurementSystem();
     if (system == QLocale::MetricSystem || system == QLocale::ImperialUKSystem)
         m_isCelsius = true;
     else
         m_isCelsius = false;
-    QDBusConnection::sessionBus().connect("org.kde.kweather", "/", "org.kde.kweather.LocationModel", "removed", this, SLOT(addCity(QString)));
-    QDBusConnection::sessionBus().connect("org.kde.kweather", "/", "org.kde.kweather.LocationModel", "added", this, SLOT(removeCity(QString)));
-    QDBusInterface *interface = new QDBusInterface("org.kde.kweather", "/locations", "org.freedesktop.DBus.Introspectable", QDBusConnection::sessionBus(), this);
-    QDBusReply<QString> reply = interface->call("Introspect");
-    if (reply.isValid()) {
-        auto xmlMsg = reply.value();
-        QXmlStreamReader xml(xmlMsg);
-        while (!xml.atEnd()) {
-            xml.readNext();
-            if (xml.name() == "node" && xml.attributes().hasAttribute("name"))
-                locationList.append(xml.attributes().value("name").toString());
-        }
-    }
-    if (locationList.size() != 0) {
-        if (locationList.size() > 1)
-            m_isSingleLocation = false;
-        else
-            m_isSingleLocation = true;
-        m_interface = new QDBusInterface("org.kde.kweather", "/locations/" + locationList.first(), "org.kde.kweather.WeatherLocation", QDBusConnection::sessionBus(), this);
-        QDBusConnection::sessionBus().connect("org.kde.kweather", "/locations/" + locationList.first(), "org.kde.kweather.WeatherLocation", "currentForecastChange", this, SLOT(update()));
-
-        QDBusReply<QString> reply = m_interface->call("getWeatherData");
-        this->parse(QJsonDocument::fromJson(reply.value().toUtf8()));
-        this->m_cityName = m_interface->property("name").toString();
-        Q_EMIT locationChanged();
-    }
+    QDBusConnection::sessionBus().connect(SERVICE, "/", MODEL_INTERFACE, "added", this, SLOT(addCity(QString)));
+    QDBusConnection::sessionBus().connect(SERVICE, "/", MODEL_INTERFACE, "removed", this, SLOT(removeCity(QString)));
+    QDBusConnection::sessionBus().connect(SERVICE, "/", MODEL_INTERFACE, "changed", this, SLOT(sync()));
+
     auto today = QDate::currentDate();
     m_currentDate = QDate::currentDate();
     for (int i = 0; i < 4; i++) {
         m_date.append(QLocale::system().standaloneDayName(today.dayOfWeek(), QLocale::ShortFormat));
         today = today.addDays(1);
     }
+
+    // one round trip for the summaries of every location
+    sync();
 }
 
 void KWeather_1x4::addCity(QString id)
 {
-    locationList.append(id);
-    m_isSingleLocation = true;
-    Q_EMIT locationChanged();
+    Q_UNUSED(id)
+    sync();
 }
 
 void KWeather_1x4::removeCity(QString id)
 {
-    locationList.removeOne(id);
-    if (locationList.size() > 1)
-        m_isSingleLocation = false;
-    else
-        m_isSingleLocation = true;
+    Q_UNUSED(id)
+    sync();
+}
+
+void KWeather_1x4::sync()
+{
+    // one at a time, changes announced meanwhile are picked up right after
+    if (m_syncing) {
+        m_syncAgain = true;
+        return;
+    }
+    m_syncing = true;
+    auto msg = QDBusMessage::createMethodCall(SERVICE, "/", MODEL_INTERFACE, "changedSince");
+    msg << m_changeStamp;
+    auto watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+        m_syncing = false;
+        const QDBusMessage reply = watcher->reply();
+        if (reply.type() == QDBusMessage::ReplyMessage && reply.arguments().count() == 4)
+            applyChanges(reply);
+        if (m_syncAgain) {
+            m_syncAgain = false;
+            sync();
+        }
+    });
+}
+
+void KWeather_1x4::applyChanges(const QDBusMessage &reply)
+{
+    const auto changed = qdbus_cast<QList<LocationSummary>>(reply.arguments().at(0));
+    auto removed = qdbus_cast<QStringList>(reply.arguments().at(1));
+    m_changeStamp = qdbus_cast<quint64>(reply.arguments().at(2));
+    if (qdbus_cast<bool>(reply.arguments().at(3))) {
+        // every location is listed, the ones missing are gone
+        QSet<QString> listed;
+        for (const auto &summary : changed)
+            listed.insert(summary.locationId);
+        for (const auto &id : qAsConst(locationList)) {
+            if (!listed.contains(id))
+                removed.append(id);
+        }
+    }
+
+    const QString current = locationList.isEmpty() ? QString() : locationList.at(m_currentLocationIndex);
+    bool currentChanged = false;
+    for (const auto &id : removed) {
+        locationList.removeOne(id);
+        m_summaries.remove(id);
+        currentChanged |= id == current;
+    }
+    for (const auto &summary : changed) {
+        if (!m_summaries.contains(summary.locationId))
+            locationList.append(summary.locationId);
+        m_summaries[summary.locationId] = summary;
+        currentChanged |= summary.locationId == current;
+    }
+
+    // locations may have come and gone, keep showing the same one if it is still there
+    if (!removed.isEmpty() || current.isEmpty()) {
+        m_currentLocationIndex = std::max(0, locationList.indexOf(current));
+        currentChanged = true;
+    }
+    m_currentLocationIndex = std::min(m_currentLocationIndex, std::max(0, locationList.size() - 1));
+    const bool single = locationList.size() <= 1;
+    const bool singleChanged = single != m_isSingleLocation;
+    m_isSingleLocation = single;
+    if (currentChanged && !locationList.isEmpty())
+        showCurrentLocation();
+    else if (singleChanged)
+        Q_EMIT locationChanged(); // whether the widget cycles
+}
+
+void KWeather_1x4::requestDays(const QString &locationID, int days)
+{
+    auto msg = QDBusMessage::createMethodCall(SERVICE, "/locations/" + locationID, "org.kde.kweather.WeatherLocation", "daySummaries");
+    msg << days;
+    auto watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, locationID](QDBusPendingCallWatcher *watcher) {
+        watcher->deleteLater();
+        QDBusPendingReply<QList<DaySummary>> reply = *watcher;
+        // the widget may have moved on to another location meanwhile
+        if (locationList.isEmpty() || locationList.at(m_currentLocationIndex) != locationID)
+            return;
+        updateDays(reply.isValid() ? reply.value() : QList<DaySummary>());
+    });
+}
+
+void KWeather_1x4::showCurrentLocation()
+{
+    if (locationList.isEmpty())
+        return;
+
+    const auto &summary = m_summaries[locationList.at(m_currentLocationIndex)];
+    m_cityName = summary.locationName;
+    updateCurrentConditions(summary);
+    requestDays(summary.locationId, 4);
     Q_EMIT locationChanged();
+}
 
-    m_currentLocationIndex = -1; // so next call will fetch location 0
-    this->nextLocation();
+void KWeather_1x4::updateCurrentConditions(const LocationSummary &location)
+{
+    m_description = location.weatherDescription;
+    if (m_isCelsius)
+        m_tempNow = QString::number(location.temperature) + "°C";
+    else
+        m_tempNow = QString::number(location.temperature * 1.8 + 32) + "°";
 }
 
-void KWeather_1x4::parse(QJsonDocument doc)
+void KWeather_1x4::updateDays(const QList<DaySummary> &days)
 {
     m_forecast.clear();
     m_maxMinTemp.clear();
-    QJsonArray array = doc["dailyForecasts"].toArray();
-    QJsonArray hourly = doc["hourlyForecasts"].toArray();
-    m_description = hourly.at(0).toObject()["weatherDescription"].toString();
-    if (m_isCelsius)
-        m_tempNow = QString::number(hourly.at(0).toObject()["temperature"].toDouble()) + "°C";
-    else
-        m_tempNow = QString::number(hourly.at(0).toObject()["temperature"].toDouble() * 1.8 + 32) + "°";
-    int i = 0;
-    for (auto days : array) {
-        if (i++ >= 4)
-            break;
-        m_forecast.append(days.toObject()["weatherIcon"].toString());
+    for (const auto &d : days) {
+        m_forecast.append(d.weatherIcon);
         if (m_isCelsius)
-            m_maxMinTemp.append(QString::number(static_cast<int>(days.toObject()["maxTemp"].toDouble())) + "°C/" + QString::number(static_cast<int>(days.toObject()["minTemp"].toDouble())) + "°C");
+            m_maxMinTemp.append(QString::number(static_cast<int>(d.maxTemp)) + "°C/" + QString::number(static_cast<int>(d.minTemp)) + "°C");
         else
-            m_maxMinTemp.append(QString::number(static_cast<int>(days.toObject()["maxTemp"].toDouble() * 1.8 + 32)) + "°/" + QString::number(static_cast<int>(days.toObject()["minTemp"].toDouble() * 1.8 + 32)) + "°");
+            m_maxMinTemp.append(QString::number(static_cast<int>(d.maxTemp * 1.8 + 32)) + "°/" + QString::number(static_cast<int>(d.minTemp * 1.8 + 32)) + "°");
     }
     Q_EMIT dataUpdated();
+    updateDate();
+}
+
+void KWeather_1x4::updateDate()
+{
     if (m_currentDate.daysTo(QDate::currentDate()) >= 1) {
         auto today = QDate::currentDate();
         m_currentDate = QDate::currentDate();
+        m_date.clear();
         for (int i = 0; i < 4; i++) {
             m_date.append(QLocale::system().standaloneDayName(today.dayOfWeek(), QLocale::ShortFormat));
             today = today.addDays(1);
@@ -106,29 +188,17 @@ void KWeather_1x4::parse(QJsonDocument doc)
     }
 }
 
-void KWeather_1x4::update()
-{
-    QDBusReply<QString> reply = m_interface->call("getWeatherData");
-    this->parse(QJsonDocument::fromJson(reply.value().toUtf8()));
-}
-
 void KWeather_1x4::nextLocation()
 {
+    if (locationList.isEmpty())
+        return;
+
     m_currentLocationIndex++;
     if (m_currentLocationIndex >= locationList.count())
         m_currentLocationIndex = 0;
 
-    auto oldInterface = m_interface;
-
-    m_interface = new QDBusInterface("org.kde.kweather", "/locations/" + locationList.at(m_currentLocationIndex), "org.kde.kweather.WeatherLocation", QDBusConnection::sessionBus(), this);
-    QDBusConnection::sessionBus().connect("org.kde.kweather", "/locations/" + locationList.at(m_currentLocationIndex), "org.kde.kweather.WeatherLocation", "currentForecastChange", this, SLOT(update()));
-
-    QDBusReply<QString> reply = m_interface->call("getWeatherData");
-    this->parse(QJsonDocument::fromJson(reply.value().toUtf8()));
-    this->m_cityName = m_interface->property("name").toString();
-    Q_EMIT locationChanged();
-
-    delete oldInterface;
+    // summaries are already cached, only the day strip needs a call
+    showCurrentLocation();
 }
 K_EXPORT_PLASMA_APPLET_WITH_JSON(kweather_1x4, KWeather_1x4, "metadata.json")
 
@@ -5,9 +5,12 @@
 
 #ifndef KWEATHER_1X4_H
 #define KWEATHER_1X4_H
+#include "../dbustypes.h"
+
 #include <Plasma/Applet>
 #include <QAbstractListModel>
-class QDBusInterface;
+#include <QHash>
+class QDBusMessage;
 class KWeather_1x4 : public Plasma::Applet
 {
     Q_OBJECT
@@ -56,12 +59,15 @@ signals:
 private slots:
     void addCity(QString locationID);
     void removeCity(QString locationID);
-    void update();
+    void sync(); // fetch everything that changed since m_changeStamp
 
 private:
-    QDBusInterface *m_interface;
-
-    void parse(QJsonDocument);
+    void applyChanges(const QDBusMessage &reply); // of changedSince
+    void requestDays(const QString &locationID, int days);
+    void showCurrentLocation();
+    void updateCurrentConditions(const LocationSummary &location);
+    void updateDays(const QList<DaySummary> &days);
+    void updateDate();
 
     QStringList m_date;
     QStringList m_forecast;
@@ -70,10 +76,14 @@ private:
     QString m_description;
     QString m_tempNow;
     QList<QString> locationList;
+    QHash<QString, LocationSummary> m_summaries;
+    quint64 m_changeStamp = 0;
+    bool m_syncing = false;
+    bool m_syncAgain = false;
 
     int m_currentLocationIndex = 0;
     bool m_isCelsius;
-    bool m_isSingleLocation;
+    bool m_isSingleLocation = true;
     QDate m_currentDate;
 };
 
@@ -201,7 +201,7 @@ Kirigami.ScrollablePage {
         Control {
             id: tempChartCard
             Layout.fillWidth: true
-            implicitHeight: Math.round(Kirigami.Units.gridUnit * 8.5)
+            implicitHeight: Math.round(Kirigami.Units.gridUnit * 11)
             
             background: Kirigami.ShadowedRectangle {
                 color: weatherLocation.cardBackgroundColor
@@ -224,14 +224,34 @@ Kirigami.ScrollablePage {
                 ColumnLayout {
                     id: chartChild
                     spacing: Kirigami.Units.largeSpacing * 2
+
+                    // zoom, the model picks as many points as fit
+                    RowLayout {
+                        Layout.leftMargin: Kirigami.Units.largeSpacing * 2
+                        Layout.topMargin: Kirigami.Units.largeSpacing
+                        ToolButton {
+                            text: i18n("24 Hours")
+                            checkable: true
+                            autoExclusive: true
+                            checked: weatherLocation.chartModel.hours === 24
+                            onClicked: weatherLocation.chartModel.hours = 24
+                        }
+                        ToolButton {
+                            text: i18n("All Days")
+                            checkable: true
+                            autoExclusive: true
+                            checked: weatherLocation.chartModel.hours === 0
+                            onClicked: weatherLocation.chartModel.hours = 0
+                        }
+                    }
+
                     Charts.LineChart {
                         id: tempChart
                         Layout.leftMargin: Kirigami.Units.largeSpacing * 2
                         Layout.rightMargin: Kirigami.Units.largeSpacing * 2
-                        Layout.topMargin: Kirigami.Units.largeSpacing
                         Layout.preferredHeight: Kirigami.Units.gridUnit * 5
                         Layout.preferredWidth: tempChartCard.width > Kirigami.Units.gridUnit * 28 ? tempChartCard.width : Kirigami.Units.gridUnit * 28
-                        nameSource: Charts.SingleValueSource  { value: i18n("MaxTemperature") }
+                        nameSource: Charts.SingleValueSource  { value: i18n("Temperature") }
                         lineWidth: Kirigami.Settings.isMobile ? 0.5 : 1
                         smooth: true
                         pointDelegate: Label {
@@ -240,9 +260,10 @@ Kirigami.ScrollablePage {
                         }
 
                         valueSources: [
-                            Charts.ArraySource {
+                            Charts.ModelSource {
                                 id: tempSource
-                                array: weatherLocation.maxTempList
+                                model: weatherLocation.chartModel
+                                roleName: "temperature"
                             }
                         ]
 
@@ -253,6 +274,12 @@ Kirigami.ScrollablePage {
                             value: weatherLocation.backgroundColor
                         }
                     }
+                    Binding {
+                        // room for the value labels of the points
+                        target: weatherLocation.chartModel
+                        property: "maximumPoints"
+                        value: Math.max(2, Math.floor(tempChart.width / (Kirigami.Units.gridUnit * 2)))
+                    }
                     Charts.AxisLabels {
                         Layout.fillWidth: true
                         Layout.leftMargin: Kirigami.Units.smallSpacing
@@ -261,8 +288,9 @@ Kirigami.ScrollablePage {
                             color: weatherLocation.textColor
                             text: Charts.AxisLabels.label
                         }
-                        source: Charts.ArraySource {
-                            array: weatherLocation.xAxisList
+                        source: Charts.ModelSource {
+                            model: weatherLocation.chartModel
+                            roleName: "label"
                         }
                     }
                 }
@@ -147,12 +147,12 @@ Kirigami.ScrollablePage {
 
         contentItem: ScrollView {
             ListView {
-                model: [i18nc("Norway Meteorologisk Institutt","Norway Meteorologisk Institutt"), i18nc("OpenWeatherMap","OpenWeatherMap")]
+                model: [i18nc("Norway Meteorologisk Institutt","Norway Meteorologisk Institutt"), i18nc("OpenWeatherMap","OpenWeatherMap"), i18nc("Both backends blended into one forecast","Blended")]
                 delegate: RadioDelegate {
                     width: parent.width
                     text: modelData
                     checked: selectBackend.mBackend === modelData
-                    enabled: !(modelData == "OpenWeatherMap") || (settingsModel.OWMToken.length != 0)
+                    enabled: !(modelData == "OpenWeatherMap" || modelData == "Blended") || (settingsModel.OWMToken.length != 0)
                     onCheckedChanged: {
                         if (checked) {
                             selectBackend.mBackend = modelData
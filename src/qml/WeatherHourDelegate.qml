@@ -39,6 +39,10 @@ Rectangle {
             font.pointSize: Kirigami.Theme.defaultFont.pointSize * 1.3
             color: textColor
         }
+        Label {
+            color: settingsModel.forecastStyle === "Dynamic" ? KWeatherStyle.disabledTextColor : Kirigami.Theme.disabledTextColor
+            text: i18n("Feels like %1", weather.apparentTemperature)
+        }
         Label {
             text: weather.weatherDescription
             color: textColor
@@ -69,7 +73,7 @@ Rectangle {
             }
             Label {
                 color: settingsModel.forecastStyle === "Dynamic" ? KWeatherStyle.disabledTextColor : Kirigami.Theme.disabledTextColor
-                text: weather.windSpeed
+                text: i18n("%1 %2", weather.windSpeed, weather.windSector)
             }
         }
 
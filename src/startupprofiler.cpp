@@ -0,0 +1,72 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "startupprofiler.h"
+#include "tracing.h"
+
+#include <QElapsedTimer>
+#include <QVector>
+
+namespace
+{
+struct Phase {
+    const char *name;
+    qint64 end; // µs since the first mark
+};
+
+struct Profile {
+    Profile()
+    {
+        clock.start();
+    }
+    QElapsedTimer clock;
+    QVector<Phase> phases;
+    bool finished = false;
+};
+
+Profile &profile()
+{
+    static Profile p;
+    return p;
+}
+}
+
+void StartupProfiler::mark(const char *phase)
+{
+    auto &p = profile();
+    if (p.finished)
+        return;
+    p.phases.append({phase, p.clock.nsecsElapsed() / 1000});
+    Tracing::instant(phase);
+}
+
+void StartupProfiler::finish()
+{
+    profile().finished = true;
+}
+
+bool StartupProfiler::isFinished()
+{
+    return profile().finished;
+}
+
+QString StartupProfiler::report()
+{
+    const auto &p = profile();
+    QString ret;
+    qint64 previous = 0;
+    for (const auto &phase : p.phases) {
+        ret += QStringLiteral("%1 %2 ms (+%3 ms)\n")
+                   .arg(QString::fromLatin1(phase.name), -32)
+                   .arg(phase.end / 1000.0, 8, 'f', 1)
+                   .arg((phase.end - previous) / 1000.0, 0, 'f', 1);
+        previous = phase.end;
+    }
+    if (!p.finished)
+        ret += QStringLiteral("(startup still in progress)\n");
+    return ret;
+}
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_STARTUPPROFILER_H
+#define KWEATHER_STARTUPPROFILER_H
+
+#include <QString>
+
+// Wall clock time of the startup phases, from main() until the first frame (or until
+// the daemon is ready). Reported with --startup-profile, on D-Bus and on the socket.
+// Phase names must be string literals.
+namespace StartupProfiler
+{
+void mark(const char *phase); // the phase that just ended
+void finish(); // startup is over, later marks are ignored
+bool isFinished();
+QString report();
+}
+
+#endif // KWEATHER_STARTUPPROFILER_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "timestamp.h"
+
+namespace Timestamp
+{
+// Howard Hinnant's days_from_civil, exact for every gregorian date
+qint64 daysFromCivil(int year, int month, int day)
+{
+    const qint64 y = year - (month <= 2);
+    const qint64 era = (y >= 0 ? y : y - 399) / 400;
+    const qint64 yoe = y - era * 400;
+    const qint64 doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const qint64 doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int daysInMonth(int year, int month)
+{
+    static const int days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    return month == 2 && leap ? 29 : days[month - 1];
+}
+
+// -1 unless text[pos, pos + count) are all ascii digits
+static int digits(QStringView text, int pos, int count)
+{
+    int value = 0;
+    for (int i = pos; i < pos + count; i++) {
+        const ushort c = text[i].unicode();
+        if (c < '0' || c > '9')
+            return -1;
+        value = value * 10 + (c - '0');
+    }
+    return value;
+}
+
+bool decode(QStringView text, qint64 &wallSecs, Suffix &suffix, int &offsetSecs)
+{
+    if (text.size() < 19 || text[4] != QLatin1Char('-') || text[7] != QLatin1Char('-') || (text[10] != QLatin1Char('T') && text[10] != QLatin1Char(' '))
+        || text[13] != QLatin1Char(':') || text[16] != QLatin1Char(':'))
+        return false;
+
+    const int year = digits(text, 0, 4), month = digits(text, 5, 2), day = digits(text, 8, 2);
+    const int hour = digits(text, 11, 2), minute = digits(text, 14, 2), second = digits(text, 17, 2);
+    if (year < 0 || month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month) || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 59)
+        return false;
+
+    // fractions of a second are dropped, nothing we show has that resolution
+    int pos = 19;
+    if (pos < text.size() && (text[pos] == QLatin1Char('.') || text[pos] == QLatin1Char(','))) {
+        pos++;
+        while (pos < text.size() && text[pos].isDigit())
+            pos++;
+    }
+
+    if (pos == text.size()) {
+        suffix = None;
+        offsetSecs = 0;
+    } else if (pos + 1 == text.size() && text[pos] == QLatin1Char('Z')) {
+        suffix = Utc;
+        offsetSecs = 0;
+    } else if (pos + 6 == text.size() && (text[pos] == QLatin1Char('+') || text[pos] == QLatin1Char('-')) && text[pos + 3] == QLatin1Char(':')) {
+        const int hours = digits(text, pos + 1, 2), minutes = digits(text, pos + 4, 2);
+        if (hours < 0 || hours > 14 || minutes < 0 || minutes > 59)
+            return false;
+        suffix = Offset;
+        offsetSecs = (hours * 3600 + minutes * 60) * (text[pos] == QLatin1Char('-') ? -1 : 1);
+    } else {
+        return false;
+    }
+
+    wallSecs = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+bool toEpoch(QStringView text, qint64 &utcSecs)
+{
+    qint64 wallSecs;
+    Suffix suffix;
+    int offsetSecs;
+    if (!decode(text, wallSecs, suffix, offsetSecs))
+        return false;
+    utcSecs = wallSecs - offsetSecs;
+    return true;
+}
+
+QDateTime toDateTime(QStringView text)
+{
+    qint64 wallSecs;
+    Suffix suffix;
+    int offsetSecs;
+    if (!decode(text, wallSecs, suffix, offsetSecs))
+        return text.isEmpty() ? QDateTime() : QDateTime::fromString(text.toString(), Qt::ISODate);
+
+    switch (suffix) {
+    case Utc:
+        return QDateTime::fromSecsSinceEpoch(wallSecs, Qt::UTC);
+    case Offset:
+        return QDateTime::fromSecsSinceEpoch(wallSecs - offsetSecs, Qt::OffsetFromUTC, offsetSecs);
+    default:
+        break;
+    }
+    // no suffix means local time, as the qt parser reads it
+    const qint64 days = wallSecs >= 0 ? wallSecs / 86400 : (wallSecs - 86399) / 86400;
+    return QDateTime(QDate::fromJulianDay(days + 2440588), QTime::fromMSecsSinceStartOfDay((wallSecs - days * 86400) * 1000));
+}
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_TIMESTAMP_H
+#define KWEATHER_TIMESTAMP_H
+
+#include <QDateTime>
+#include <QStringView>
+
+// Decoder for the one timestamp layout our backends and our cache use,
+// "YYYY-MM-DDTHH:MM:SS" with optional fraction and an optional "Z" or "±HH:MM".
+// Reads the digits in place, no allocation and no QDateTime parser involved.
+namespace Timestamp
+{
+enum Suffix { None, Utc, Offset };
+
+// days since 1970-01-01 of a proleptic gregorian date
+qint64 daysFromCivil(int year, int month, int day);
+
+// wallSecs are the fields read as if they were UTC, offsetSecs is set for Suffix::Offset
+bool decode(QStringView text, qint64 &wallSecs, Suffix &suffix, int &offsetSecs);
+
+// seconds since epoch, a timestamp without suffix counts as UTC
+bool toEpoch(QStringView text, qint64 &utcSecs);
+
+// same result as QDateTime::fromString(text, Qt::ISODate), which it falls back to
+// for anything not in the layout above
+QDateTime toDateTime(QStringView text);
+}
+
+#endif // KWEATHER_TIMESTAMP_H
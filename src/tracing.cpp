@@ -0,0 +1,169 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "tracing.h"
+#include "kweather_trace_debug.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QNetworkReply>
+#include <QVector>
+
+namespace
+{
+struct TraceEvent {
+    const char *name;
+    char phase; // 'X' complete, 'i' instant, 'b'/'e' async begin/end
+    qint64 ts;
+    qint64 dur;
+    quintptr id; // pairs async events
+    QString locationId;
+};
+
+// a refresh storm of a few hundred locations stays well below this
+constexpr int MAX_EVENTS = 1 << 20;
+
+struct Recorder {
+    Recorder()
+        : fileName(qEnvironmentVariable("KWEATHER_TRACE_FILE"))
+    {
+        clock.start();
+        if (!fileName.isEmpty())
+            qAddPostRoutine([] { Tracing::writeChromeJson(recorder().fileName); });
+    }
+
+    static Recorder &recorder()
+    {
+        static Recorder r;
+        return r;
+    }
+
+    void add(TraceEvent event)
+    {
+        if (fileName.isEmpty())
+            return;
+        QMutexLocker lock(&mutex);
+        if (events.size() < MAX_EVENTS)
+            events.append(std::move(event));
+    }
+
+    QElapsedTimer clock;
+    QString fileName;
+    QMutex mutex;
+    QVector<TraceEvent> events;
+};
+}
+
+bool Tracing::isEnabled()
+{
+    return !Recorder::recorder().fileName.isEmpty() || KWEATHER_TRACE().isDebugEnabled();
+}
+
+qint64 Tracing::now()
+{
+    return Recorder::recorder().clock.nsecsElapsed() / 1000;
+}
+
+void Tracing::instant(const char *name, const QString &locationId)
+{
+    if (!isEnabled())
+        return;
+    qCDebug(KWEATHER_TRACE) << name << locationId;
+    Recorder::recorder().add({name, 'i', now(), 0, 0, locationId});
+}
+
+void Tracing::complete(const char *name, const QString &locationId, qint64 start)
+{
+    if (!isEnabled())
+        return;
+    const qint64 end = now();
+    qCDebug(KWEATHER_TRACE) << name << locationId << (end - start) << "µs";
+    Recorder::recorder().add({name, 'X', start, end - start, 0, locationId});
+}
+
+void Tracing::traceReply(QNetworkReply *reply, const char *name, const QString &locationId)
+{
+    if (!isEnabled())
+        return;
+
+    // the request overlaps other work of the location, so it goes on an async track
+    const quintptr id = reinterpret_cast<quintptr>(reply);
+    const qint64 queued = now();
+    qCDebug(KWEATHER_TRACE) << name << locationId << "queued" << reply->url();
+    Recorder::recorder().add({name, 'b', queued, 0, id, locationId});
+
+    QObject::connect(reply, &QNetworkReply::metaDataChanged, reply, [locationId, id] {
+        Recorder::recorder().add({"first byte", 'i', now(), 0, id, locationId});
+    });
+    QObject::connect(reply, &QNetworkReply::finished, reply, [name, locationId, id, queued] {
+        const qint64 end = now();
+        qCDebug(KWEATHER_TRACE) << name << locationId << "last byte after" << (end - queued) << "µs";
+        Recorder::recorder().add({name, 'e', end, 0, id, locationId});
+    });
+}
+
+QByteArray Tracing::toChromeJson()
+{
+    auto &recorder = Recorder::recorder();
+    QMutexLocker lock(&recorder.mutex);
+
+    const qint64 pid = QCoreApplication::applicationPid();
+    QHash<QString, int> tracks; // one per location, 0 for events without one
+    QJsonArray events;
+
+    for (const auto &event : qAsConst(recorder.events)) {
+        auto track = tracks.find(event.locationId);
+        if (track == tracks.end()) {
+            track = tracks.insert(event.locationId, event.locationId.isEmpty() ? 0 : tracks.size() + 1);
+            QJsonObject meta;
+            meta["name"] = QStringLiteral("thread_name");
+            meta["ph"] = QStringLiteral("M");
+            meta["pid"] = pid;
+            meta["tid"] = track.value();
+            meta["args"] = QJsonObject{{"name", event.locationId.isEmpty() ? QStringLiteral("kweather") : event.locationId}};
+            events.append(meta);
+        }
+
+        QJsonObject obj;
+        obj["name"] = QString::fromLatin1(event.name);
+        obj["cat"] = QStringLiteral("kweather");
+        obj["ph"] = QString(QLatin1Char(event.phase));
+        obj["ts"] = event.ts;
+        obj["pid"] = pid;
+        obj["tid"] = track.value();
+        if (event.phase == 'X')
+            obj["dur"] = event.dur;
+        if (event.phase == 'i')
+            obj["s"] = QStringLiteral("t");
+        if (event.phase == 'b' || event.phase == 'e')
+            obj["id"] = QString::number(event.id, 16);
+        obj["args"] = QJsonObject{{"location", event.locationId}};
+        events.append(obj);
+    }
+
+    QJsonObject root;
+    root["traceEvents"] = events;
+    root["displayTimeUnit"] = QStringLiteral("ms");
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool Tracing::writeChromeJson(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qCWarning(KWEATHER_TRACE) << "unable to write trace to" << fileName << file.errorString();
+        return false;
+    }
+    file.write(toChromeJson());
+    return true;
+}
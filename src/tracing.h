@@ -0,0 +1,62 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_TRACING_H
+#define KWEATHER_TRACING_H
+
+#include <QString>
+
+class QNetworkReply;
+
+/*
+ * Timing spans for the refresh path (fetch, parse, apply, render), tagged with the
+ * location id. Every span is logged to the org.kde.kweather.trace category; with
+ * KWEATHER_TRACE_FILE set the events are also kept and written on exit in Chrome
+ * trace-event format (chrome://tracing, ui.perfetto.dev), one track per location.
+ *
+ * Event names must be string literals, only the pointer is stored.
+ */
+namespace Tracing
+{
+bool isEnabled();
+qint64 now(); // µs since the first event
+
+void instant(const char *name, const QString &locationId = QString());
+void complete(const char *name, const QString &locationId, qint64 start); // span from start until now
+
+// request queued, first byte and last byte of a network request
+void traceReply(QNetworkReply *reply, const char *name, const QString &locationId = QString());
+
+QByteArray toChromeJson();
+bool writeChromeJson(const QString &fileName);
+}
+
+// times its own scope
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, const QString &locationId = QString())
+        : m_name(name)
+        , m_locationId(locationId)
+        , m_start(Tracing::isEnabled() ? Tracing::now() : -1)
+    {
+    }
+    ~TraceSpan()
+    {
+        if (m_start >= 0)
+            Tracing::complete(m_name, m_locationId, m_start);
+    }
+
+private:
+    Q_DISABLE_COPY(TraceSpan)
+
+    const char *m_name;
+    QString m_locationId;
+    qint64 m_start;
+};
+
+#endif // KWEATHER_TRACING_H
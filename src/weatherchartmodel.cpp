@@ -0,0 +1,191 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "weatherchartmodel.h"
+#include "abstractweatherforecast.h"
+#include "tracing.h"
+#include "weatherlocation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <utility>
+
+WeatherChartModel::WeatherChartModel(WeatherLocation *location)
+{
+    if (location)
+        connect(location, &WeatherLocation::weatherRefresh, this, &WeatherChartModel::refreshFromForecast);
+}
+
+int WeatherChartModel::rowCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent);
+    return rows_.size();
+}
+
+QVariant WeatherChartModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= rows_.size())
+        return {};
+    const int i = rows_.at(index.row());
+    switch (role) {
+    case DateRole:
+        return QDateTime::fromSecsSinceEpoch(times_.at(i), Qt::OffsetFromUTC, offsets_.at(i));
+    case LabelRole: {
+        const QDateTime date = QDateTime::fromSecsSinceEpoch(times_.at(i), Qt::OffsetFromUTC, offsets_.at(i));
+        if (hours_ > 0 && hours_ <= 48)
+            return locale_.toString(date.time(), QLocale::ShortFormat);
+        // the weekday once, at the first point of every day
+        if (index.row() > 0) {
+            const int previous = rows_.at(index.row() - 1);
+            if (QDateTime::fromSecsSinceEpoch(times_.at(previous), Qt::OffsetFromUTC, offsets_.at(previous)).date() == date.date())
+                return QString();
+        }
+        return locale_.toString(date.date(), QStringLiteral("ddd"));
+    }
+    case TemperatureRole:
+        return temperature_.at(i);
+    case PrecipitationRole:
+        return precipitationTotals_.at(index.row());
+    case WindSpeedRole:
+        return windSpeed_.at(windSpeedRows_.at(index.row()));
+    case PressureRole:
+        return pressure_.at(pressureRows_.at(index.row()));
+    }
+    return {};
+}
+
+QHash<int, QByteArray> WeatherChartModel::roleNames() const
+{
+    return {{DateRole, "date"},
+            {LabelRole, "label"},
+            {TemperatureRole, "temperature"},
+            {PrecipitationRole, "precipitation"},
+            {WindSpeedRole, "windSpeed"},
+            {PressureRole, "pressure"}};
+}
+
+void WeatherChartModel::setHours(int hours)
+{
+    if (hours == hours_)
+        return;
+    hours_ = hours;
+    selectRows();
+    emit hoursChanged();
+}
+
+void WeatherChartModel::setMaximumPoints(int maximumPoints)
+{
+    if (maximumPoints == maximumPoints_)
+        return;
+    maximumPoints_ = maximumPoints;
+    selectRows();
+    emit maximumPointsChanged();
+}
+
+void WeatherChartModel::refreshFromForecast(AbstractWeatherForecast &forecast)
+{
+    TraceSpan span("chart model refresh", forecast.locationId());
+    const auto &hours = forecast.hourlyForecasts();
+    for (auto column : {&hoursFromStart_, &temperature_, &precipitation_, &windSpeed_, &pressure_})
+        column->resize(hours.size());
+    times_.resize(hours.size());
+    offsets_.resize(hours.size());
+    const qint64 start = hours.isEmpty() ? 0 : hours.first().date().toSecsSinceEpoch();
+    for (int i = 0; i < hours.size(); i++) {
+        const auto &hour = hours.at(i);
+        times_[i] = hour.date().toSecsSinceEpoch();
+        offsets_[i] = hour.date().offsetFromUtc();
+        hoursFromStart_[i] = (times_[i] - start) / 3600.0f;
+        temperature_[i] = hour.temperature();
+        precipitation_[i] = hour.precipitationAmount();
+        windSpeed_[i] = hour.windSpeed();
+        pressure_[i] = hour.pressure();
+    }
+    locale_ = QLocale::system(); // once per refresh, not per label
+    selectRows();
+}
+
+void WeatherChartModel::selectRows()
+{
+    int n = times_.size();
+    if (hours_ > 0)
+        n = std::lower_bound(hoursFromStart_.constBegin(), hoursFromStart_.constEnd(), static_cast<float>(hours_)) - hoursFromStart_.constBegin();
+
+    beginResetModel();
+    // the buckets only depend on n and maximumPoints, every series has the same rows
+    for (auto series : {std::make_pair(&rows_, &temperature_), std::make_pair(&windSpeedRows_, &windSpeed_), std::make_pair(&pressureRows_, &pressure_)}) {
+        series.first->resize(n);
+        series.first->resize(downsample(hoursFromStart_.constData(), series.second->constData(), n, maximumPoints_, series.first->data()));
+    }
+    // the rain of every hour of the bucket, a maximum or one picked hour would lose most of it
+    precipitationTotals_.resize(rows_.size());
+    for (int row = 0; row < rows_.size(); row++) {
+        const int end = bucketStart(row + 1, n, maximumPoints_);
+        precipitationTotals_[row] = std::accumulate(precipitation_.constBegin() + bucketStart(row, n, maximumPoints_), precipitation_.constBegin() + end, 0.0f);
+    }
+    endResetModel();
+}
+
+int WeatherChartModel::bucketStart(int bucket, int n, int threshold)
+{
+    if (threshold >= n || threshold < 3)
+        return std::min(bucket, n);
+    // the first and the last point have a bucket of their own
+    if (bucket <= 0)
+        return 0;
+    if (bucket >= threshold)
+        return n;
+    if (bucket == threshold - 1)
+        return n - 1;
+    const double every = static_cast<double>(n - 2) / (threshold - 2);
+    return static_cast<int>(std::floor((bucket - 1) * every)) + 1;
+}
+
+int WeatherChartModel::downsample(const float *x, const float *y, int n, int threshold, int *selected)
+{
+    if (threshold >= n || threshold < 3) {
+        for (int i = 0; i < n; i++)
+            selected[i] = i;
+        return n;
+    }
+
+    // the first and last point stay, the others are split into threshold - 2 buckets;
+    // from each the point making the largest triangle with the one picked before it
+    // and the average of the next bucket
+    const double every = static_cast<double>(n - 2) / (threshold - 2);
+    int count = 0;
+    int a = 0;
+    selected[count++] = a;
+    for (int bucket = 0; bucket < threshold - 2; bucket++) {
+        const int nextStart = static_cast<int>(std::floor((bucket + 1) * every)) + 1;
+        const int nextEnd = std::min(static_cast<int>(std::floor((bucket + 2) * every)) + 1, n);
+        float averageX = 0, averageY = 0;
+        for (int i = nextStart; i < nextEnd; i++) {
+            averageX += x[i];
+            averageY += y[i];
+        }
+        averageX /= nextEnd - nextStart;
+        averageY /= nextEnd - nextStart;
+
+        const int start = static_cast<int>(std::floor(bucket * every)) + 1;
+        const int end = nextStart;
+        float largest = -1;
+        int picked = start;
+        for (int i = start; i < end; i++) {
+            const float area = std::abs((x[a] - averageX) * (y[i] - y[a]) - (x[a] - x[i]) * (averageY - y[a]));
+            if (area > largest) {
+                largest = area;
+                picked = i;
+            }
+        }
+        selected[count++] = picked;
+        a = picked;
+    }
+    selected[count++] = n - 1;
+    return count;
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef WEATHERCHARTMODEL_H
+#define WEATHERCHARTMODEL_H
+
+#include <QAbstractListModel>
+#include <QLocale>
+#include <QVector>
+
+class AbstractWeatherForecast;
+class WeatherLocation;
+
+// Hourly temperature, precipitation, wind speed and pressure for the charts, read
+// through KQuickCharts' ModelSource. The series are kept in plain arrays; rows
+// are only indices into them so that a chart never gets more points than it has
+// room for. The hours are split into the same buckets for every series, one row
+// each; temperature, wind speed and pressure each pick their own point of the
+// bucket by largest triangle three buckets, precipitation is the bucket's total.
+// Changing hours or maximumPoints only picks the rows again.
+class WeatherChartModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int hours READ hours WRITE setHours NOTIFY hoursChanged) // 0 for the whole forecast
+    Q_PROPERTY(int maximumPoints READ maximumPoints WRITE setMaximumPoints NOTIFY maximumPointsChanged)
+
+public:
+    explicit WeatherChartModel(WeatherLocation *location = nullptr);
+
+    enum Roles {
+        DateRole = Qt::UserRole,
+        LabelRole, // for axis labels, the time for a day or two, the weekday where a day starts beyond
+        TemperatureRole, // celsius
+        PrecipitationRole, // mm
+        WindSpeedRole, // m/s
+        PressureRole, // hPa
+    };
+
+    int rowCount(const QModelIndex &parent) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int hours() const
+    {
+        return hours_;
+    }
+    void setHours(int hours);
+    int maximumPoints() const
+    {
+        return maximumPoints_;
+    }
+    void setMaximumPoints(int maximumPoints);
+
+    // picks at most threshold of the n points (x, y) that keep the shape of the
+    // line, always the first and the last; returns how many, indices ascending.
+    // The i-th one picked lies in [bucketStart(i), bucketStart(i + 1)).
+    static int downsample(const float *x, const float *y, int n, int threshold, int *selected);
+    static int bucketStart(int bucket, int n, int threshold);
+
+public slots:
+    void refreshFromForecast(AbstractWeatherForecast &forecast);
+
+signals:
+    void hoursChanged();
+    void maximumPointsChanged();
+
+private:
+    void selectRows();
+
+    QVector<qint64> times_; // secs since epoch
+    QVector<int> offsets_; // from utc
+    QVector<float> hoursFromStart_, temperature_, precipitation_, windSpeed_, pressure_;
+    QVector<int> rows_; // the temperature's, also for the date
+    QVector<int> windSpeedRows_, pressureRows_;
+    QVector<float> precipitationTotals_; // mm per row
+    QLocale locale_;
+    int hours_ = 0;
+    int maximumPoints_ = 64;
+};
+
+#endif // WEATHERCHARTMODEL_H
@@ -6,6 +6,7 @@
  */
 
 #include "weatherdaymodel.h"
+#include "tracing.h"
 #include "weatherlocation.h"
 /* ~~~ WeatherDay ~~~ */
 
@@ -82,6 +83,7 @@ WeatherDay *WeatherDayListModel::get(int index)
 
 void WeatherDayListModel::refreshDaysFromForecasts(AbstractWeatherForecast &forecasts)
 {
+    TraceSpan span("day model refresh", forecasts.locationId());
     emit layoutAboutToBeChanged();
     emit beginRemoveRows(QModelIndex(), 0, daysList.count() - 1);
     auto oldList = daysList;
@@ -6,81 +6,169 @@
  */
 
 #include "weatherforecastmanager.h"
+#include "forecasthistory.h"
+#include "forecastverification.h"
+#include "kweather_debug.h"
 #include "weatherlocation.h"
 #include "weatherlocationmodel.h"
+#ifndef Q_OS_ANDROID
+#include "dbusadaptors.h"
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusServiceWatcher>
+#endif
 #include <KConfigCore/KConfigGroup>
 #include <QDirIterator>
 #include <QFile>
+#include <QSet>
 #include <QStandardPaths>
 #include <QTimeZone>
 #include <QTimer>
 
-WeatherForecastManager::WeatherForecastManager(WeatherLocationListModel &model)
+WeatherForecastManager::WeatherForecastManager(WeatherLocationListModel &model, bool clientMode, bool deferStartup)
     : model_(model)
+    , clientMode_(clientMode)
+    , startupPending_(deferStartup && model.getList().count() > 1)
 {
+    WeatherLocation::setClientMode(clientMode_);
+
     // create cache location if it does not exist, and load cache
-    QDir dir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/cache");
+    QDir dir(cacheDirectory());
     if (!dir.exists())
         dir.mkpath(".");
-    readFromCache();
+    if (startupPending_) {
+        readFromCache(model_.getList().mid(0, 1)); // the one shown first
+        QTimer::singleShot(3000, this, &WeatherForecastManager::finishStartup); // in case no frame ever comes
+    } else {
+        readFromCache(model_.getList());
+        removeStaleCache();
+    }
+
+#ifndef Q_OS_ANDROID
+    if (clientMode_) {
+        // the daemon announces every forecast it wrote to the cache
+        QDBusConnection::sessionBus().connect(KWEATHER_DBUS_SERVICE, QStringLiteral("/"), QStringLiteral("org.kde.kweather.LocationModel"), QStringLiteral("forecastUpdated"), this, SLOT(reloadFromCache(QString)));
+        // and has to pick up locations we add or remove, and backends we change
+        savedConnection_ = connect(&model_, &WeatherLocationListModel::saved, this, [] {
+            auto msg = QDBusMessage::createMethodCall(KWEATHER_DBUS_SERVICE, QStringLiteral("/"), QStringLiteral("org.kde.kweather.LocationModel"), QStringLiteral("reloadLocations"));
+            QDBusConnection::sessionBus().asyncCall(msg);
+        });
+        auto watcher = new QDBusServiceWatcher(KWEATHER_DBUS_SERVICE, QDBusConnection::sessionBus(), QDBusServiceWatcher::WatchForUnregistration, this);
+        connect(watcher, &QDBusServiceWatcher::serviceUnregistered, this, &WeatherForecastManager::leaveClientMode);
+        return;
+    }
+#endif
+
+    startUpdates();
+}
+
+void WeatherForecastManager::startUpdates()
+{
     updateTimer = new QTimer(this);
     updateTimer->setSingleShot(true);
     connect(updateTimer, &QTimer::timeout, this, &WeatherForecastManager::update);
     updateTimer->start(0); // update when open
 }
 
-WeatherForecastManager &WeatherForecastManager::instance(WeatherLocationListModel &model)
+void WeatherForecastManager::leaveClientMode()
+{
+#ifndef Q_OS_ANDROID
+    if (!clientMode_)
+        return;
+    qCInfo(KWEATHER_LOG) << "daemon exited, fetching forecasts by ourselves";
+    clientMode_ = false;
+    WeatherLocation::setClientMode(false);
+    QDBusConnection::sessionBus().disconnect(KWEATHER_DBUS_SERVICE, QStringLiteral("/"), QStringLiteral("org.kde.kweather.LocationModel"), QStringLiteral("forecastUpdated"), this, SLOT(reloadFromCache(QString)));
+    disconnect(savedConnection_);
+    sender()->deleteLater(); // the service watcher
+    // the forecasts shown are the daemon's last ones, the backends start out from them
+    if (!startupPending_)
+        removeStaleCache();
+    startUpdates();
+    emit clientModeEnded();
+#endif
+}
+
+WeatherForecastManager &WeatherForecastManager::instance(WeatherLocationListModel &model, bool clientMode, bool deferStartup)
 {
-    static WeatherForecastManager singleton(model);
+    static WeatherForecastManager singleton(model, clientMode, deferStartup);
     return singleton;
 }
+
+void WeatherForecastManager::finishStartup()
+{
+    if (!startupPending_)
+        return;
+    startupPending_ = false;
+
+    const auto rest = model_.getList().mid(1);
+    readFromCache(rest);
+    removeStaleCache();
+    if (!clientMode_) {
+        for (auto wLocation : rest)
+            wLocation->update();
+    }
+}
+
+QString WeatherForecastManager::cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/cache";
+}
 void WeatherForecastManager::update()
 {
-    qDebug() << "update start";
-    auto locations = model_.getList();
+    qCDebug(KWEATHER_LOG) << "update start";
+    // during a deferred startup the others are fetched by finishStartup()
+    auto locations = startupPending_ ? model_.getList().mid(0, 1) : model_.getList();
     for (auto wLocation : locations) {
         wLocation->update();
     }
     updateTimer->start(1000 * 3600 + random.bounded(0, 1800) * 1000); // reset timer
 }
 
-void WeatherForecastManager::readFromCache()
+void WeatherForecastManager::readFromCache(const QList<WeatherLocation *> &locations)
 {
-    QHash<WeatherLocation *, AbstractWeatherForecast> map;
-
-    QFile reader;
-    QDirIterator iterator(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/cache", QDirIterator::Subdirectories); // list directory entries
-
-    while (iterator.hasNext()) {
-        reader.setFileName(iterator.next());
-        QFileInfo fileName(reader); // strip absolute path
-        bool isFound = false;       // indicate should we load this cache
-
-        // loop over existing locations and add cached weather forecast data if location found
-        for (auto wl : model_.getList()) {
-            if (fileName.fileName() == wl->locationId()) {
-                isFound = true;
-                reader.open(QIODevice::ReadOnly);
-                AbstractWeatherForecast fc = convertFromJson(reader.readAll());
-
-                map[wl] = fc;
-                break;
-            }
+    for (auto wl : locations) {
+        // should be this path: /home/user/.cache/kweather/cache/1234567 for
+        // location with locationID 1234567
+        QFile reader(cacheDirectory() + "/" + wl->locationId());
+        // without one the backend fetches the sunrise data along with the first refresh
+        if (reader.open(QIODevice::ReadOnly)) { // is in cache
+            if (clientMode_)
+                wl->loadSnapshot(convertFromJson(reader.readAll()));
+            else
+                wl->initData(convertFromJson(reader.readAll()));
         }
+    }
+}
+
+void WeatherForecastManager::removeStaleCache()
+{
+    if (clientMode_) // the daemon owns the cache
+        return;
 
-        if (!isFound) { // delete no longer needed cache
-            reader.remove();
+    QSet<QString> locationIds;
+    for (auto wl : model_.getList())
+        locationIds.insert(wl->locationId());
+
+    // the forecast history and verification of a removed location go with its cache
+    for (const auto &directory : {cacheDirectory(), ForecastHistory::directory(), ForecastVerification::directory()}) {
+        QDirIterator iterator(directory, QDir::Files);
+        while (iterator.hasNext()) {
+            iterator.next();
+            if (!locationIds.contains(iterator.fileName())) // delete no longer needed cache
+                QFile::remove(iterator.filePath());
         }
-        reader.close();
     }
+}
 
-    // add to loaded locations from cache
+void WeatherForecastManager::reloadFromCache(const QString &locationId)
+{
     for (auto wl : model_.getList()) {
-        if (map.find(wl) != map.end()) { // is in cache
-            wl->initData(map[wl]);
-        } else {
-            // need to fetch sunrise data since it's not loaded from cache
-            wl->weatherBackendProvider()->fetchSunriseData();
+        if (wl->locationId() == locationId) {
+            QFile reader(cacheDirectory() + "/" + locationId);
+            if (reader.open(QIODevice::ReadOnly))
+                wl->loadSnapshot(convertFromJson(reader.readAll()));
+            return;
         }
     }
 }
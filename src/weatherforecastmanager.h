@@ -22,20 +22,42 @@ class WeatherForecastManager : public QObject
     Q_OBJECT
 
 public:
-    static WeatherForecastManager &instance(WeatherLocationListModel &model);
+    // in client mode another kweather process (the daemon) fetches the forecasts
+    // and we only show the snapshots it writes to the cache
+    //
+    // with deferStartup only the first location is loaded and fetched right away,
+    // the rest waits for finishStartup(), call it once the first frame is shown
+    static WeatherForecastManager &instance(WeatherLocationListModel &model, bool clientMode = false, bool deferStartup = false);
+
+    bool isClientMode() const
+    {
+        return clientMode_;
+    }
+
+public slots:
+    void finishStartup();
 
 signals:
     void updated();
+    void clientModeEnded(); // the daemon went away, we fetch by ourselves now and may take over its service
 private slots:
     void update();
+    void reloadFromCache(const QString &locationId);
+    void leaveClientMode();
 
 private:
     QRandomGenerator random;
     WeatherLocationListModel &model_;
+    bool clientMode_;
+    bool startupPending_;
+    QMetaObject::Connection savedConnection_; // client mode, tells the daemon about our changes
     AbstractWeatherForecast convertFromJson(QByteArray data);
     QTimer *updateTimer = nullptr;
-    void readFromCache();
-    WeatherForecastManager(WeatherLocationListModel &model);
+    void startUpdates();
+    void readFromCache(const QList<WeatherLocation *> &locations);
+    void removeStaleCache();
+    static QString cacheDirectory();
+    WeatherForecastManager(WeatherLocationListModel &model, bool clientMode, bool deferStartup);
     WeatherForecastManager(const WeatherForecastManager &);
     WeatherForecastManager &operator=(const WeatherForecastManager &);
 };
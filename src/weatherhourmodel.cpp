@@ -6,6 +6,8 @@
  */
 
 #include "weatherhourmodel.h"
+#include "derivedquantities.h"
+#include "tracing.h"
 #include "weatherlocation.h"
 /* ~~~ WeatherHour ~~~ */
 
@@ -15,6 +17,7 @@ WeatherHour::WeatherHour()
     this->weatherIcon_ = "weather-none-available";
     this->date_ = QDateTime::currentDateTime();
     this->windDirection_ = "N";
+    this->windSector_ = "N";
 }
 
 WeatherHour::WeatherHour(AbstractHourlyWeatherForecast &forecast)
@@ -54,6 +57,13 @@ WeatherHour::WeatherHour(AbstractHourlyWeatherForecast &forecast)
     this->humidity_ = forecast.humidity();
     this->pressure_ = forecast.pressure();
     this->date_ = QDateTime(forecast.date().date(), QTime(forecast.date().time().hour(), 0));
+    this->apparentTemperature_ = forecast.apparentTemperature();
+    this->dewPoint_ = forecast.dewPoint();
+    this->windChill_ = forecast.windChill();
+    this->heatIndex_ = forecast.heatIndex();
+    this->windSector_ = DerivedQuantities::sectorName(forecast.windSector());
+    this->beaufort_ = forecast.beaufort();
+    this->interpolated_ = forecast.interpolated();
 }
 
 /* ~~~ WeatherHourListModel ~~~ */
@@ -105,6 +115,7 @@ WeatherHour *WeatherHourListModel::get(int index)
 
 void WeatherHourListModel::refreshHoursFromForecasts(AbstractWeatherForecast &forecast)
 {
+    TraceSpan span("hour model refresh", forecast.locationId());
     // clear forecasts
     emit layoutAboutToBeChanged();
     day = 0;
@@ -32,6 +32,13 @@ class WeatherHour : public QObject
     Q_PROPERTY(float humidity READ humidity NOTIFY propertyChanged)
     Q_PROPERTY(float pressure READ pressure NOTIFY propertyChanged)
     Q_PROPERTY(QDateTime date READ date NOTIFY propertyChanged)
+    Q_PROPERTY(QString apparentTemperature READ apparentTemperature NOTIFY propertyChanged)
+    Q_PROPERTY(QString dewPoint READ dewPoint NOTIFY propertyChanged)
+    Q_PROPERTY(QString windChill READ windChill NOTIFY propertyChanged)
+    Q_PROPERTY(QString heatIndex READ heatIndex NOTIFY propertyChanged)
+    Q_PROPERTY(QString windSector READ windSector NOTIFY propertyChanged)
+    Q_PROPERTY(int beaufort READ beaufort NOTIFY propertyChanged)
+    Q_PROPERTY(bool interpolated READ interpolated NOTIFY propertyChanged)
 
 public:
     explicit WeatherHour();
@@ -95,6 +102,35 @@ public:
     {
         return date_;
     }
+    // computed with the forecast, see DerivedQuantities
+    QString apparentTemperature() const
+    {
+        return formatTemperature(apparentTemperature_);
+    }
+    QString dewPoint() const
+    {
+        return formatTemperature(dewPoint_);
+    }
+    QString windChill() const
+    {
+        return formatTemperature(windChill_);
+    }
+    QString heatIndex() const
+    {
+        return formatTemperature(heatIndex_);
+    }
+    inline QString windSector() const
+    {
+        return windSector_;
+    }
+    inline int beaufort() const
+    {
+        return beaufort_;
+    }
+    inline bool interpolated() const
+    {
+        return interpolated_;
+    }
 
     inline void setWindDirection(QString windDirection)
     {
@@ -140,6 +176,13 @@ signals:
     void propertyChanged();
 
 private:
+    static QString formatTemperature(float celsius)
+    {
+        if (KWeatherSettings().temperatureUnits() == "Fahrenheit")
+            return QString::number(qRound(celsius * 1.8 + 32)) + "°";
+        return QString::number(qRound(celsius)) + "°";
+    }
+
     QString windDirection_;
     QString weatherDescription_;
     QString weatherIcon_;
@@ -149,6 +192,13 @@ private:
     float temperature_;
     float humidity_;
     float pressure_;
+    float apparentTemperature_ = 0;
+    float dewPoint_ = 0;
+    float windChill_ = 0;
+    float heatIndex_ = 0;
+    QString windSector_;
+    int beaufort_ = 0;
+    bool interpolated_ = false;
 
     QDateTime date_;
 };
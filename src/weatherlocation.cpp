@@ -8,34 +8,48 @@
 #include "weatherlocation.h"
 #include "abstractweatherapi.h"
 #include "abstractweatherforecast.h"
+#include "backendhealthtracker.h"
+#include "blendedweatherapi.h"
+#include "forecastverification.h"
 #include "geoiplookup.h"
 #include "geotimezone.h"
+#include "hedgebudget.h"
+#include "historyworker.h"
+#include "kweather_debug.h"
+#include "kweathersettings.h"
 #include "global.h"
 #include "locationquerymodel.h"
+#include "metrics.h"
 #include "nmisunriseapi.h"
 #include "nmiweatherapi2.h"
 #include "owmweatherapi.h"
+#include "tracing.h"
+#include "weatherchartmodel.h"
 #include "weatherdaymodel.h"
-
+#ifndef Q_OS_ANDROID
+#include "dbusadaptors.h"
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#endif
+
+#include <QCoreApplication>
 #include <QDir>
 #include <QFile>
 #include <QJsonArray>
 #include <QQmlEngine>
-#include <QTimeZone>
 #include <utility>
 
+static bool s_clientMode = false;
+
 WeatherLocation::WeatherLocation()
 {
-    this->weatherDayListModel_ = new WeatherDayListModel(this);
-    this->weatherHourListModel_ = new WeatherHourListModel(this);
     this->lastUpdated_ = QDateTime::currentDateTime();
-    this->m_timer = new QTimer(this);
-    connect(m_timer, &QTimer::timeout, this, &WeatherLocation::updateCurrentDateTime);
-    this->m_timer->start(1000);
 }
 
 WeatherLocation::WeatherLocation(AbstractWeatherAPI *weatherBackendProvider, QString locationId, QString locationName, QString timeZone, float latitude, float longitude, Kweather::Backend backend, AbstractWeatherForecast forecast)
     : backend_(backend)
+    , preferredBackend_(backend)
     , locationName_(std::move(locationName))
     , timeZone_(std::move(timeZone))
     , latitude_(latitude)
@@ -44,34 +58,28 @@ WeatherLocation::WeatherLocation(AbstractWeatherAPI *weatherBackendProvider, QSt
     , forecast_(forecast)
     , weatherBackendProvider_(weatherBackendProvider)
 {
-    this->weatherDayListModel_ = new WeatherDayListModel(this);
-    this->weatherHourListModel_ = new WeatherHourListModel(this);
     this->lastUpdated_ = forecast.timeCreated();
-    this->m_timer = new QTimer(this);
-    connect(m_timer, &QTimer::timeout, this, &WeatherLocation::updateCurrentDateTime);
-
-    // prevent segfaults from js garbage collection
-    QQmlEngine::setObjectOwnership(this->weatherDayListModel_, QQmlEngine::CppOwnership);
-    QQmlEngine::setObjectOwnership(this->weatherHourListModel_, QQmlEngine::CppOwnership);
 
     determineCurrentForecast();
 
-    connect(this->weatherBackendProvider(), &AbstractWeatherAPI::updated, this, &WeatherLocation::updateData, Qt::UniqueConnection);
-    this->m_timer->start(1000);
+    // the backend may be created later on, see weatherBackendProvider()
+    if (this->weatherBackendProvider_)
+        connectBackend();
+
+    // the others switch on their next refresh, see update(), rather than all at once
+    BackendHealthTracker &tracker = BackendHealthTracker::instance();
+    connect(&tracker, &BackendHealthTracker::healthChanged, this, [this] {
+        if (weatherDayListModel_ || weatherHourListModel_ || weatherChartModel_) // shown
+            followHealth();
+    });
+    connect(&tracker, &BackendHealthTracker::probeDue, this, &WeatherLocation::probe);
 }
 
 WeatherLocation *WeatherLocation::fromJson(const QJsonObject &obj)
 {
-    AbstractWeatherAPI *api; // don't fetch sunrise information, since it will be loaded from cache
-    Kweather::Backend backendEnum;
-    if (obj["backend"].toInt() == 0) {
-        api = new NMIWeatherAPI2(obj["locationId"].toString(), obj["timezone"].toString(), obj["latitude"].toDouble(), obj["longitude"].toDouble());
-        backendEnum = Kweather::Backend::NMI;
-    } else {
-        api = new OWMWeatherAPI(obj["locationId"].toString(), obj["timezone"].toString(), obj["latitude"].toDouble(), obj["longitude"].toDouble());
-        backendEnum = Kweather::Backend::OWM;
-    }
-    auto weatherLocation = new WeatherLocation(api, obj["locationId"].toString(), obj["locationName"].toString(), obj["timezone"].toString(), obj["latitude"].toDouble(), obj["longitude"].toDouble(), backendEnum, AbstractWeatherForecast());
+    // the backend is only created once the location is refreshed or loaded from cache
+    Kweather::Backend backendEnum = Kweather::backendFromInt(obj["backend"].toInt());
+    auto weatherLocation = new WeatherLocation(nullptr, obj["locationId"].toString(), obj["locationName"].toString(), obj["timezone"].toString(), obj["latitude"].toDouble(), obj["longitude"].toDouble(), backendEnum, AbstractWeatherForecast());
     return weatherLocation;
 }
 
@@ -83,95 +91,223 @@ QJsonObject WeatherLocation::toJson()
     obj["latitude"] = latitude();
     obj["longitude"] = longitude();
     obj["timezone"] = timeZone_;
-    obj["backend"] = static_cast<int>(backend_);
+    obj["backend"] = static_cast<int>(preferredBackend_); // not the one failed over to
     return obj;
 }
 
 void WeatherLocation::updateData(AbstractWeatherForecast &fc)
 {
+    settle(backend_);
+    applyForecast(fc, backend_);
+}
+
+void WeatherLocation::applyForecast(AbstractWeatherForecast &fc, Kweather::Backend backend)
+{
+    TraceSpan span("apply", locationId_);
     forecast_ = fc;
     determineCurrentForecast();
-    updateChart();
     lastUpdated_ = fc.timeCreated();
+    writeToCache(forecast_); // before announcing, clients may read the cache right away
+    if (backend != Kweather::Backend::Blend)
+        appendToHistory(forecast_, backend);
 
     emit weatherRefresh(forecast_);
     emit stopLoadingIndicator();
-    writeToCache(forecast_);
 
     emit propertyChanged();
 }
 
-void WeatherLocation::determineCurrentForecast()
+void WeatherLocation::keepData()
 {
-    delete currentWeather_;
+    // models and chart stay as they are, only the current hour may have moved on
+    settle(backend_);
+    // the backend confirmed its forecast is still current, see AbstractWeatherAPI::bodyUnchanged()
+    const QDateTime confirmed = weatherBackendProvider()->currentData().timeCreated();
+    if (confirmed > lastUpdated_) {
+        lastUpdated_ = confirmed;
+        forecast_.setTimeCreated(confirmed);
+        writeToCache(forecast_);
+        emit forecastConfirmed();
+        emit propertyChanged();
+    }
+    determineCurrentForecast();
+    emit stopLoadingIndicator();
+}
 
-    if (forecast().hourlyForecasts().count() == 0) {
-        currentWeather_ = new WeatherHour();
+void WeatherLocation::determineCurrentForecast()
+{
+    if (forecast_.hourlyForecasts().count() == 0) {
+        currentForecast_ = AbstractHourlyWeatherForecast();
     } else {
         long long minSecs = -1;
         QDateTime current = QDateTime::currentDateTime();
 
         // get closest forecast to current time
-        for (auto forecast : forecast_.hourlyForecasts()) {
+        for (const auto &forecast : qAsConst(forecast_.hourlyForecasts())) {
             if (minSecs == -1 || minSecs > llabs(forecast.date().secsTo(current))) {
-                currentWeather_ = new WeatherHour(forecast);
+                currentForecast_ = forecast;
                 minSecs = llabs(forecast.date().secsTo(current));
             }
         }
     }
-    QQmlEngine::setObjectOwnership(currentWeather_, QQmlEngine::CppOwnership); // prevent segfaults from js garbage collecting
+
+    // only rebuild the WeatherHour if the ui already asked for it
+    if (currentWeather_) {
+        delete currentWeather_;
+        currentWeather_ = nullptr;
+        currentWeather();
+    }
 
     determineCurrentBackgroundWeatherComponent();
     emit currentForecastChange();
 }
 
+WeatherHour *WeatherLocation::currentWeather()
+{
+    if (!currentWeather_) {
+        currentWeather_ = new WeatherHour(currentForecast_);
+        QQmlEngine::setObjectOwnership(currentWeather_, QQmlEngine::CppOwnership); // prevent segfaults from js garbage collecting
+    }
+    return currentWeather_;
+}
+
+WeatherDayListModel *WeatherLocation::weatherDayListModel()
+{
+    if (!weatherDayListModel_) {
+        weatherDayListModel_ = new WeatherDayListModel(this);
+        QQmlEngine::setObjectOwnership(weatherDayListModel_, QQmlEngine::CppOwnership); // prevent segfaults from js garbage collection
+        weatherDayListModel_->refreshDaysFromForecasts(forecast_);
+    }
+    return weatherDayListModel_;
+}
+
+WeatherHourListModel *WeatherLocation::weatherHourListModel()
+{
+    if (!weatherHourListModel_) {
+        weatherHourListModel_ = new WeatherHourListModel(this);
+        QQmlEngine::setObjectOwnership(weatherHourListModel_, QQmlEngine::CppOwnership); // prevent segfaults from js garbage collection
+        weatherHourListModel_->refreshHoursFromForecasts(forecast_);
+    }
+    return weatherHourListModel_;
+}
+
+WeatherChartModel *WeatherLocation::weatherChartModel()
+{
+    if (!weatherChartModel_) {
+        weatherChartModel_ = new WeatherChartModel(this);
+        QQmlEngine::setObjectOwnership(weatherChartModel_, QQmlEngine::CppOwnership); // prevent segfaults from js garbage collection
+        weatherChartModel_->refreshFromForecast(forecast_);
+    }
+    return weatherChartModel_;
+}
+
+AbstractWeatherAPI *WeatherLocation::weatherBackendProvider()
+{
+    if (!weatherBackendProvider_) {
+        weatherBackendProvider_ = createBackend(backend_);
+        connectBackend();
+        // what was loaded from the cache, so that a refresh right after may be skipped
+        weatherBackendProvider_->setCurrentData(forecast_);
+        weatherBackendProvider_->setCurrentSunriseData(forecast_.sunrise());
+        weatherBackendProvider_->fetchSunriseData(); // TODO detect if we need to actually fetch sunrise data
+    }
+    return weatherBackendProvider_;
+}
+
+void WeatherLocation::connectBackend()
+{
+    connect(weatherBackendProvider_, &AbstractWeatherAPI::updated, this, &WeatherLocation::updateData, Qt::UniqueConnection);
+    connect(weatherBackendProvider_, &AbstractWeatherAPI::unchanged, this, &WeatherLocation::keepData, Qt::UniqueConnection);
+    connect(weatherBackendProvider_, &AbstractWeatherAPI::networkError, this, &WeatherLocation::startHedge, Qt::UniqueConnection);
+    // the runs a blend is made of go to the history, not the blend itself
+    if (auto blend = qobject_cast<BlendedWeatherAPI *>(weatherBackendProvider_))
+        connect(blend, &BlendedWeatherAPI::memberUpdated, this, &WeatherLocation::appendToHistory, Qt::UniqueConnection);
+}
+
+AbstractWeatherAPI *WeatherLocation::createBackend(Kweather::Backend backend)
+{
+    switch (backend) {
+    case Kweather::Backend::OWM:
+        return new OWMWeatherAPI(this->locationId(), this->timeZone(), this->latitude(), this->longitude());
+    case Kweather::Backend::Blend:
+        return new BlendedWeatherAPI(this->locationId(), this->timeZone(), this->latitude(), this->longitude());
+    case Kweather::Backend::NMI:
+    default:
+        return new NMIWeatherAPI2(this->locationId(), this->timeZone(), this->latitude(), this->longitude());
+    }
+}
+
+const ZoneOffsetTable &WeatherLocation::zoneOffsets()
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    if (!zoneOffsets_.covers(now, now) || zoneOffsets_.ianaId() != timeZone_.toUtf8())
+        zoneOffsets_ = ZoneOffsetTable(timeZone_.toUtf8(), now - 3600, now + 7 * 24 * 3600);
+    return zoneOffsets_;
+}
+
+void WeatherLocation::connectClock()
+{
+    if (clockConnected_)
+        return;
+
+    // one timer drives the clock of every location currently displayed
+    static QTimer *clock = [] {
+        auto *timer = new QTimer(qApp);
+        timer->start(1000);
+        return timer;
+    }();
+    connect(clock, &QTimer::timeout, this, &WeatherLocation::updateCurrentDateTime);
+    clockConnected_ = true;
+}
+
 void WeatherLocation::determineCurrentBackgroundWeatherComponent()
 {
     m_backgroundComponent = QStringLiteral("backgrounds/ClearDay.qml");
 
     bool isDayStyle = false; // make sure that if the background is definitively day, the colours match that
+    const QString &icon = currentForecast_.weatherIcon();
 
-    if (currentWeather_->weatherIcon() == QStringLiteral("weather-clear")) {
+    if (icon == QStringLiteral("weather-clear")) {
         m_backgroundComponent = QStringLiteral("backgrounds/ClearDay.qml");
         isDayStyle = true;
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-clear-night")) {
+    } else if (icon == QStringLiteral("weather-clear-night")) {
         m_backgroundComponent = QStringLiteral("backgrounds/ClearNight.qml");
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-clouds")) {
+    } else if (icon == QStringLiteral("weather-clouds")) {
         m_backgroundComponent = QStringLiteral("backgrounds/CloudyDay.qml");
         isDayStyle = true;
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-clouds-night") || currentWeather_->weatherIcon() == QStringLiteral("weather-overcast")) {
+    } else if (icon == QStringLiteral("weather-clouds-night") || icon == QStringLiteral("weather-overcast")) {
         m_backgroundComponent = QStringLiteral("backgrounds/CloudyNight.qml");
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-few-clouds")) {
+    } else if (icon == QStringLiteral("weather-few-clouds")) {
         m_backgroundComponent = QStringLiteral("backgrounds/PartlyCloudyDay.qml");
         isDayStyle = true;
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-few-clouds-night")) {
+    } else if (icon == QStringLiteral("weather-few-clouds-night")) {
         m_backgroundComponent = QStringLiteral("backgrounds/PartlyCloudyNight.qml");
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-fog") || currentWeather_->weatherIcon() == QStringLiteral("weather-mist")) {
+    } else if (icon == QStringLiteral("weather-fog") || icon == QStringLiteral("weather-mist")) {
         m_backgroundComponent = QStringLiteral("backgrounds/Misty.qml");
         isDayStyle = true;
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-freezing-rain") || currentWeather_->weatherIcon() == QStringLiteral("weather-snow-hail") || currentWeather_->weatherIcon() == QStringLiteral("weather-showers") ||
-               currentWeather_->weatherIcon() == QStringLiteral("weather-showers-day") || currentWeather_->weatherIcon() == QStringLiteral("weather-showers-scattered") ||
-               currentWeather_->weatherIcon() == QStringLiteral("weather-showers-scattered-day") || currentWeather_->weatherIcon() == QStringLiteral("weather-storm") ||
-               currentWeather_->weatherIcon() == QStringLiteral("weather-storm-day")) {
+    } else if (icon == QStringLiteral("weather-freezing-rain") || icon == QStringLiteral("weather-snow-hail") || icon == QStringLiteral("weather-showers") ||
+               icon == QStringLiteral("weather-showers-day") || icon == QStringLiteral("weather-showers-scattered") ||
+               icon == QStringLiteral("weather-showers-scattered-day") || icon == QStringLiteral("weather-storm") ||
+               icon == QStringLiteral("weather-storm-day")) {
         m_backgroundComponent = QStringLiteral("backgrounds/RainyDay.qml");
         isDayStyle = true;
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-showers-night") || currentWeather_->weatherIcon() == QStringLiteral("weather-showers-scattered-night") ||
-               currentWeather_->weatherIcon() == QStringLiteral("weather-storm-night")) {
+    } else if (icon == QStringLiteral("weather-showers-night") || icon == QStringLiteral("weather-showers-scattered-night") ||
+               icon == QStringLiteral("weather-storm-night")) {
         m_backgroundComponent = QStringLiteral("backgrounds/RainyNight.qml");
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-hail") || currentWeather_->weatherIcon() == QStringLiteral("weather-snow-scattered") || currentWeather_->weatherIcon() == QStringLiteral("weather-snow")) {
+    } else if (icon == QStringLiteral("weather-hail") || icon == QStringLiteral("weather-snow-scattered") || icon == QStringLiteral("weather-snow")) {
         m_backgroundComponent = QStringLiteral("backgrounds/SnowyDay.qml");
         isDayStyle = true;
 
-    } else if (currentWeather_->weatherIcon() == QStringLiteral("weather-snow-scattered-night")) {
+    } else if (icon == QStringLiteral("weather-snow-scattered-night")) {
         m_backgroundComponent = QStringLiteral("backgrounds/SnowyNight.qml");
     }
 
@@ -191,23 +327,184 @@ void WeatherLocation::determineCurrentBackgroundWeatherComponent()
 }
 
 void WeatherLocation::initData(AbstractWeatherForecast fc)
+{
+    // the backend is handed the forecast once a refresh creates it
+    forecast_ = fc;
+    lastUpdated_ = fc.timeCreated();
+    determineCurrentForecast();
+    emit weatherRefresh(forecast_);
+    emit propertyChanged();
+}
+
+void WeatherLocation::loadSnapshot(AbstractWeatherForecast fc)
 {
     forecast_ = fc;
-    weatherBackendProvider_->setCurrentData(forecast_);
-    weatherBackendProvider_->setCurrentSunriseData(fc.sunrise());
-    weatherBackendProvider_->fetchSunriseData(); // TODO detect if we need to actually fetch sunrise data
+    lastUpdated_ = fc.timeCreated();
     determineCurrentForecast();
     emit weatherRefresh(forecast_);
+    emit stopLoadingIndicator();
     emit propertyChanged();
 }
 
+void WeatherLocation::setClientMode(bool clientMode)
+{
+    s_clientMode = clientMode;
+}
+
 void WeatherLocation::update()
 {
-    weatherBackendProvider_->update();
+    if (s_clientMode) {
+        requestRefresh();
+        return;
+    }
+    if (followHealth())
+        return;
+    settled_ = false;
+    hedged_ = false;
+    shadowAnswered_ = false;
+    weatherBackendProvider()->update();
+
+    KWeatherSettings settings;
+    const bool shadowFetch = settings.shadowFetch() && shadowAvailable();
+    const bool hedging = settings.hedgedRequests() && shadowAvailable();
+    if (!shadowFetch && !hedging) {
+        // while failed over the shadow probes the chosen backend, see probe()
+        if (backend_ == preferredBackend_) {
+            delete shadowBackendProvider_;
+            shadowBackendProvider_ = nullptr;
+        }
+        return;
+    }
+    if (shadowFetch)
+        shadowBackendProvider()->update();
+
+    // no need to hedge what was answered from the last few minutes
+    if (settled_ || !hedging)
+        return;
+    HedgeBudget &budget = HedgeBudget::instance();
+    budget.setRatio(settings.hedgeBudgetPercent() / 100.0);
+    budget.deposit();
+    if (!hedgeTimer_) {
+        hedgeTimer_ = new QTimer(this);
+        hedgeTimer_->setSingleShot(true);
+        connect(hedgeTimer_, &QTimer::timeout, this, &WeatherLocation::startHedge);
+    }
+    hedgeTimer_->start(HedgeBudget::delay(weatherBackendProvider()->backendName()));
+}
+
+void WeatherLocation::startHedge()
+{
+    if (settled_ || hedged_ || !KWeatherSettings().hedgedRequests() || !shadowAvailable())
+        return;
+    if (hedgeTimer_)
+        hedgeTimer_->stop(); // when the backend failed before its time was up
+
+    const QString backend = weatherBackendProvider()->backendName();
+    if (KWeatherSettings().shadowFetch()) {
+        // asked already, free of charge; its answer counts from now on
+        hedged_ = true;
+        Metrics::instance().increment(QStringLiteral("kweather_hedged_requests_total"), backend);
+        if (shadowAnswered_) {
+            settle(shadowBackend());
+            applyForecast(shadowBackendProvider()->currentData(), shadowBackend());
+        }
+        return;
+    }
+    if (!HedgeBudget::instance().withdraw()) {
+        Metrics::instance().increment(QStringLiteral("kweather_hedges_denied_total"), backend);
+        return;
+    }
+    hedged_ = true;
+    Metrics::instance().increment(QStringLiteral("kweather_hedged_requests_total"), backend);
+    shadowBackendProvider()->update();
+}
+
+void WeatherLocation::settle(Kweather::Backend winner)
+{
+    if (settled_)
+        return;
+    settled_ = true;
+    if (hedgeTimer_)
+        hedgeTimer_->stop();
+
+    // the first answer of a refresh is the one shown, the other request is dropped
+    if (winner != backend_) {
+        weatherBackendProvider()->cancel();
+        Metrics::instance().increment(QStringLiteral("kweather_hedges_won_total"), shadowBackendProvider()->backendName());
+    } else if (hedged_ && shadowBackendProvider_ && !KWeatherSettings().shadowFetch()) {
+        shadowBackendProvider_->cancel();
+    }
+}
+
+void WeatherLocation::shadowUpdated(AbstractWeatherForecast &fc)
+{
+    shadowAnswered_ = true;
+    if (hedged_ && !settled_) {
+        settle(shadowBackend());
+        applyForecast(fc, shadowBackend());
+        return;
+    }
+    appendToHistory(fc, shadowBackend());
+}
+
+void WeatherLocation::shadowUnchanged()
+{
+    // what it sent before is still current, good enough when the own backend is late
+    shadowAnswered_ = true;
+    if (hedged_ && !settled_) {
+        settle(shadowBackend());
+        applyForecast(shadowBackendProvider()->currentData(), shadowBackend());
+    }
+}
+
+AbstractWeatherAPI *WeatherLocation::shadowBackendProvider()
+{
+    if (!shadowBackendProvider_) {
+        shadowBackendProvider_ = createBackend(shadowBackend());
+        shadowBackendProvider_->setCurrentSunriseData(weatherBackendProvider()->currentSunriseData()); // for day and night icons
+        connect(shadowBackendProvider_, &AbstractWeatherAPI::updated, this, &WeatherLocation::shadowUpdated, Qt::UniqueConnection);
+        connect(shadowBackendProvider_, &AbstractWeatherAPI::unchanged, this, &WeatherLocation::shadowUnchanged, Qt::UniqueConnection);
+    }
+    return shadowBackendProvider_;
+}
+
+Kweather::Backend WeatherLocation::shadowBackend() const
+{
+    return backend_ == Kweather::Backend::NMI ? Kweather::Backend::OWM : Kweather::Backend::NMI;
+}
+
+bool WeatherLocation::shadowAvailable() const
+{
+    // a blend asks both anyway
+    if (backend_ == Kweather::Backend::Blend)
+        return false;
+    return shadowBackend() != Kweather::Backend::OWM || !KWeatherSettings().oWMToken().isEmpty();
+}
+
+void WeatherLocation::updateUi()
+{
+    emit propertyChanged();
+    if (weatherDayListModel_)
+        weatherDayListModel_->updateUi();
+    if (weatherHourListModel_)
+        weatherHourListModel_->updateUi();
+}
+
+void WeatherLocation::appendToHistory(const AbstractWeatherForecast &fc, Kweather::Backend backend)
+{
+    // written and scored on the history thread, the settings are only read here
+    const qint64 retention = static_cast<qint64>(KWeatherSettings().historyRetentionDays()) * 86400;
+    HistoryWorker::instance().append(locationId_, fc.timeCreated().toSecsSinceEpoch(), backend, fc.hourlyForecasts(), retention);
+}
+
+QJsonObject WeatherLocation::verification()
+{
+    return ForecastVerification(ForecastVerification::pathFor(locationId_)).toJson();
 }
 
 void WeatherLocation::writeToCache(AbstractWeatherForecast &fc)
 {
+    TraceSpan span("cache write", locationId_);
     QFile file;
     QString url = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
     QDir dir(url.append(QString("/cache"))); // create cache location
@@ -229,53 +526,109 @@ QJsonDocument WeatherLocation::convertToJson(AbstractWeatherForecast &fc)
 
 void WeatherLocation::changeBackend(Kweather::Backend backend)
 {
-    if (backend != backend_) {
-        auto old = weatherBackendProvider_;
+    // the user's choice, not a failover; should it be down, the refresh moves on from there
+    preferredBackend_ = backend;
+    if (s_clientMode) {
+        // the daemon switches once it reloads the saved locations, its forecast follows
         backend_ = backend;
-        AbstractWeatherAPI *tmp = nullptr;
-        switch (backend_) {
-        case Kweather::Backend::OWM:
-            tmp = new OWMWeatherAPI(this->locationId(), this->timeZone(), this->latitude_, this->longitude());
-            break;
-        case Kweather::Backend::NMI:
-            tmp = new NMIWeatherAPI2(this->locationId(), this->timeZone(), this->latitude_, this->longitude());
-            break;
-        default:
-            return;
+        if (weatherBackendProvider_) { // still for the old backend, should we fetch again later
+            disconnect(weatherBackendProvider_, nullptr, this, nullptr);
+            weatherBackendProvider_->deleteLater();
+            weatherBackendProvider_ = nullptr;
         }
-        weatherBackendProvider_ = tmp;
-        connect(this->weatherBackendProvider(), &AbstractWeatherAPI::updated, this, &WeatherLocation::updateData, Qt::UniqueConnection);
-        weatherBackendProvider_->setCurrentSunriseData(old->currentSunriseData());
-        weatherBackendProvider_->fetchSunriseData();
-        this->update();
-        old->deleteLater();
+        emit propertyChanged();
+        return;
     }
+    switchBackend(backend);
 }
 
-void WeatherLocation::updateChart()
+void WeatherLocation::requestRefresh()
 {
-    m_maxTempList.clear();
-    m_xAxisList.clear();
-    for (const auto &day : forecast_.dailyForecasts()) {
-        m_maxTempList.append(day.maxTemp());
-        m_xAxisList.append(QLocale::system().toString(day.date(),QStringLiteral("ddd")));
-    }
+#ifndef Q_OS_ANDROID
+    // the new forecast comes back through the cache, see WeatherForecastManager::reloadFromCache()
+    auto msg = QDBusMessage::createMethodCall(KWEATHER_DBUS_SERVICE, WeatherLocationAdaptor::objectPath(locationId_), QStringLiteral("org.kde.kweather.WeatherLocation"), QStringLiteral("update"));
+    auto watcher = new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(msg), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *watcher) {
+        if (watcher->isError()) {
+            qCWarning(KWEATHER_LOG) << "daemon did not refresh" << locationId_ << watcher->error().message();
+            emit stopLoadingIndicator();
+        }
+        watcher->deleteLater();
+    });
+#else
+    emit stopLoadingIndicator();
+#endif
+}
+
+Kweather::Backend WeatherLocation::healthyBackend() const
+{
+    // a blend does without the member that is down by itself
+    if (preferredBackend_ == Kweather::Backend::Blend || !KWeatherSettings().automaticFailover())
+        return preferredBackend_;
+    const BackendHealthTracker &tracker = BackendHealthTracker::instance();
+    const Kweather::Backend other = preferredBackend_ == Kweather::Backend::NMI ? Kweather::Backend::OWM : Kweather::Backend::NMI;
+    const bool otherAvailable = other != Kweather::Backend::OWM || !KWeatherSettings().oWMToken().isEmpty();
+    if (!tracker.isHealthy(preferredBackend_) && otherAvailable && tracker.isHealthy(other))
+        return other;
+    return preferredBackend_;
+}
 
-    Q_EMIT chartListChanged();
+bool WeatherLocation::followHealth()
+{
+    const Kweather::Backend backend = healthyBackend();
+    if (backend == backend_)
+        return false;
+    const bool failover = backend_ == preferredBackend_;
+    switchBackend(backend);
+    const QString name = weatherBackendProvider()->backendName();
+    qCInfo(KWEATHER_LOG) << locationId_ << (failover ? "failed over to" : "back to") << name;
+    Metrics::instance().increment(QStringLiteral("kweather_backend_failovers_total"), name);
+    return true;
 }
 
-WeatherLocation::~WeatherLocation()
+void WeatherLocation::probe(Kweather::Backend backend)
 {
-    delete weatherBackendProvider_;
+    // one location that moved off it asks, its answer goes to the tracker
+    if (backend_ == preferredBackend_ || backend != preferredBackend_ || !BackendHealthTracker::instance().claimProbe(backend))
+        return;
+    shadowBackendProvider()->update();
 }
 
-const QVariantList &WeatherLocation::maxTempList()
+void WeatherLocation::switchBackend(Kweather::Backend backend)
 {
-    return m_maxTempList;
+    if (backend != backend_) {
+        auto old = weatherBackendProvider_;
+        backend_ = backend;
+        weatherBackendProvider_ = nullptr;
+        // the shadow was the new backend, it is created again for the old one on update;
+        // later, either may be in the middle of handing a reply to the health tracker
+        if (shadowBackendProvider_) {
+            disconnect(shadowBackendProvider_, nullptr, this, nullptr);
+            shadowBackendProvider_->deleteLater();
+            shadowBackendProvider_ = nullptr;
+        }
+        if (old)
+            disconnect(old, nullptr, this, nullptr); // a late answer is not the new backend's
+        settled_ = true;
+        // not weatherBackendProvider(), the forecast shown is not the new backend's
+        weatherBackendProvider_ = createBackend(backend_);
+        connectBackend();
+        weatherBackendProvider_->setCurrentSunriseData(old ? old->currentSunriseData() : forecast_.sunrise());
+        weatherBackendProvider_->fetchSunriseData();
+        this->update();
+        if (old)
+            old->deleteLater();
+    }
 }
-const QVariantList& WeatherLocation::xAxisList()
+
+WeatherLocation::~WeatherLocation()
 {
-    return m_xAxisList;
+    delete weatherBackendProvider_;
+    delete shadowBackendProvider_;
+    delete weatherDayListModel_;
+    delete weatherHourListModel_;
+    delete weatherChartModel_;
+    delete currentWeather_;
 }
 
 void WeatherLocation::updateCurrentDateTime()
@@ -10,6 +10,7 @@
 #include "abstractweatherforecast.h"
 #include "nmiweatherapi2.h"
 #include "weatherhourmodel.h"
+#include "zoneoffsettable.h"
 
 #include <QAbstractListModel>
 #include <QDebug>
@@ -17,15 +18,37 @@
 #include <QJsonObject>
 #include <QObject>
 #include <QDateTime>
-#include <QTimeZone>
 #include <QTimer>
 #include <utility>
 
+class WeatherChartModel;
 class WeatherDayListModel;
 class WeatherHourListModel;
 class WeatherHour;
 class AbstractWeatherAPI;
 class AbstractWeatherForecast;
+
+/**
+ * A configured location.
+ *
+ * The object itself is only a lightweight record: id, name, coordinates, timezone,
+ * backend choice and an implicitly shared handle to the latest forecast snapshot.
+ * Everything that is only needed while the location is on screen or being
+ * refreshed (backend fetcher, day/hour list models, the WeatherHour for the current
+ * conditions, the clock connection and its zone offset table) is created lazily on
+ * first use.
+ *
+ * Per-location memory budget (approximate, x86_64):
+ *  - idle record (never shown, never refreshed): ~1 KiB
+ *  - forecast snapshot: ~50 KiB for 10 days on the hourly grid, about 240 hours
+ *    at ~200 bytes each counting the list node and the QDateTime data; shared
+ *    with the backend and the list models rather than copied. Estimated from the
+ *    layout, to be re-measured with kweather_stress
+ *  - backend fetcher, once refreshed: ~2 KiB (network access manager and
+ *    description tables are shared by all locations)
+ *  - list models, once shown: ~40 KiB (one QObject per day and per hour)
+ *  - chart model, once shown: ~5 KiB (a few floats per hour)
+ */
 class WeatherLocation : public QObject
 {
     Q_OBJECT
@@ -45,8 +68,7 @@ class WeatherLocation : public QObject
     Q_PROPERTY(QString cardTextColor READ cardTextColor NOTIFY currentForecastChange)
     Q_PROPERTY(QString iconColor READ iconColor NOTIFY currentForecastChange)
 
-    Q_PROPERTY(QVariantList maxTempList READ maxTempList NOTIFY chartListChanged)
-    Q_PROPERTY(QVariantList xAxisList READ xAxisList NOTIFY chartListChanged)
+    Q_PROPERTY(WeatherChartModel *chartModel READ weatherChartModel NOTIFY propertyChanged)
 public:
     WeatherLocation();
     explicit WeatherLocation(AbstractWeatherAPI *weatherBackendProvider,
@@ -64,8 +86,7 @@ public:
 
     Q_INVOKABLE void updateBackend()
     {
-        if (weatherBackendProvider() != nullptr)
-            weatherBackendProvider()->update();
+        update();
     }
 
     inline QString locationId()
@@ -88,27 +109,20 @@ public:
     {
         return longitude_;
     }
-    inline WeatherHour *currentWeather()
-    {
-        //        return currentWeather_ == nullptr ? new WeatherHour() : currentWeather_;
-        return currentWeather_;
-    }
-    inline WeatherDayListModel *weatherDayListModel()
-    {
-        return weatherDayListModel_;
-    }
-    inline WeatherHourListModel *weatherHourListModel()
-    {
-        return weatherHourListModel_;
-    }
+    WeatherHour *currentWeather();
+    WeatherDayListModel *weatherDayListModel();
+    WeatherHourListModel *weatherHourListModel();
+    WeatherChartModel *weatherChartModel();
     inline AbstractWeatherForecast forecast()
     {
         return forecast_;
     }
-    inline AbstractWeatherAPI *weatherBackendProvider()
+    // the hourly forecast closest to now, see determineCurrentForecast()
+    inline const AbstractHourlyWeatherForecast &currentForecast() const
     {
-        return weatherBackendProvider_;
+        return currentForecast_;
     }
+    AbstractWeatherAPI *weatherBackendProvider();
     inline QString lastUpdatedFormatted()
     {
         return lastUpdated().toString("hh:mm ap");
@@ -119,19 +133,21 @@ public:
     }
     inline QString currentTimeFormatted()
     {
+        connectClock();
         return currentTime().toString("hh:mm ap");
     }
     inline QTime currentTime()
     {
-        return QDateTime::currentDateTime().toTimeZone(QTimeZone(timeZone_.toUtf8())).time();
+        return zoneOffsets().toDateTime(QDateTime::currentSecsSinceEpoch()).time();
     }
     inline QString currentDateFormatted()
     {
+        connectClock();
         return currentDate().toString("dd MMM yyyy");
     }
     inline QDate currentDate()
     {
-        return QDateTime::currentDateTime().toTimeZone(QTimeZone(timeZone_.toUtf8())).date();
+        return zoneOffsets().toDateTime(QDateTime::currentSecsSinceEpoch()).date();
     }
     inline void setLastUpdated(QDateTime lastUpdated)
     {
@@ -141,8 +157,20 @@ public:
     void determineCurrentForecast();
     void determineCurrentBackgroundWeatherComponent();
     void initData(AbstractWeatherForecast fc);
-    void update();
-    void changeBackend(Kweather::Backend backend); // change backend on the fly
+    void loadSnapshot(AbstractWeatherForecast fc); // show a forecast fetched by another process
+    void update(); // in client mode asks the daemon to, see setClientMode()
+    void updateUi(); // only touches the ui objects that have been created
+    void changeBackend(Kweather::Backend backend); // change backend on the fly, the one chosen from now on
+    // while another kweather process (the daemon) fetches the forecasts and writes the
+    // cache, no location fetches by itself; see WeatherForecastManager
+    static void setClientMode(bool clientMode);
+    QJsonObject verification(); // per backend and lead time, see ForecastVerification
+    // the one chosen by the user, saved
+    inline Kweather::Backend preferredBackend() const
+    {
+        return preferredBackend_;
+    }
+    // the one in use, another than the chosen one while that is down, see followHealth()
     inline QString backend()
     {
         switch (backend_) {
@@ -150,6 +178,8 @@ public:
             return Kweather::API_NMI;
         case Kweather::Backend::OWM:
             return Kweather::API_OWM;
+        case Kweather::Backend::Blend:
+            return Kweather::API_BLEND;
         default:
             return {};
         }
@@ -181,30 +211,46 @@ public:
         return m_iconColor;
     }
 
-    const QVariantList &maxTempList();
-    const QVariantList &xAxisList();
 public slots:
     void updateData(AbstractWeatherForecast &fc);
+    void keepData(); // a refresh brought nothing new
 
 signals:
     void weatherRefresh(AbstractWeatherForecast &fc); // sent when weather data is refreshed
+    void forecastConfirmed(); // a refresh found the forecast unchanged, lastUpdated moved on
     void currentForecastChange();
     void propertyChanged(); // avoid warning
     void stopLoadingIndicator();
     void currentTimeChanged();
     void currentDateChanged();
-
-    void chartListChanged();
 private slots:
     void updateCurrentDateTime();
+    void shadowUpdated(AbstractWeatherForecast &fc);
+    void shadowUnchanged();
+    // every run fetched, see ForecastHistory; scores the hours that passed since, on the HistoryWorker thread
+    void appendToHistory(const AbstractWeatherForecast &fc, Kweather::Backend backend);
+    void startHedge(); // ask the other backend too, the own one is late or failed
+    // moves to the backend BackendHealthTracker deems usable, true when it did and refreshes
+    bool followHealth();
+    void probe(Kweather::Backend backend); // whether the chosen backend is back, see BackendHealthTracker::probeDue()
 private:
     Kweather::Backend backend_ = Kweather::Backend::NMI;
+    Kweather::Backend preferredBackend_ = Kweather::Backend::NMI; // chosen by the user, saved
 
     void writeToCache(AbstractWeatherForecast &fc);
+    void requestRefresh(); // from the daemon
     QJsonDocument convertToJson(AbstractWeatherForecast &fc);
-
-    // chart related fields
-    QVariantList m_maxTempList, m_xAxisList;
+    AbstractWeatherAPI *createBackend(Kweather::Backend backend);
+    void switchBackend(Kweather::Backend backend);
+    Kweather::Backend healthyBackend() const; // the chosen one, or the other while it is down
+    void connectBackend(); // weatherBackendProvider_ to this
+    void applyForecast(AbstractWeatherForecast &fc, Kweather::Backend backend);
+    void settle(Kweather::Backend winner); // the first answer of a refresh arrived
+    AbstractWeatherAPI *shadowBackendProvider();
+    Kweather::Backend shadowBackend() const; // the one not shown
+    bool shadowAvailable() const;
+    void connectClock();
+    const ZoneOffsetTable &zoneOffsets(); // for the clock, covers the next few days
 
     // background related fields
     QString m_backgroundColor;
@@ -217,16 +263,25 @@ private:
     QString locationName_, locationId_;
     QString timeZone_;
     QDateTime lastUpdated_;
-    QTimer *m_timer;
     float latitude_, longitude_;
 
+    // created on demand, see class documentation
     WeatherDayListModel *weatherDayListModel_ = nullptr;
     WeatherHourListModel *weatherHourListModel_ = nullptr;
+    WeatherChartModel *weatherChartModel_ = nullptr;
+    bool clockConnected_ = false;
+    ZoneOffsetTable zoneOffsets_;
 
     AbstractWeatherForecast forecast_;
+    AbstractHourlyWeatherForecast currentForecast_;
     WeatherHour *currentWeather_ = nullptr;
 
     AbstractWeatherAPI *weatherBackendProvider_ = nullptr;
-
-    void updateChart();
+    // the other backend, fetched into the history when shadowFetch is set and
+    // shown when a hedged refresh gets its answer first
+    AbstractWeatherAPI *shadowBackendProvider_ = nullptr;
+    QTimer *hedgeTimer_ = nullptr;
+    bool settled_ = true; // the current refresh has its answer
+    bool hedged_ = false; // the other backend's answer counts for the current refresh
+    bool shadowAnswered_ = false;
 };
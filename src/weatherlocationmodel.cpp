@@ -6,9 +6,12 @@
  */
 
 #include "weatherlocationmodel.h"
+#include "blendedweatherapi.h"
 #include "geoiplookup.h"
 #include "geotimezone.h"
+#include "kweather_debug.h"
 #include "locationquerymodel.h"
+#include "metrics.h"
 #include "owmweatherapi.h"
 #include "weatherdaymodel.h"
 #include "weatherlocation.h"
@@ -18,13 +21,21 @@
 
 #include <QJsonArray>
 
+#include <algorithm>
+
 const QString WEATHER_LOCATIONS_CFG_GROUP = QStringLiteral("WeatherLocations");
 const QString WEATHER_LOCATIONS_CFG_KEY = QStringLiteral("locationsList");
 
 /* ~~~ WeatherLocationListModel ~~~ */
 WeatherLocationListModel::WeatherLocationListModel(QObject *parent)
+    : QAbstractListModel(parent)
 {
     load();
+
+    auto updateGauge = [this] { Metrics::instance().setGauge(QStringLiteral("kweather_locations"), locationsList.count()); };
+    connect(this, &WeatherLocationListModel::locationAdded, this, updateGauge);
+    connect(this, &WeatherLocationListModel::locationRemoved, this, updateGauge);
+    updateGauge();
 }
 
 void WeatherLocationListModel::load()
@@ -51,6 +62,55 @@ void WeatherLocationListModel::save()
     auto config = KSharedConfig::openConfig(QString(), KSharedConfig::FullConfig, QStandardPaths::AppConfigLocation);
     KConfigGroup group = config->group(WEATHER_LOCATIONS_CFG_GROUP);
     group.writeEntry(WEATHER_LOCATIONS_CFG_KEY, QString(QJsonDocument(arr).toJson(QJsonDocument::Compact)));
+    group.sync();
+    emit saved();
+}
+
+void WeatherLocationListModel::reload()
+{
+    auto config = KSharedConfig::openConfig(QString(), KSharedConfig::FullConfig, QStandardPaths::AppConfigLocation);
+    config->reparseConfiguration();
+    KConfigGroup group = config->group(WEATHER_LOCATIONS_CFG_GROUP);
+    QJsonDocument doc = QJsonDocument::fromJson(group.readEntry(WEATHER_LOCATIONS_CFG_KEY, "{}").toUtf8());
+
+    QHash<QString, QJsonObject> saved;
+    QStringList order;
+    for (QJsonValueRef r : doc.array()) {
+        QJsonObject obj = r.toObject();
+        saved[obj["locationId"].toString()] = obj;
+        order.append(obj["locationId"].toString());
+    }
+
+    // drop locations that no longer exist
+    for (int i = locationsList.count() - 1; i >= 0; i--) {
+        if (!saved.contains(locationsList.at(i)->locationId())) {
+            auto location = locationsList.at(i);
+            beginRemoveRows(QModelIndex(), i, i);
+            locationsList.removeAt(i);
+            endRemoveRows();
+            emit locationRemoved(location->locationId());
+            delete location;
+        }
+    }
+
+    // add new locations and follow backend changes
+    for (const auto &id : qAsConst(order)) {
+        auto it = std::find_if(locationsList.begin(), locationsList.end(), [&id](WeatherLocation *l) { return l->locationId() == id; });
+        if (it == locationsList.end()) {
+            auto location = WeatherLocation::fromJson(saved[id]);
+            QQmlEngine::setObjectOwnership(location, QQmlEngine::CppOwnership);
+            beginInsertRows(QModelIndex(), locationsList.count(), locationsList.count());
+            locationsList.append(location);
+            endInsertRows();
+            emit locationAdded(location);
+            location->update();
+        } else {
+            // every other location keeps its backend, and one failed over stays so
+            const Kweather::Backend backend = Kweather::backendFromInt(saved[id]["backend"].toInt());
+            if (backend != (*it)->preferredBackend())
+                (*it)->changeBackend(backend);
+        }
+    }
 }
 
 int WeatherLocationListModel::rowCount(const QModelIndex &parent) const
@@ -79,9 +139,7 @@ void WeatherLocationListModel::updateUi()
 {
     emit dataChanged(createIndex(0, 0), createIndex(locationsList.count() - 1, 0));
     for (auto l : locationsList) {
-        emit l->propertyChanged();
-        l->weatherDayListModel()->updateUi();
-        l->weatherHourListModel()->updateUi();
+        l->updateUi();
     }
 }
 
@@ -94,6 +152,7 @@ void WeatherLocationListModel::insert(int index, WeatherLocation *weatherLocatio
     emit beginInsertRows(QModelIndex(), index, index);
     locationsList.insert(index, weatherLocation);
     emit endInsertRows();
+    emit locationAdded(weatherLocation);
 
     save();
 }
@@ -106,6 +165,7 @@ void WeatherLocationListModel::remove(int index)
     emit beginRemoveRows(QModelIndex(), index, index);
     auto location = locationsList.at(index);
     locationsList.removeAt(index);
+    emit locationRemoved(location->locationId());
     delete location;
     emit endRemoveRows();
 
@@ -136,7 +196,7 @@ void WeatherLocationListModel::move(int oldIndex, int newIndex)
 
 void WeatherLocationListModel::addLocation(LocationQueryResult *ret)
 {
-    qDebug() << "add location";
+    qCDebug(KWEATHER_LOG) << "add location";
     auto locId = ret->geonameId(), locName = ret->toponymName();
     auto lat = ret->latitude(), lon = ret->longitude();
 
@@ -148,7 +208,7 @@ void WeatherLocationListModel::addLocation(LocationQueryResult *ret)
 
     // successful timezone fetch
     connect(tz, &GeoTimeZone::finished, this, [this, locId, locName, lat, lon, tz] {
-        qDebug() << "obtained timezone data";
+        qCDebug(KWEATHER_LOG) << "obtained timezone data";
 
         Kweather::Backend backendEnum;
         AbstractWeatherAPI *api;
@@ -162,6 +222,9 @@ void WeatherLocationListModel::addLocation(LocationQueryResult *ret)
         } else if (backend == Kweather::API_OWM) {
             api = new OWMWeatherAPI(locId, tz->getTimeZone(), lat, lon);
             backendEnum = Kweather::Backend::OWM;
+        } else if (backend == Kweather::API_BLEND) {
+            api = new BlendedWeatherAPI(locId, tz->getTimeZone(), lat, lon);
+            backendEnum = Kweather::Backend::Blend;
         } else {
             api = new NMIWeatherAPI2(locId, tz->getTimeZone(), lat, lon);
             backendEnum = Kweather::Backend::NMI;
@@ -208,6 +271,8 @@ void WeatherLocationListModel::changeBackend(int index, QString backend)
         this->get(index)->changeBackend(Kweather::Backend::OWM);
     } else if (backend == Kweather::API_NMI) {
         this->get(index)->changeBackend(Kweather::Backend::NMI);
+    } else if (backend == Kweather::API_BLEND) {
+        this->get(index)->changeBackend(Kweather::Backend::Blend);
     } else {
         return;
     }
@@ -38,6 +38,7 @@ public:
     Q_INVOKABLE void updateUi();
     void load();
     void save();
+    void reload(); // sync with the saved location list, e.g. after another process changed it
     Q_INVOKABLE void insert(int index, WeatherLocation *weatherLocation);
     Q_INVOKABLE void remove(int index);
     Q_INVOKABLE void move(int oldIndex, int newIndex);
@@ -55,6 +56,9 @@ public:
 public slots:
     void addLocation(LocationQueryResult *ret);
 signals:
+    void locationAdded(WeatherLocation *location);
+    void locationRemoved(const QString &locationId);
+    void saved();
     void networkErrorCreating();        // error creating a location
     void networkErrorCreatingDefault(); // error getting current location
     void successfullyCreatedDefault();  // successful in getting current location
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "weatherqueryserver.h"
+#include "kweather_debug.h"
+#include "metrics.h"
+#include "startupprofiler.h"
+#include "tracing.h"
+#include "weatherlocation.h"
+#include "weatherlocationmodel.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStandardPaths>
+
+static const qint64 MAX_REQUEST = 4096; // bytes, a location id is far shorter
+
+WeatherQueryServer::WeatherQueryServer(WeatherLocationListModel &model, QObject *parent)
+    : QObject(parent)
+    , m_server(new QLocalServer(this))
+    , m_model(model)
+{
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection, this, &WeatherQueryServer::newConnection);
+}
+
+QString WeatherQueryServer::socketPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation) + QStringLiteral("/kweather.socket");
+}
+
+bool WeatherQueryServer::listen()
+{
+    QLocalServer::removeServer(socketPath()); // stale socket of a crashed daemon
+    if (!m_server->listen(socketPath())) {
+        qCWarning(KWEATHER_LOG) << "unable to listen on" << socketPath() << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+void WeatherQueryServer::newConnection()
+{
+    while (auto socket = m_server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket] { readRequests(socket); });
+    }
+}
+
+void WeatherQueryServer::readRequests(QLocalSocket *socket)
+{
+    while (socket->canReadLine()) {
+        socket->write(handle(socket->readLine().trimmed()));
+        socket->write("\n");
+    }
+    // no request is that long, a client that never ends its line would grow the buffer without bound
+    if (socket->bytesAvailable() > MAX_REQUEST) {
+        qCWarning(KWEATHER_LOG) << "query client sent" << socket->bytesAvailable() << "bytes without a newline, disconnecting";
+        socket->write("{\"error\":\"request too long\"}\n");
+        socket->disconnectFromServer();
+    }
+}
+
+QByteArray WeatherQueryServer::handle(const QByteArray &request)
+{
+    const int space = request.indexOf(' ');
+    const QByteArray command = space < 0 ? request : request.left(space);
+    const QString argument = space < 0 ? QString() : QString::fromUtf8(request.mid(space + 1).trimmed());
+
+    if (command == "locations") {
+        QJsonArray arr;
+        for (auto location : m_model.getList()) {
+            QJsonObject obj;
+            obj["locationId"] = location->locationId();
+            obj["locationName"] = location->locationName();
+            obj["backend"] = location->backend();
+            obj["lastUpdated"] = location->lastUpdated().toString(Qt::ISODate);
+            arr.append(obj);
+        }
+        return QJsonDocument(arr).toJson(QJsonDocument::Compact);
+    }
+    if (command == "trace")
+        return Tracing::toChromeJson();
+    if (command == "metrics")
+        return QJsonDocument(Metrics::instance().toJson()).toJson(QJsonDocument::Compact);
+
+    QJsonObject ret;
+    if (command == "forecast") {
+        if (auto location = findLocation(argument))
+            return QJsonDocument(location->forecast().toJson()).toJson(QJsonDocument::Compact);
+        ret["error"] = QStringLiteral("unknown location");
+    } else if (command == "startup") {
+        ret["report"] = StartupProfiler::report();
+    } else if (command == "refresh") {
+        if (argument.isEmpty()) {
+            for (auto location : m_model.getList())
+                location->update();
+            ret["ok"] = true;
+        } else if (auto location = findLocation(argument)) {
+            location->update();
+            ret["ok"] = true;
+        } else {
+            ret["error"] = QStringLiteral("unknown location");
+        }
+    } else {
+        ret["error"] = QStringLiteral("unknown command");
+    }
+    return QJsonDocument(ret).toJson(QJsonDocument::Compact);
+}
+
+WeatherLocation *WeatherQueryServer::findLocation(const QString &locationId)
+{
+    for (auto location : m_model.getList()) {
+        if (location->locationId() == locationId)
+            return location;
+    }
+    return nullptr;
+}
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_WEATHERQUERYSERVER_H
+#define KWEATHER_WEATHERQUERYSERVER_H
+
+#include <QObject>
+
+class QLocalServer;
+class QLocalSocket;
+class WeatherLocation;
+class WeatherLocationListModel;
+
+/*
+ * Line based query interface of the daemon on a local socket, for scripts and
+ * consumers that don't speak D-Bus. Every request is one line, every answer is
+ * one line of compact json:
+ *
+ *   locations          -> [{"locationId": ..., "locationName": ..., "backend": ..., "lastUpdated": ...}, ...]
+ *   forecast <id>      -> the cached forecast of the location
+ *   refresh [<id>]     -> {"ok": true}, refreshes one or all locations
+ *   trace              -> the trace events recorded so far, see tracing.h
+ *   metrics            -> counters, gauges and histogram percentiles, see metrics.h
+ *   startup            -> {"report": ...}, the startup phase timings
+ *
+ * Errors are returned as {"error": "..."}. A client that sends more than a few
+ * KiB without a newline is disconnected.
+ */
+class WeatherQueryServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WeatherQueryServer(WeatherLocationListModel &model, QObject *parent = nullptr);
+
+    bool listen();
+    static QString socketPath();
+
+private slots:
+    void newConnection();
+
+private:
+    void readRequests(QLocalSocket *socket);
+    QByteArray handle(const QByteArray &request);
+    WeatherLocation *findLocation(const QString &locationId);
+
+    QLocalServer *m_server;
+    WeatherLocationListModel &m_model;
+};
+
+#endif // KWEATHER_WEATHERQUERYSERVER_H
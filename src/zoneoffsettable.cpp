@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#include "zoneoffsettable.h"
+
+#include <algorithm>
+
+ZoneOffsetTable::ZoneOffsetTable(const QByteArray &ianaId, qint64 from, qint64 to)
+    : m_ianaId(ianaId)
+    , m_zone(ianaId)
+    , m_from(from)
+    , m_to(to)
+{
+    if (!m_zone.isValid())
+        return;
+
+    const QDateTime begin = QDateTime::fromSecsSinceEpoch(from, Qt::UTC);
+    m_starts.append(from);
+    m_offsets.append(m_zone.offsetFromUtc(begin));
+    if (!m_zone.hasTransitions())
+        return;
+    const auto transitions = m_zone.transitions(begin, QDateTime::fromSecsSinceEpoch(to, Qt::UTC));
+    for (const auto &transition : transitions) {
+        m_starts.append(transition.atUtc.toSecsSinceEpoch());
+        m_offsets.append(transition.offsetFromUtc);
+    }
+}
+
+int ZoneOffsetTable::offsetAt(qint64 utcSecs) const
+{
+    if (!m_zone.isValid())
+        return 0;
+    if (utcSecs < m_from || utcSecs > m_to)
+        return m_zone.offsetFromUtc(QDateTime::fromSecsSinceEpoch(utcSecs, Qt::UTC));
+
+    // last period starting at or before utcSecs
+    const auto it = std::upper_bound(m_starts.cbegin(), m_starts.cend(), utcSecs);
+    return m_offsets.at(std::max<int>(0, it - m_starts.cbegin() - 1));
+}
+
+QDateTime ZoneOffsetTable::toDateTime(qint64 utcSecs) const
+{
+    if (!m_zone.isValid())
+        return QDateTime::fromSecsSinceEpoch(utcSecs, Qt::UTC);
+    return QDateTime::fromSecsSinceEpoch(utcSecs, Qt::OffsetFromUTC, offsetAt(utcSecs));
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2020 Han Young <hanyoung@protonmail.com>
+ * Copyright 2020 Devin Lin <espidev@gmail.com>
+ *
+ * SPDX-License-Identifier: GPL-2.0-or-later
+ */
+
+#ifndef KWEATHER_ZONEOFFSETTABLE_H
+#define KWEATHER_ZONEOFFSETTABLE_H
+
+#include <QDateTime>
+#include <QTimeZone>
+#include <QVector>
+
+// UTC offsets of one time zone over a time window, taken from tzdata once.
+// Converting a UTC timestamp is then a binary search over the (usually one or
+// two) transitions instead of a QTimeZone construction and tzdata lookup.
+// Times outside the window still work, they just take the slow path.
+class ZoneOffsetTable
+{
+public:
+    ZoneOffsetTable() = default; // no zone, everything stays UTC
+    ZoneOffsetTable(const QByteArray &ianaId, qint64 from, qint64 to); // secs since epoch
+
+    bool isValid() const
+    {
+        return m_zone.isValid();
+    }
+    bool covers(qint64 from, qint64 to) const
+    {
+        return from >= m_from && to <= m_to;
+    }
+    const QByteArray &ianaId() const
+    {
+        return m_ianaId;
+    }
+
+    int offsetAt(qint64 utcSecs) const;
+    QDateTime toDateTime(qint64 utcSecs) const; // with Qt::OffsetFromUTC, UTC without a zone
+
+private:
+    QByteArray m_ianaId;
+    QTimeZone m_zone;
+    qint64 m_from = 0;
+    qint64 m_to = -1;
+    QVector<qint64> m_starts; // start of each offset period, ascending
+    QVector<int> m_offsets;
+};
+
+#endif // KWEATHER_ZONEOFFSETTABLE_H